@@ -0,0 +1,76 @@
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <tamer/wscodec.hh>
+#include <string>
+using tamer::tamerpriv::websocket_codec;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static std::string make_text(size_t n, bool multibyte) {
+    static const char* const pieces[] = {"caf\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80"};
+    std::string s;
+    while (s.length() < n) {
+        if (multibyte && random() % 16 == 0) {
+            const char* p = pieces[random() % 3];
+            if (s.length() + strlen(p) > n)
+                break;
+            s += p;
+        } else
+            s += (char) ('a' + random() % 26);
+    }
+    s.resize(n, ' ');
+    return s;
+}
+
+static void run(const websocket_codec& codec, size_t n) {
+    size_t loops = (size_t(256) << 20) / n;
+    srandom(n);
+    std::string text = make_text(n, false), mixed = make_text(n, true);
+    std::string buf = text;
+    unsigned char* x = reinterpret_cast<unsigned char*>(&buf[0]);
+    volatile bool ok = true;
+
+    double t0 = now();
+    for (size_t i = 0; i != loops; ++i)
+        codec.mask(x, n, 0x9A3BC2D1U);
+    double t1 = now();
+    for (size_t i = 0; i != loops; ++i)
+        ok = ok & tamer::tamerpriv::websocket_validate_utf8(text.data(), text.data(), text.data() + n, true, codec);
+    double t2 = now();
+    for (size_t i = 0; i != loops; ++i)
+        ok = ok & tamer::tamerpriv::websocket_validate_utf8(mixed.data(), mixed.data(), mixed.data() + n, true, codec);
+    double t3 = now();
+
+    double mb = (double) n * loops / (1 << 20);
+    printf("%-8s %8zu  mask %9.1f MB/s  utf8-ascii %9.1f MB/s  utf8-mixed %9.1f MB/s%s\n",
+           codec.name, n, mb / (t1 - t0), mb / (t2 - t1), mb / (t3 - t2),
+           ok ? "" : "  INVALID");
+}
+
+int main(int, char**) {
+    static const size_t sizes[] = {64, 4096, 1048576};
+    const websocket_codec& best = tamer::tamerpriv::websocket_best_codec();
+    for (size_t i = 0; i != sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        run(tamer::tamerpriv::websocket_scalar_codec, sizes[i]);
+        if (&best != &tamer::tamerpriv::websocket_scalar_codec)
+            run(best, sizes[i]);
+    }
+}
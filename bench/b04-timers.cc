@@ -0,0 +1,52 @@
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include "bench.hh"
+
+// Timer insertion, cancellation, and expiry with n timers outstanding.
+static void run(long n) {
+    tamer::rendezvous<> r;
+
+    // far-off timeouts that never fire, like idle-connection timers
+    double t0 = bench::now();
+    for (long i = 0; i != n; ++i)
+        tamer::at_delay(3600 + (i % 1024) * 0.001, make_event(r));
+    double t1 = bench::now();
+    r.clear();
+    // one trip through the loop lets the driver drop what it can
+    tamer::at_asap(make_event(r));
+    tamer::once();
+    while (r.join())
+        /* nada */;
+    double t2 = bench::now();
+    bench::report_rate("timers", "insert", n, t1 - t0);
+    bench::report_rate("timers", "cancel", n, t2 - t1);
+
+    // timers due over the next few milliseconds
+    for (long i = 0; i != n; ++i)
+        tamer::at_delay_usec(i % 4096, make_event(r));
+    long nfired = 0;
+    while (nfired != n) {
+        tamer::once();
+        while (r.join())
+            ++nfired;
+    }
+    double t3 = bench::now();
+    bench::report_rate("timers", "insert+fire", n, t3 - t2);
+}
+
+int main(int argc, char** argv) {
+    bench::initialize(argc, argv);
+    for (long n = 10000; n <= bench::scaled(1000000); n *= 10)
+        run(n);
+    tamer::cleanup();
+}
@@ -0,0 +1,43 @@
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include "bench.hh"
+
+int main(int argc, char** argv) {
+    bench::initialize(argc, argv);
+    tamer::rendezvous<> r;
+
+    // one event per trip through the loop: mostly loop overhead
+    long n = bench::scaled(1000000);
+    double t0 = bench::now();
+    for (long i = 0; i != n; ++i) {
+        tamer::at_asap(make_event(r));
+        tamer::once();
+        r.join();
+    }
+    double t1 = bench::now();
+    bench::report_rate("asap", "one-per-loop", n, t1 - t0);
+
+    // many events per trip: the cost of the asap queue and triggering
+    enum { batch = 1024 };
+    long nbatch = bench::scaled(5000000) / batch;
+    for (long i = 0; i != nbatch; ++i) {
+        for (int j = 0; j != batch; ++j)
+            tamer::at_asap(make_event(r));
+        tamer::once();
+        while (r.join())
+            /* nada */;
+    }
+    double t2 = bench::now();
+    bench::report_rate("asap", "batched", nbatch * batch, t2 - t1);
+    tamer::cleanup();
+}
@@ -0,0 +1,117 @@
+// -*- mode: c++ -*-
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include "bench.hh"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <tamer/fd.hh>
+
+// Round trips of a small message between two tamed functions in one
+// process, over pipes and over loopback TCP.
+
+tamed void echo(tamer::fd rfd, tamer::fd wfd, size_t size) {
+    tvars { std::string buf(size, '\0'); size_t nread; int ret; }
+    while (1) {
+        twait { rfd.read(&buf[0], size, nread, make_event(ret)); }
+        if (ret < 0 || nread != size)
+            break;
+        twait { wfd.write(buf, make_event(ret)); }
+        if (ret < 0)
+            break;
+    }
+    rfd.close();
+    wfd.close();
+}
+
+tamed void ping(tamer::fd rfd, tamer::fd wfd, size_t size, long n,
+                tamer::event<double> done) {
+    tvars { std::string buf(size, 'x'); long i; int ret; double t0; }
+    t0 = bench::now();
+    for (i = 0; i != n; ++i) {
+        twait { wfd.write(buf, make_event(ret)); }
+        if (ret >= 0) {
+            twait { rfd.read(&buf[0], size, make_event(ret)); }
+        }
+        if (ret < 0) {
+            fprintf(stderr, "ping: %s\n", strerror(-ret));
+            exit(1);
+        }
+    }
+    done(bench::now() - t0);
+    rfd.close();
+    wfd.close();
+}
+
+static void report(const char* metric, long n, double t) {
+    bench::report("pingpong", metric, n, t / n * 1e6, "us/rtt");
+}
+
+tamed void pipes(long n, tamer::event<> done) {
+    tvars { tamer::fd ar, aw, br, bw; double t; }
+    if (tamer::fd::pipe(ar, aw) < 0 || tamer::fd::pipe(br, bw) < 0) {
+        perror("pipe");
+        exit(1);
+    }
+    echo(ar, bw, 64);
+    twait { ping(br, aw, 64, n, make_event(t)); }
+    report("pipe", n, t);
+    done();
+}
+
+tamed void tcp(long n, tamer::event<> done) {
+    tvars {
+        tamer::fd l, c, s;
+        sockaddr_in sin;
+        socklen_t sinlen = sizeof(sin);
+        int one = 1;
+        double t;
+    }
+    l = tamer::tcp_listen(0);
+    if (!l || getsockname(l.fdnum(), (struct sockaddr*) &sin, &sinlen) != 0) {
+        fprintf(stderr, "tcp_listen: %s\n", strerror(-l.error()));
+        exit(1);
+    }
+    twait {
+        tamer::tcp_connect(ntohs(sin.sin_port), make_event(c));
+        l.accept(make_event(s));
+    }
+    if (!c || !s) {
+        fprintf(stderr, "tcp_connect: %s\n", strerror(-(c ? s : c).error()));
+        exit(1);
+    }
+    l.close();
+    setsockopt(c.fdnum(), IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(s.fdnum(), IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    echo(s, s, 64);
+    twait { ping(c, c, 64, n, make_event(t)); }
+    report("tcp", n, t);
+    done();
+}
+
+tamed void run(tamer::event<> done) {
+    twait { pipes(bench::scaled(200000), make_event()); }
+    twait { tcp(bench::scaled(100000), make_event()); }
+    done();
+}
+
+int main(int argc, char** argv) {
+    bench::initialize(argc, argv);
+    tamer::rendezvous<> r;
+    tamer::event<> done = make_event(r);
+    run(done);
+    while (done)
+        tamer::once();
+    tamer::cleanup();
+}
@@ -0,0 +1,117 @@
+// -*- mode: c++ -*-
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include "bench.hh"
+#include <tamer/http.hh>
+
+// HTTP request parsing and response serialization through a pipe.
+
+static const char request[] =
+    "GET /index.html?q=1 HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "User-Agent: bench/1.0\r\n"
+    "Accept: text/html,application/xhtml+xml\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+// Write @a n pipelined requests, a batch at a time.
+tamed void write_requests(tamer::fd wfd, long n) {
+    tvars { std::string batch; long i; int ret; }
+    for (i = 0; i != 64; ++i)
+        batch += request;
+    for (i = 0; i < n; i += 64) {
+        twait { wfd.write(batch.data(),
+                          (n - i < 64 ? n - i : 64) * (sizeof(request) - 1),
+                          make_event(ret)); }
+        if (ret < 0)
+            break;
+    }
+    wfd.close();
+}
+
+tamed void drain(tamer::fd rfd) {
+    tvars { std::string buf(65536, '\0'); size_t nread; int ret; }
+    do {
+        twait { rfd.read(&buf[0], buf.size(), nread, make_event(ret)); }
+    } while (ret >= 0 && nread != 0);
+    rfd.close();
+}
+
+tamed void parse(long n, tamer::event<> done) {
+    tvars {
+        tamer::fd rfd, wfd;
+        tamer::http_parser hp(HTTP_REQUEST);
+        tamer::http_message m;
+        long i;
+        double t0;
+    }
+    if (tamer::fd::pipe(rfd, wfd) < 0) {
+        perror("pipe");
+        exit(1);
+    }
+    t0 = bench::now();
+    write_requests(wfd, n);
+    for (i = 0; i != n; ++i) {
+        twait { hp.receive(rfd, make_event(m)); }
+        if (!hp.ok() || m.url().empty()) {
+            fprintf(stderr, "parse: error at request %ld\n", i);
+            exit(1);
+        }
+    }
+    bench::report_rate("http", "parse", n, bench::now() - t0);
+    rfd.close();
+    done();
+}
+
+tamed void serialize(long n, tamer::event<> done) {
+    tvars {
+        tamer::fd rfd, wfd;
+        tamer::http_message m;
+        long i;
+        double t0;
+    }
+    if (tamer::fd::pipe(rfd, wfd) < 0) {
+        perror("pipe");
+        exit(1);
+    }
+    drain(rfd);
+    t0 = bench::now();
+    for (i = 0; i != n; ++i) {
+        m = tamer::http_message();
+        m.http_major(1).http_minor(1).status_code(200)
+            .date_header("Date")
+            .header("Content-Type", "text/plain")
+            .body("Hello, world!\n");
+        twait { tamer::http_parser::send_response(wfd, m, make_event()); }
+    }
+    bench::report_rate("http", "serialize", n, bench::now() - t0);
+    wfd.close();
+    done();
+}
+
+tamed void run(tamer::event<> done) {
+    twait { parse(bench::scaled(500000), make_event()); }
+    twait { serialize(bench::scaled(500000), make_event()); }
+    done();
+}
+
+int main(int argc, char** argv) {
+    bench::initialize(argc, argv);
+    tamer::rendezvous<> r;
+    tamer::event<> done = make_event(r);
+    run(done);
+    while (done)
+        tamer::once();
+    tamer::cleanup();
+}
@@ -0,0 +1,71 @@
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include "bench.hh"
+#include <tamer/channel.hh>
+
+int main(int argc, char** argv) {
+    bench::initialize(argc, argv);
+    long n = bench::scaled(5000000);
+    tamer::rendezvous<> r;
+
+    // unbounded channel, consumer always waiting
+    {
+        tamer::channel<long> ch;
+        long x = 0, sum = 0;
+        double t0 = bench::now();
+        for (long i = 0; i != n; ++i) {
+            ch.pop_front(make_event(r, x));
+            ch.push_back(i);
+            r.join();
+            sum += x;
+        }
+        bench::report_rate("channel", "handoff", n, bench::now() - t0);
+    }
+
+    // bounded channel: fill to capacity, then take a batch
+    {
+        tamer::bounded_channel<long> ch(256);
+        std::vector<long> v;
+        double t0 = bench::now();
+        for (long i = 0; i < n; i += 256) {
+            for (long j = 0; j != 256; ++j)
+                ch.try_push(i + j);
+            ch.pop_many(256, make_event(r, v));
+            r.join();
+        }
+        bench::report_rate("channel", "bounded-batch", n, bench::now() - t0);
+    }
+
+    // bounded channel with blocked producers admitted one item at a time
+    {
+        tamer::bounded_channel<long> ch(16);
+        long x;
+        double t0 = bench::now();
+        for (long i = 0; i != n; ++i) {
+            ch.push(i, make_event(r));
+            if (ch.push_wait_size() == 64)
+                while (ch.push_wait_size()) {
+                    ch.pop(make_event(r, x));
+                    while (r.join())
+                        /* nada */;
+                }
+        }
+        while (!ch.empty()) {
+            ch.pop(make_event(r, x));
+            while (r.join())
+                /* nada */;
+        }
+        bench::report_rate("channel", "bounded-blocking", n, bench::now() - t0);
+    }
+    tamer::cleanup();
+}
@@ -0,0 +1,49 @@
+// -*- mode: c++ -*-
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include "bench.hh"
+
+// Calls to tamed functions that complete without blocking, like an
+// fd::write to a writable socket.
+
+tamed void ready(int x, tamer::event<int> done) {
+    done(x + 1);
+}
+
+tamed void nested(int x, tamer::event<int> done) {
+    tvars { int y; }
+    twait { ready(x, make_event(y)); }
+    done(y);
+}
+
+int main(int argc, char** argv) {
+    bench::initialize(argc, argv);
+    long n = bench::scaled(20000000);
+    tamer::rendezvous<> r;
+    int x = 0;
+
+    double t0 = bench::now();
+    for (long i = 0; i != n; ++i) {
+        ready(x, make_event(r, x));
+        r.join();
+    }
+    double t1 = bench::now();
+    bench::report_rate("call", "no-twait", n, t1 - t0);
+
+    for (long i = 0; i != n; ++i) {
+        nested(x, make_event(r, x));
+        r.join();
+    }
+    bench::report_rate("call", "twait-ready", n, bench::now() - t1);
+    tamer::cleanup();
+}
@@ -0,0 +1,90 @@
+#ifndef TAMER_BENCH_HH
+#define TAMER_BENCH_HH 1
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <tamer/tamer.hh>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Shared scaffolding for the benchmarks run by `make bench`.
+//
+// Every benchmark accepts --driver=NAME (tamer, libevent, libev, or uring)
+// and --scale=X, which multiplies its iteration counts. Results go to
+// standard output, one JSON object per line:
+//
+//   {"bench":"asap","driver":"tamer","metric":"trigger","n":5000000,
+//    "value":31234567.8,"unit":"ops/s"}
+//
+// A benchmark whose driver isn't available exits with status 77.
+namespace bench {
+
+static const char* driver = "tamer";
+static double scale = 1;
+
+inline double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+inline long scaled(long n) {
+    long x = (long) (n * scale);
+    return x > 0 ? x : 1;
+}
+
+inline void initialize(int argc, char** argv) {
+    int flags = tamer::init_tamer;
+    for (int i = 1; i < argc; ++i)
+        if (strncmp(argv[i], "--driver=", 9) == 0)
+            driver = argv[i] + 9;
+        else if (strncmp(argv[i], "--scale=", 8) == 0)
+            scale = strtod(argv[i] + 8, 0);
+        else {
+            fprintf(stderr, "Usage: %s [--driver=NAME] [--scale=X]\n", argv[0]);
+            exit(1);
+        }
+    if (strcmp(driver, "libevent") == 0)
+        flags = tamer::init_libevent;
+    else if (strcmp(driver, "libev") == 0)
+        flags = tamer::init_libev;
+    else if (strcmp(driver, "uring") == 0)
+        flags = tamer::init_uring;
+    else if (strcmp(driver, "tamer") != 0) {
+        fprintf(stderr, "%s: unknown driver %s\n", argv[0], driver);
+        exit(1);
+    }
+    if (!tamer::initialize(flags | tamer::init_strict)) {
+        fprintf(stderr, "%s: driver %s not available\n", argv[0], driver);
+        exit(77);
+    }
+}
+
+inline void report(const char* bench, const char* metric, long n,
+                   double value, const char* unit) {
+    printf("{\"bench\":\"%s\",\"driver\":\"%s\",\"metric\":\"%s\","
+           "\"n\":%ld,\"value\":%.6g,\"unit\":\"%s\"}\n",
+           bench, driver, metric, n, value, unit);
+    fflush(stdout);
+}
+
+// Report a rate, in operations per second, for @a n operations that took
+// @a t seconds.
+inline void report_rate(const char* bench, const char* metric, long n,
+                        double t) {
+    report(bench, metric, n, n / t, "ops/s");
+}
+
+} // namespace bench
+#endif
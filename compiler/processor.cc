@@ -35,6 +35,7 @@ void element_list_t::output(outputter_t *o) {
 }
 
 #define TAME_CLOSURE_NAME     "tamer_closure_"
+#define TAME_STACK_CLOSURE_NAME "tamer_stack_closure_"
 #define TAMER_SELF_NAME       "tamer_self_"
 #define TWAIT_BLOCK_RENDEZVOUS "tamer_gather_rendezvous_"
 
@@ -692,9 +693,7 @@ vartab_t::initializers_and_reference_declarations(strbuf& b, outputter_t* o,
             init->finish_type(b);
         b << ")";
         // tamer::destroy_guard objects need special initialization
-        if (fn && init
-            && (v.type().base_type() == "tamer::destroy_guard"
-                || v.type().base_type() == "destroy_guard"))
+        if (fn && init && v.is_destroy_guard())
             b << "(" TAME_CLOSURE_NAME ", " << init->value() << ")";
         else if (init)
             init->initializer(b, v.type().is_ref());
@@ -703,6 +702,41 @@ vartab_t::initializers_and_reference_declarations(strbuf& b, outputter_t* o,
     }
 }
 
+bool var_t::is_destroy_guard() const {
+    return _type.base_type() == "tamer::destroy_guard"
+        || _type.base_type() == "destroy_guard";
+}
+
+str var_t::coroutine_arg_member() const {
+    // Arrays have already decayed to pointers; copy those.
+    if (!_arrays.empty())
+        return decl(true);
+    str t = _type.to_str();
+    size_t l = t.length();
+    while (l != 0 && (t[l - 1] == '&' || isspace((unsigned char) t[l - 1])))
+        --l;
+    strbuf b;
+    b << t.substr(0, l) << "* " << _name;
+    return b.str();
+}
+
+str var_t::coroutine_arg_pointer() const {
+    return _arrays.empty() ? "&" + _name : _name;
+}
+
+void var_t::coroutine_arg_declaration(strbuf& b, const str& padding) const {
+    b << padding;
+    if (!_arrays.empty())
+        b << decl(true) << " = " TAME_CLOSURE_NAME "." << _name;
+    else if (_type.is_ref())
+        b << _type.to_str() << " " << _name << " = static_cast<"
+          << _type.to_str() << ">(*" TAME_CLOSURE_NAME "." << _name << ")";
+    else
+        b << _type.to_str() << " " << _name << "(TAMER_MOVE(*"
+          << TAME_CLOSURE_NAME "." << _name << "))";
+    b << ";\n";
+}
+
 void
 vartab_t::paramlist(strbuf &b, paramlist_flags list_mode, const char* sep) const
 {
@@ -938,10 +972,19 @@ tame_fn_t::output_firstfn(outputter_t *o)
     strbuf b;
     b << signature() << "\n{\n";
 
-    b << "  " << closure(true).decl(true) << " = "
-      << "std::allocator< " << closure(true).type().base_type() << " >()."
-      << "allocate(1);\n"
-      << "  ((" << closure_type << "::tamer_closure_type*) " TAME_CLOSURE_NAME ")->initialize_closure("
+    // A body that cannot block finishes before the wrapper returns, so its
+    // closure can live on the stack.
+    if (can_block())
+        b << "  " << closure(true).decl(true) << " = "
+          << "tamer::tamerpriv::allocate_closure< "
+          << closure(true).type().base_type() << " >();\n";
+    else
+        b << "  tamer::tamerpriv::stack_closure< "
+          << closure(true).type().base_type() << " > "
+          << TAME_STACK_CLOSURE_NAME ";\n"
+          << "  " << closure(true).decl(true) << " = "
+          << TAME_STACK_CLOSURE_NAME ".get();\n";
+    b << "  ((" << closure_type << "::tamer_closure_type*) " TAME_CLOSURE_NAME ")->initialize_closure("
       << closure(true).type().base_type() << "::tamer_activator_";
     if (_class.length() && !(_opts & STATIC_DECL))
         b << ", this";
@@ -953,13 +996,130 @@ tame_fn_t::output_firstfn(outputter_t *o)
     if (need_implicit_rendezvous())
         b << "  new ((void*) &" TAME_CLOSURE_NAME "->" TWAIT_BLOCK_RENDEZVOUS
             ") tamer::gather_rendezvous;\n";
-    b << "  " << TAME_CLOSURE_NAME << "->tamer_activator_("
-      << TAME_CLOSURE_NAME << ");\n}\n";
+    // Enter the body with a direct call, not through tamer_activator_, so
+    // the common case of a function that never blocks can be inlined here.
+    output_body_call(b, "*" TAME_CLOSURE_NAME);
+    b << "}\n";
+
+    o->output_str(b.str());
+    o->switch_to_mode(om);
+}
+
+void
+tame_fn_t::output_body_call(strbuf &b, const str &arg) const
+{
+    b << "  ";
+    if (_class.length() && !(_opts & STATIC_DECL))
+        b << "this->" << _method_name;
+    else
+        b << _name;
+    b << "(" << arg << ");\n";
+}
+
+// --coroutines: the body is a coroutine that takes a struct of pointers to
+// the arguments. The wrapper fills it in on its own stack; the coroutine
+// moves the arguments into its frame before it can first suspend.
+void
+tame_fn_t::output_coroutine_args(outputter_t *o)
+{
+    strbuf b;
+    output_mode_t om = o->switch_to_mode (OUTPUT_TREADMILL);
+
+    if (class_template_.length() || function_template_.length())
+        add_templates(b, "\n");
+    b << "class " << closure_type_name(false)
+      << " : public tamer::tamerpriv::coroutine_args {\npublic:\n";
+    if (_args)
+        for (unsigned i = 0; i != _args->size(); ++i)
+            if (!_args->_vars[i].name().empty())
+                b << "    " << _args->_vars[i].coroutine_arg_member() << ";\n";
+    b << "};\n\n";
+
+    o->output_str(b.str());
+    o->switch_to_mode(om);
+}
+
+void
+tame_fn_t::output_coroutine_firstfn(outputter_t *o)
+{
+    state->set_fn(this);
+    output_mode_t om = o->switch_to_mode(OUTPUT_PASSTHROUGH);
+
+    str closure_type = closure(true).type().base_type();
+    if (class_template_.length() || function_template_.length())
+        closure_type = "typename " + closure_type;
+
+    strbuf b;
+    b << signature() << "\n{\n"
+      << "  " << closure_type << " " TAME_CLOSURE_NAME ";\n";
+    if (_args)
+        for (unsigned i = 0; i != _args->size(); ++i) {
+            const var_t& v = _args->_vars[i];
+            if (!v.name().empty())
+                b << "  " TAME_CLOSURE_NAME "." << v.name() << " = "
+                  << v.coroutine_arg_pointer() << ";\n";
+        }
+    output_body_call(b, TAME_CLOSURE_NAME);
+    b << "  tamer::tamerpriv::coroutine_rethrow();\n}\n";
+
+    o->output_str(b.str());
+    o->switch_to_mode(om);
+}
+
+void
+tame_fn_t::output_coroutine_vars(outputter_t *o, int ln)
+{
+    strbuf b;
+    output_mode_t om = o->switch_to_mode(OUTPUT_TREADMILL, ln);
+
+    if (_args)
+        for (unsigned i = 0; i != _args->size(); ++i)
+            if (!_args->_vars[i].name().empty())
+                _args->_vars[i].coroutine_arg_declaration(b, "  ");
+
+    unsigned lineno;
+    for (unsigned i = 0; i != _stack_vars.size(); ++i) {
+        const var_t& v = _stack_vars._vars[i];
+        if (v.name().empty())
+            continue;
+        initializer_t* init = v.initializer();
+        if (init && (lineno = init->constructor_lineno()))
+            o->set_lineno(lineno, b);
+        b << "  " << v.type().to_str() << " " << v.name();
+        if (init)
+            init->finish_type(b);
+        if (init && v.is_destroy_guard())
+            b << "(co_await tamer::tamerpriv::coroutine_self(), "
+              << init->value() << ")";
+        else if (init)
+            init->initializer(b, false);
+        b << ";\n";
+    }
 
     o->output_str(b.str());
     o->switch_to_mode(om);
 }
 
+// A body needs a closure that outlives the call if it can block, or if a
+// destroy_guard links to its closure.
+bool
+tame_fn_t::can_block() const
+{
+    for (unsigned i = 0; i != _envs.size(); ++i)
+        if (_envs[i]->is_jumpto())
+            return true;
+    for (unsigned i = 0; i != _stack_vars.size(); ++i)
+        if (_stack_vars._vars[i].is_destroy_guard())
+            return true;
+    return false;
+}
+
+bool
+tame_fn_t::is_coroutine() const
+{
+    return can_block();
+}
+
 void
 tame_fn_t::output_fn(outputter_t *o)
 {
@@ -990,13 +1150,19 @@ tame_vars_t::output(outputter_t *o)
 void
 tame_fn_t::output_vars(outputter_t *o, int ln)
 {
+    if (tamer_coroutines) {
+        output_coroutine_vars(o, ln);
+        return;
+    }
+
     strbuf b;
     output_mode_t om = o->switch_to_mode(OUTPUT_TREADMILL, ln);
 
     if (_args)
         _args->reference_declarations(b, "  ");
-    b << "  tamer::tamerpriv::closure_owner<" << closure_type_name(true)
-      << " > tamer_closure_holder_(" << TAME_CLOSURE_NAME << ");\n";
+    if (can_block())
+        b << "  tamer::tamerpriv::closure_owner<" << closure_type_name(true)
+          << " > tamer_closure_holder_(" << TAME_CLOSURE_NAME << ");\n";
 
     _stack_vars.initializers_and_reference_declarations(b, o, this);
 
@@ -1023,7 +1189,17 @@ tame_fn_t::output(outputter_t *o)
     str bstr = b.str();
     if (bstr.length())
         o->output_str(bstr + "\n");
-    if (!_declaration_only) {
+    if (_declaration_only)
+        /* nothing more */;
+    else if (tamer_coroutines) {
+        if (!_ret_type.is_void()) {
+            warn << _loc << ": --coroutines requires tamed functions to return void\n";
+            exit(1);
+        }
+        output_coroutine_args(o);
+        output_coroutine_firstfn(o);
+        output_fn(o);
+    } else {
         output_closure(o);
         output_firstfn(o);
         output_fn(o);
@@ -1037,12 +1213,53 @@ static bool description_empty(const str& x) {
     return true;
 }
 
+void
+tame_block_ev_t::output_coroutine(outputter_t *o)
+{
+  strbuf b;
+
+  b << "/*twait{*/ do { tamer::gather_rendezvous " TWAIT_BLOCK_RENDEZVOUS "; ";
+  if (_isvolatile)
+      b << TWAIT_BLOCK_RENDEZVOUS ".set_volatile(true); ";
+  b << "do {\n";
+  if (tamer_debug)
+      b << "#define make_event(...) make_annotated_event(__FILE__, __LINE__, " TWAIT_BLOCK_RENDEZVOUS ", ## __VA_ARGS__)\n"
+        << "#define make_preevent(...) make_annotated_preevent(__FILE__, __LINE__, " TWAIT_BLOCK_RENDEZVOUS ", ## __VA_ARGS__)\n";
+  else
+      b << "#define make_event(...) make_event(" TWAIT_BLOCK_RENDEZVOUS ", ## __VA_ARGS__)\n"
+        << "#define make_preevent(...) make_preevent(" TWAIT_BLOCK_RENDEZVOUS ", ## __VA_ARGS__)\n";
+  o->output_str(b.str());
+
+  for (std::list<tame_el_t *>::iterator el = _lst.begin(); el != _lst.end(); el++) {
+      (*el)->output (o);
+  }
+
+  int lineno = o->lineno();
+  output_mode_t om = o->switch_to_mode(OUTPUT_TREADMILL, lineno);
+  b.str(str());
+  b << "/*}twait*/ } while (0); "
+    << "while (" TWAIT_BLOCK_RENDEZVOUS ".has_waiting()) "
+    << "co_await tamer::tamerpriv::coroutine_block(" TWAIT_BLOCK_RENDEZVOUS ", __FILE__, __LINE__";
+  if (!description_empty(description_) && tamer_debug)
+      b << ", (" << description_ << ")";
+  b << "); } while (0);\n";
+  o->output_str(b.str());
+  o->switch_to_mode(OUTPUT_PASSTHROUGH);
+  o->output_str("\n#undef make_event\n#undef make_preevent\n");
+  o->switch_to_mode(om);
+}
+
 void
 tame_block_ev_t::output(outputter_t *o)
 {
   strbuf b;
   str tmp;
 
+  if (tamer_coroutines) {
+      output_coroutine(o);
+      return;
+  }
+
   b << "/*twait{*/ do { ";
   if (_fn->any_volatile_envs())
       b << TAME_CLOSURE_NAME "." TWAIT_BLOCK_RENDEZVOUS ".set_volatile(" << _isvolatile << "); ";
@@ -1118,7 +1335,9 @@ tame_block_thr_t::output (outputter_t *o)
 str
 tame_fn_t::return_expr () const
 {
-    if (_default_return.length()) {
+    if (tamer_coroutines)
+        return is_coroutine() ? "co_return" : "return";
+    else if (_default_return.length()) {
         strbuf b;
         b << "do { " << _default_return << "} while (0)";
         return b.str();
@@ -1145,9 +1364,41 @@ tame_wait_t::output_blocked(strbuf &b, const str &jgn)
       << "    " << _fn->return_expr() << ";\n";
 }
 
+void
+tame_wait_t::output_coroutine(outputter_t *o)
+{
+    strbuf tmp;
+    tmp << "(" << join_group ().name () << ")";
+    str jgn = tmp.str();
+
+    output_mode_t om = o->switch_to_mode(OUTPUT_TREADMILL);
+    strbuf b;
+    b << "do {\n";
+    o->set_lineno(lineno_, b);
+    b << "  while (!" << jgn << ".join (";
+    for (size_t i = 0; i < n_args (); i++) {
+        if (i > 0) b << ", ";
+        b << "" << arg (i).name () << "";
+    }
+    b << "))\n"
+      << "    co_await tamer::tamerpriv::coroutine_block(" << jgn << ", __FILE__, __LINE__";
+    if (!description_empty(description_) && tamer_debug)
+        b << ", (" << description_ << ")";
+    b << ");\n"
+      << "} while (0);\n";
+
+    o->output_str(b.str());
+    o->switch_to_mode (om);
+}
+
 void
 tame_wait_t::output (outputter_t *o)
 {
+    if (tamer_coroutines) {
+        output_coroutine(o);
+        return;
+    }
+
     strbuf tmp;
     tmp << "(" << join_group ().name () << ")";
     str jgn = tmp.str();
@@ -1185,7 +1436,7 @@ tame_ret_t::output (outputter_t *o)
   strbuf b;
 
   o->switch_to_mode (OUTPUT_PASSTHROUGH, _line_number);
-  b << "return";
+  b << (tamer_coroutines && _fn->is_coroutine() ? "co_return" : "return");
   if (_params.length()) {
       b << " ";
       b << _params;
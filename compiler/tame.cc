@@ -6,9 +6,11 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <getopt.h>
 
 parse_state_t *state;
 bool tamer_debug = false;
+bool tamer_coroutines = false;
 outputter_t *outputter;
 
 std::ostream &warn = std::cerr;
@@ -30,6 +32,7 @@ usage ()
         << "    -c  compile mode; infer output file name from input file "
         << "name\n"
         << "    -b  basename mode; strip off dirs from input file name\n"
+        << "    --coroutines  compile tamed functions to C++20 coroutines\n"
         << "\n"
         << "  If no input or output files are specified, then standard in\n"
         << "  and out are assumed, respectively.\n"
@@ -94,8 +97,16 @@ main (int argc, char *argv[])
   str ifn, depfile;
   bool c_mode (false), b_mode (false);
 
-  while ((ch = getopt (argc, argv, "bghlnDLvdo:c:O:F:")) != -1)
+  static const struct option longopts[] = {
+      { "coroutines", no_argument, 0, 'C' },
+      { 0, 0, 0, 0 }
+  };
+
+  while ((ch = getopt_long (argc, argv, "bghlnDLvdo:c:O:F:", longopts, 0)) != -1)
     switch (ch) {
+    case 'C':
+        tamer_coroutines = true;
+        break;
     case 'g':
         tamer_debug = true;
         break;
@@ -379,6 +379,12 @@ public:
     str decl(bool include_name) const;
     str ref_decl(bool noref) const;
     void reference_declaration(strbuf& b, const str& padding) const;
+    bool is_destroy_guard() const;
+
+    // --coroutines: an argument travels to the coroutine as a pointer
+    str coroutine_arg_member() const;
+    str coroutine_arg_pointer() const;
+    void coroutine_arg_declaration(strbuf& b, const str& padding) const;
     str _name;
 
 protected:
@@ -542,6 +548,8 @@ class tame_fn_t : public element_list_t {
     str loc() const { return _loc; }
 
     str return_expr() const;
+    bool can_block() const;
+    bool is_coroutine() const;
 
     void add_templates(strbuf& b, const char* sep) const;
 
@@ -578,6 +586,10 @@ class tame_fn_t : public element_list_t {
     void output_closure(outputter_t *o);
     void output_firstfn(outputter_t *o);
     void output_fn(outputter_t *o);
+    void output_coroutine_args(outputter_t *o);
+    void output_coroutine_firstfn(outputter_t *o);
+    void output_coroutine_vars(outputter_t *o, int ln);
+    void output_body_call(strbuf &b, const str &arg) const;
     void output_jump_tab(strbuf &b);
     void output_block_cb_switch(strbuf &b);
 
@@ -709,6 +721,8 @@ public:
     bool needs_counter() const { return true; }
 
   protected:
+    void output_coroutine(outputter_t *o);
+
     tame_fn_t *_fn;
     int _id;
     vartab_t _class_vars;
@@ -739,6 +753,7 @@ public:
   void set_description(const str& s) { description_ = s; }
 protected:
   void output_blocked(strbuf &b, const str &jgn);
+  void output_coroutine(outputter_t *o);
   tame_fn_t *_fn;
   expr_list_t *_args;
   int _id;
@@ -795,5 +810,6 @@ do {                                                      \
 } while (0)
 
 extern bool tamer_debug;
+extern bool tamer_coroutines;
 
 #endif /* _TAME_TAME_H */
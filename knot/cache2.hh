@@ -4,19 +4,30 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string>
+#include <unordered_map>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include "httphdrs.h"
 #include "refptr.hh"
 
 extern ssize_t g_cache_max;
 
+// A cached file, stored as the HTTP response header followed by the file
+// body. The body is mapped from the file where possible, so cached files
+// occupy page cache rather than heap.
 struct cache_entry {
 
-    cache_entry(const std::string &n, char *d, size_t len)
-	: _filename(n), _data(d), _len(len), _refcount(1), _next(0), _prev(0) {
+    cache_entry(const std::string &n, char *body, size_t len, bool mapped)
+	: _filename(n), _hdrlen(0), _body(body), _bodylen(len),
+	  _mapped(mapped), _refcount(1), _next(0), _prev(0) {
     }
 
     ~cache_entry() {
 	assert(!_prev && !_next);
-	delete[] _data;
+	if (_mapped)
+	    munmap(_body, _bodylen);
+	else
+	    delete[] _body;
     }
 
     void use() {
@@ -28,19 +39,52 @@ struct cache_entry {
 	    delete this;
     }
 
-    char *data() const {
-	return _data;
+    const std::string &filename() const {
+	return _filename;
+    }
+
+    char *header() {
+	return _header;
+    }
+
+    size_t header_size() const {
+	return _hdrlen;
+    }
+
+    void set_header_size(size_t len) {
+	assert(len < sizeof(_header));
+	_hdrlen = len;
+    }
+
+    char *body() const {
+	return _body;
+    }
+
+    size_t body_size() const {
+	return _bodylen;
     }
 
     size_t size() const {
-	return _len;
+	return _hdrlen + _bodylen;
+    }
+
+    // Fill in iov[0] and iov[1] with the response. Returns 2.
+    int response(struct iovec *iov) {
+	iov[0].iov_base = _header;
+	iov[0].iov_len = _hdrlen;
+	iov[1].iov_base = _body;
+	iov[1].iov_len = _bodylen;
+	return 2;
     }
 
   private:
 
     std::string _filename;
-    char *_data;
-    size_t _len;
+    char _header[HEADER_200_BUF_SIZE];
+    size_t _hdrlen;
+    char *_body;
+    size_t _bodylen;
+    bool _mapped;
     unsigned _refcount;
     cache_entry *_next;
     cache_entry *_prev;
@@ -50,6 +94,8 @@ struct cache_entry {
 };
 
 
+// Files indexed by name, evicted least recently used first once the total
+// size exceeds the capacity.
 class cache { public:
 
     cache(size_t c)
@@ -63,12 +109,24 @@ class cache { public:
     void remove(cache_entry *);
     void evict();
 
+    size_t load() const {
+	return _load;
+    }
+
+    size_t capacity() const {
+	return _capacity;
+    }
+
   private:
 
     size_t _load;
     size_t _capacity;
     cache_entry *_head;
     cache_entry *_tail;
+    std::unordered_map<std::string, cache_entry *> _index;
+
+    void link_front(cache_entry *e);
+    void unlink(cache_entry *e);
     
 };
 
@@ -19,6 +19,11 @@ template <typename T> class refptr { public:
 	    _t->use();
     }
     
+    refptr(refptr<T> &&r)
+	: _t(r._t) {
+	r._t = 0;
+    }
+
     ~refptr() {
 	if (_t)
 	    _t->unuse();
@@ -41,6 +46,16 @@ template <typename T> class refptr { public:
 	return *this;
     }
 
+    refptr<T> &operator=(refptr<T> &&r) {
+	if (this != &r) {
+	    if (_t)
+		_t->unuse();
+	    _t = r._t;
+	    r._t = 0;
+	}
+	return *this;
+    }
+
     refptr<T> &operator=(T *t) {
 	if (_t && _t != t)
 	    _t->unuse();
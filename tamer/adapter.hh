@@ -531,6 +531,9 @@ inline event<T0> with_signal(SigInputIterator first, SigInputIterator last, pree
  *  passes, then @a result is set to 0. Otherwise, @a e is unblocked
  *  (triggered without a value), and @a result is set to @c -ETIMEDOUT.
  *
+ *  @a result is set to 0 immediately. The deadline and @a result live in
+ *  the driver's timer entry, so no helper event or rendezvous is created.
+ *
  *  @note Versions of this function exist for @a delay values of types @c
  *  timeval, @c double, and under the names with_timeout_sec() and
  *  with_timeout_msec(), @c int numbers of seconds and milliseconds,
@@ -538,25 +541,25 @@ inline event<T0> with_signal(SigInputIterator first, SigInputIterator last, pree
  */
 template <typename T0, typename T1, typename T2, typename T3>
 inline event<T0, T1, T2, T3> with_timeout(const timeval &delay, event<T0, T1, T2, T3> e, int &result) {
-    at_delay(delay, tamerpriv::with_helper(e, &result, outcome::timeout));
+    driver::main->at_deadline(tamerpriv::deadline_after(delay), e.unblocker(), result);
     return e;
 }
 
 template <typename T0, typename T1, typename T2, typename T3>
 inline event<T0, T1, T2, T3> with_timeout(double delay, event<T0, T1, T2, T3> e, int &result) {
-    at_delay(delay, tamerpriv::with_helper(e, &result, outcome::timeout));
+    driver::main->at_deadline(tamerpriv::deadline_after(delay), e.unblocker(), result);
     return e;
 }
 
 template <typename T0, typename T1, typename T2, typename T3>
 inline event<T0, T1, T2, T3> with_timeout_sec(int delay, event<T0, T1, T2, T3> e, int &result) {
-    at_delay_sec(delay, tamerpriv::with_helper(e, &result, outcome::timeout));
+    driver::main->at_deadline(tamerpriv::deadline_after(double(delay)), e.unblocker(), result);
     return e;
 }
 
 template <typename T0, typename T1, typename T2, typename T3>
 inline event<T0, T1, T2, T3> with_timeout_msec(int delay, event<T0, T1, T2, T3> e, int &result) {
-    at_delay_msec(delay, tamerpriv::with_helper(e, &result, outcome::timeout));
+    driver::main->at_deadline(tamerpriv::deadline_after_msec(delay), e.unblocker(), result);
     return e;
 }
 
@@ -0,0 +1,128 @@
+#ifndef TAMER_ADMISSION_HH
+#define TAMER_ADMISSION_HH 1
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <tamer/fd.hh>
+#include <string>
+namespace tamer {
+
+/** @file <tamer/admission.hh>
+ *  @brief  Load shedding driven by event-loop lag.
+ */
+
+class admission_control : public tamed_class {
+  public:
+    explicit admission_control(double max_lag = 0.1,
+                               size_t max_queue = 10000);
+
+    bool overloaded();
+    inline bool shedding() const;
+
+    void accept(fd listener, event<fd> result);
+
+    inline double max_lag() const;
+    inline void set_max_lag(double t);
+    inline size_t max_queue() const;
+    inline void set_max_queue(size_t n);
+    inline double recheck_interval() const;
+    inline void set_recheck_interval(double t);
+    inline const std::string& rejection() const;
+    inline void set_rejection(std::string data);
+
+    inline uint64_t npaused() const;
+    inline uint64_t nrejected() const;
+
+  private:
+    double max_lag_;
+    size_t max_queue_;
+    double interval_;
+    std::string rejection_;
+    bool shedding_;
+    uint64_t npaused_;
+    uint64_t nrejected_;
+
+    void reject(fd& c);
+
+    class closure__accept__2fdQ2fd_;
+    void accept(closure__accept__2fdQ2fd_&);
+};
+
+/** @brief  Return whether the last overloaded() check found overload. */
+inline bool admission_control::shedding() const {
+    return shedding_;
+}
+
+/** @brief  Return the loop lag, in seconds, that counts as overload. */
+inline double admission_control::max_lag() const {
+    return max_lag_;
+}
+
+inline void admission_control::set_max_lag(double t) {
+    max_lag_ = t;
+}
+
+/** @brief  Return the queued closures and asap events that count as
+ *  overload. */
+inline size_t admission_control::max_queue() const {
+    return max_queue_;
+}
+
+inline void admission_control::set_max_queue(size_t n) {
+    max_queue_ = n;
+}
+
+/** @brief  Return the seconds a paused accept() waits between checks. */
+inline double admission_control::recheck_interval() const {
+    return interval_;
+}
+
+inline void admission_control::set_recheck_interval(double t) {
+    interval_ = t;
+}
+
+/** @brief  Return the bytes written to connections shed while
+ *  overloaded. */
+inline const std::string& admission_control::rejection() const {
+    return rejection_;
+}
+
+/** @brief  Set the bytes written to connections shed while overloaded.
+ *
+ *  If @a data is empty, the default, accept() stops accepting during
+ *  overload and leaves new connections in the listen queue. Otherwise
+ *  accept() keeps accepting, writes @a data to each new connection, and
+ *  closes it. An HTTP server might set a 503 response:
+ *
+ *  @code
+ *     tamer::http_message m;
+ *     m.status_code(503).header("Retry-After", 1)
+ *         .header("Connection", "close");
+ *     tamer::http_prebuilt_response r(m);
+ *     ac.set_rejection(std::string(r.data(), r.length()));
+ *  @endcode */
+inline void admission_control::set_rejection(std::string data) {
+    rejection_ = TAMER_MOVE(data);
+}
+
+/** @brief  Return how many times accept() paused for overload. */
+inline uint64_t admission_control::npaused() const {
+    return npaused_;
+}
+
+/** @brief  Return how many connections were shed with rejection(). */
+inline uint64_t admission_control::nrejected() const {
+    return nrejected_;
+}
+
+} // namespace tamer
+#endif /* TAMER_ADMISSION_HH */
@@ -23,7 +23,14 @@ class buffer { public:
     buffer(size_t initial_capacity = 1024);
     ~buffer();
 
+    inline size_t size() const;
+    inline size_t capacity() const;
+    const char *peek(size_t n);
+    inline void consume(size_t n);
+
+    void fill_at_least(fd f, size_t n, event<int> done);
     void fill_until(fd f, char c, size_t max_size, size_t &out_size, event<int> done);
+    void peek_until(fd f, char c, size_t max_size, const char *&data, size_t &len, event<int> done);
     void take_until(fd f, char c, size_t max_size, std::string &str, event<int> done);
 
   private:
@@ -32,15 +39,38 @@ class buffer { public:
     size_t _size;
     size_t _head;
     size_t _tail;
+    std::string _wrapped;
 
+    void grow(size_t min_size);
     ssize_t fill_more(fd f, const event<int> &done);
+    bool scan(char c, size_t &pos, size_t limit) const;
 
+    class closure__fill_at_least__2fdkQi_;
+    void fill_at_least(closure__fill_at_least__2fdkQi_ &);
     class closure__fill_until__2fdckRkQi_;
     void fill_until(closure__fill_until__2fdckRkQi_ &);
+    class closure__peek_until__2fdckRPKcRkQi_;
+    void peek_until(closure__peek_until__2fdckRPKcRkQi_ &);
     class closure__take_until__2fdckRSsQi_;
     void take_until(closure__take_until__2fdckRSsQi_ &);
 
 };
 
+/** @brief  Return the number of buffered bytes not yet consumed. */
+inline size_t buffer::size() const {
+    return _tail - _head;
+}
+
+inline size_t buffer::capacity() const {
+    return _size;
+}
+
+/** @brief  Discard the first @a n buffered bytes.
+ *  @pre    @a n <= size() */
+inline void buffer::consume(size_t n) {
+    assert(n <= size());
+    _head += n;
+}
+
 }
 #endif /* TAMER_BUFFEREDIO_HH */
@@ -2,6 +2,8 @@
 #ifndef TAMER_CHANNEL_HH
 #define TAMER_CHANNEL_HH 1
 #include <deque>
+#include <vector>
+#include <new>
 #include <tamer/event.hh>
 namespace tamer {
 
@@ -93,5 +95,242 @@ inline void channel<T>::pop_back(tamer::event<T> e) {
         waitq_.push_back(TAMER_MOVE(e));
 }
 
+/** @class bounded_channel tamer/channel.hh <tamer/channel.hh>
+ *  @brief  A FIFO channel holding at most capacity() items.
+ *
+ *  push() blocks while the channel is full: its event triggers once the
+ *  item is queued or handed to a consumer. If that event is canceled first
+ *  the item is dropped. Items live in a power-of-two ring allocated once.
+ *
+ *  pop_many() and drain() take up to a whole batch of items per wakeup,
+ *  admitting blocked producers as room opens up. */
+template <typename T>
+class bounded_channel {
+  public:
+    typedef size_t size_type;
+
+    explicit inline bounded_channel(size_type capacity);
+    inline ~bounded_channel();
+
+    inline size_type size() const;
+    inline bool empty() const;
+    inline bool full() const;
+    inline size_type capacity() const;
+
+    inline size_type wait_size() const;
+    inline size_type push_wait_size() const;
+
+    inline bool try_push(T x);
+    inline void push(T x, tamer::event<> done);
+    inline void pop(tamer::event<T> e);
+    inline void pop_many(size_type max, tamer::event<std::vector<T> > e);
+    template <typename F> inline size_type drain(size_type max, F f);
+
+  private:
+    struct waiter {
+        tamer::event<T> one;
+        tamer::event<std::vector<T> > many;
+        size_type max;
+    };
+    struct pusher {
+        T x;
+        tamer::event<> done;
+        pusher(T&& x_, tamer::event<>&& done_)
+            : x(TAMER_MOVE(x_)), done(TAMER_MOVE(done_)) {
+        }
+    };
+
+    T* ring_;
+    size_type mask_;
+    size_type capacity_;
+    size_type head_;
+    size_type n_;
+    std::deque<waiter> waitq_;
+    std::deque<pusher> pushq_;
+
+    inline bool hand_off(T& x);
+    inline void put(T& x);
+    inline T take();
+    inline void admit();
+
+    bounded_channel(const bounded_channel<T>&) = delete;
+    bounded_channel<T>& operator=(const bounded_channel<T>&) = delete;
+};
+
+template <typename T>
+inline bounded_channel<T>::bounded_channel(size_type capacity)
+    : mask_(0), capacity_(capacity ? capacity : 1), head_(0), n_(0) {
+    while (mask_ + 1 < capacity_)
+        mask_ = (mask_ << 1) | 1;
+    ring_ = static_cast<T*>(::operator new(sizeof(T) * (mask_ + 1)));
+}
+
+template <typename T>
+inline bounded_channel<T>::~bounded_channel() {
+    while (n_)
+        (void) take();
+    ::operator delete(ring_);
+}
+
+template <typename T>
+inline typename bounded_channel<T>::size_type bounded_channel<T>::size() const {
+    return n_;
+}
+
+template <typename T>
+inline bool bounded_channel<T>::empty() const {
+    return n_ == 0;
+}
+
+template <typename T>
+inline bool bounded_channel<T>::full() const {
+    return n_ == capacity_;
+}
+
+template <typename T>
+inline typename bounded_channel<T>::size_type bounded_channel<T>::capacity() const {
+    return capacity_;
+}
+
+/** @brief  Return the number of blocked pop() and pop_many() calls. */
+template <typename T>
+inline typename bounded_channel<T>::size_type bounded_channel<T>::wait_size() const {
+    return waitq_.size();
+}
+
+/** @brief  Return the number of blocked push() calls. */
+template <typename T>
+inline typename bounded_channel<T>::size_type bounded_channel<T>::push_wait_size() const {
+    return pushq_.size();
+}
+
+template <typename T>
+inline bool bounded_channel<T>::hand_off(T& x) {
+    while (!waitq_.empty()) {
+        waiter& w = waitq_.front();
+        if (w.one) {
+            w.one(TAMER_MOVE(x));
+            waitq_.pop_front();
+            return true;
+        } else if (std::vector<T>* v = w.many.result_pointer()) {
+            v->clear();
+            v->push_back(TAMER_MOVE(x));
+            w.many.unblock();
+            waitq_.pop_front();
+            return true;
+        }
+        waitq_.pop_front();
+    }
+    return false;
+}
+
+template <typename T>
+inline void bounded_channel<T>::put(T& x) {
+    new((void*) &ring_[(head_ + n_) & mask_]) T(TAMER_MOVE(x));
+    ++n_;
+}
+
+template <typename T>
+inline T bounded_channel<T>::take() {
+    T* p = &ring_[head_];
+    T x(TAMER_MOVE(*p));
+    p->~T();
+    head_ = (head_ + 1) & mask_;
+    --n_;
+    return x;
+}
+
+// Move one blocked producer's item into the ring, skipping canceled ones.
+template <typename T>
+inline void bounded_channel<T>::admit() {
+    while (!pushq_.empty()) {
+        pusher& p = pushq_.front();
+        bool live = p.done;
+        if (live) {
+            put(p.x);
+            p.done();
+        }
+        pushq_.pop_front();
+        if (live)
+            break;
+    }
+}
+
+/** @brief  Queue @a x if there is room, returning false if the channel is
+ *  full. */
+template <typename T>
+inline bool bounded_channel<T>::try_push(T x) {
+    if (hand_off(x))
+        return true;
+    else if (n_ == capacity_)
+        return false;
+    put(x);
+    return true;
+}
+
+template <typename T>
+inline void bounded_channel<T>::push(T x, tamer::event<> done) {
+    if (hand_off(x))
+        done();
+    else if (n_ < capacity_) {
+        put(x);
+        done();
+    } else
+        pushq_.push_back(pusher(TAMER_MOVE(x), TAMER_MOVE(done)));
+}
+
+template <typename T>
+inline void bounded_channel<T>::pop(tamer::event<T> e) {
+    if (!e)
+        return;
+    else if (n_) {
+        e(take());
+        admit();
+    } else {
+        waitq_.push_back(waiter());
+        waitq_.back().one = TAMER_MOVE(e);
+    }
+}
+
+/** @brief  Pop up to @a max items at once.
+ *
+ *  @a e's result vector is cleared and filled in place, so a consumer that
+ *  reuses one vector allocates only as its batches grow. If the channel is
+ *  empty, @a e triggers with the next single item pushed. */
+template <typename T>
+inline void bounded_channel<T>::pop_many(size_type max,
+                                         tamer::event<std::vector<T> > e) {
+    assert(max > 0);
+    std::vector<T>* v = e.result_pointer();
+    if (!v)
+        return;
+    else if (n_) {
+        v->clear();
+        while (n_ && v->size() < max) {
+            v->push_back(take());
+            admit();
+        }
+        e.unblock();
+    } else {
+        waitq_.push_back(waiter());
+        waitq_.back().many = TAMER_MOVE(e);
+        waitq_.back().max = max;
+    }
+}
+
+/** @brief  Call @a f on up to @a max queued items, without blocking.
+ *  @return The number of items passed to @a f. */
+template <typename T> template <typename F>
+inline typename bounded_channel<T>::size_type
+bounded_channel<T>::drain(size_type max, F f) {
+    size_type n = 0;
+    while (n_ && n < max) {
+        f(take());
+        admit();
+        ++n;
+    }
+    return n;
+}
+
 }
 #endif
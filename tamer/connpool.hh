@@ -0,0 +1,138 @@
+#ifndef TAMER_CONNPOOL_HH
+#define TAMER_CONNPOOL_HH 1
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <tamer/fd.hh>
+#include <map>
+#include <list>
+#include <deque>
+namespace tamer {
+
+/** @file <tamer/connpool.hh>
+ *  @brief  A pool of reusable outgoing TCP connections.
+ */
+
+class connection_pool : public tamed_class {
+  public:
+    explicit connection_pool(unsigned max_per_destination = 0,
+                             double idle_timeout = 30);
+    ~connection_pool();
+
+    void acquire(struct in_addr addr, int port, event<fd> done);
+    void release(struct in_addr addr, int port, fd f, bool reusable = true);
+    void clear();
+
+    inline unsigned max_per_destination() const;
+    inline void set_max_per_destination(unsigned n);
+    inline double idle_timeout() const;
+    inline void set_idle_timeout(double t);
+    inline size_t max_idle() const;
+    inline void set_max_idle(size_t n);
+
+    inline size_t nidle() const;
+    inline size_t nactive() const;
+
+  private:
+    typedef std::pair<uint32_t, int> key_type;
+
+    struct idle_conn {
+        fd f;
+        double since;
+        unsigned long id;
+        event<> taken;
+    };
+
+    struct destination {
+        unsigned nactive;
+        std::list<idle_conn> idle;
+        std::deque<event<fd> > waiters;
+        destination() : nactive(0) {}
+    };
+
+    typedef std::map<key_type, destination> dest_map;
+    dest_map dest_;
+    unsigned max_per_destination_;
+    double idle_timeout_;
+    size_t max_idle_;
+    size_t nidle_;
+    size_t nactive_;
+    unsigned long next_id_;
+    bool reaping_;
+
+    bool take_idle(destination& d, event<fd>& done);
+    void dispatch(key_type k, destination& d);
+    void drop_oldest_idle();
+    static inline key_type make_key(struct in_addr addr, int port);
+
+    void connect(key_type k, event<fd> done);
+    void watch(key_type k, unsigned long id);
+    void reap();
+
+    class closure__connect__8key_typeQ2fd_;
+    void connect(closure__connect__8key_typeQ2fd_&);
+    class closure__watch__8key_typem;
+    void watch(closure__watch__8key_typem&);
+    class closure__reap;
+    void reap(closure__reap&);
+
+    connection_pool(const connection_pool&);
+    connection_pool& operator=(const connection_pool&);
+};
+
+/** @brief  Return the most connections handed out at once per destination.
+ *
+ *  0 means no limit. */
+inline unsigned connection_pool::max_per_destination() const {
+    return max_per_destination_;
+}
+
+inline void connection_pool::set_max_per_destination(unsigned n) {
+    max_per_destination_ = n;
+}
+
+/** @brief  Return how long, in seconds, an idle connection is kept. */
+inline double connection_pool::idle_timeout() const {
+    return idle_timeout_;
+}
+
+inline void connection_pool::set_idle_timeout(double t) {
+    idle_timeout_ = t;
+}
+
+/** @brief  Return the most idle connections kept across all destinations. */
+inline size_t connection_pool::max_idle() const {
+    return max_idle_;
+}
+
+inline void connection_pool::set_max_idle(size_t n) {
+    max_idle_ = n;
+    while (nidle_ > max_idle_)
+        drop_oldest_idle();
+}
+
+inline size_t connection_pool::nidle() const {
+    return nidle_;
+}
+
+/** @brief  Return the number of connections handed out or being opened. */
+inline size_t connection_pool::nactive() const {
+    return nactive_;
+}
+
+inline connection_pool::key_type connection_pool::make_key(struct in_addr addr,
+                                                           int port) {
+    return key_type(addr.s_addr, port);
+}
+
+} // namespace tamer
+#endif /* TAMER_CONNPOOL_HH */
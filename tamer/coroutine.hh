@@ -0,0 +1,191 @@
+#ifndef TAMER_COROUTINE_HH
+#define TAMER_COROUTINE_HH 1
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <tamer/event.hh>
+#include <tamer/xdriver.hh>
+#include <coroutine>
+#include <exception>
+#include <type_traits>
+namespace tamer {
+namespace tamerpriv {
+
+// Runtime support for `tamer --coroutines`, which compiles each tamed
+// function to a C++20 coroutine instead of a closure class.
+//
+// The tamed function itself becomes a wrapper that fills in a struct of
+// pointers to its arguments, derived from coroutine_args, and calls the
+// coroutine with it. The coroutine moves the arguments into its frame
+// before it first suspends. Each frame holds a coroutine_closure, so
+// blocked coroutines look like any other blocked closure to the drivers,
+// to tamed_class, and to driver::blocked_locations().
+
+struct coroutine_args {
+};
+
+class coroutine_closure : public closure {
+  public:
+    std::coroutine_handle<> handle_;
+
+    static void activate(closure* c);
+
+    // An exception that escaped a coroutine, rethrown by the wrapper or
+    // activator that was running it.
+    static inline thread_local std::exception_ptr pending;
+};
+
+// Rethrow any exception that escaped a coroutine run from this frame.
+inline void coroutine_rethrow() {
+    if (coroutine_closure::pending) {
+        std::exception_ptr x = TAMER_MOVE(coroutine_closure::pending);
+        coroutine_closure::pending = nullptr;
+        std::rethrow_exception(x);
+    }
+}
+
+inline void coroutine_closure::activate(closure* c) {
+    std::coroutine_handle<> h = static_cast<coroutine_closure*>(c)->handle_;
+    // tamed_class destruction and hard_free() ask blocked closures to exit
+    if (c->tamer_block_position_ == (unsigned) -1)
+        h.destroy();
+    else
+        h.resume();
+    coroutine_rethrow();
+}
+
+class coroutine_promise {
+  public:
+    template <typename A>
+    explicit inline coroutine_promise(A&) {
+        c_.initialize_closure(coroutine_closure::activate);
+    }
+    // Member coroutines register with their object, as closures do, so a
+    // tamed_class's destructor can end them.
+    template <typename K, typename A>
+    inline coroutine_promise(K& self, A&) {
+        c_.initialize_closure(coroutine_closure::activate, &self);
+    }
+
+    inline closure& tamer_closure() {
+        return c_;
+    }
+
+    inline void get_return_object() {
+        c_.handle_ = std::coroutine_handle<coroutine_promise>::from_promise(*this);
+    }
+    inline std::suspend_never initial_suspend() const noexcept {
+        return std::suspend_never();
+    }
+    inline std::suspend_never final_suspend() const noexcept {
+        return std::suspend_never();
+    }
+    inline void return_void() const noexcept {
+    }
+    inline void unhandled_exception() {
+        coroutine_closure::pending = std::current_exception();
+    }
+
+    static inline void* operator new(size_t size) {
+#if TAMER_CLOSURE_POOL
+        return closure_pool::local.allocate(size);
+#else
+        return ::operator new(size);
+#endif
+    }
+    static inline void operator delete(void* p, size_t size) noexcept {
+#if TAMER_CLOSURE_POOL
+        closure_pool::local.deallocate(p, size);
+#else
+        (void) size;
+        ::operator delete(p);
+#endif
+    }
+
+  private:
+    coroutine_closure c_;
+};
+
+// co_await coroutine_block(r, ...) blocks on rendezvous @a r until the
+// driver unblocks it. Callers loop on r.has_waiting() or r.join().
+template <typename R>
+class coroutine_blocker {
+  public:
+    inline coroutine_blocker(R& r, const char* file, int line,
+                             const std::string* description)
+        : r_(r), file_(file), line_(line), description_(description) {
+    }
+    inline bool await_ready() const noexcept {
+        return false;
+    }
+    inline void await_suspend(std::coroutine_handle<coroutine_promise> h) {
+        closure& c = h.promise().tamer_closure();
+        c.set_location(file_, line_);
+        if (description_)
+            c.set_description(*description_);
+        r_.block(c, 1);
+    }
+    inline void await_resume() const noexcept {
+    }
+  private:
+    R& r_;
+    const char* file_;
+    int line_;
+    const std::string* description_;
+};
+
+template <typename R>
+inline coroutine_blocker<R> coroutine_block(R& r, const char* file, int line) {
+    return coroutine_blocker<R>(r, file, line, 0);
+}
+
+template <typename R>
+inline coroutine_blocker<R> coroutine_block(R& r, const char* file, int line,
+                                            const std::string& description) {
+    return coroutine_blocker<R>(r, file, line, &description);
+}
+
+// co_await coroutine_self() returns the running coroutine's closure, for
+// tamer::destroy_guard. It never suspends.
+class coroutine_self {
+  public:
+    inline bool await_ready() const noexcept {
+        return false;
+    }
+    inline bool await_suspend(std::coroutine_handle<coroutine_promise> h) noexcept {
+        c_ = &h.promise().tamer_closure();
+        return false;
+    }
+    inline closure& await_resume() const noexcept {
+        return *c_;
+    }
+  private:
+    closure* c_;
+};
+
+} // namespace tamerpriv
+} // namespace tamer
+
+namespace std {
+template <typename A>
+    requires std::is_base_of_v<tamer::tamerpriv::coroutine_args, A>
+struct coroutine_traits<void, A&> {
+    typedef tamer::tamerpriv::coroutine_promise promise_type;
+};
+
+template <typename K, typename A>
+    requires std::is_base_of_v<tamer::tamerpriv::coroutine_args, A>
+struct coroutine_traits<void, K&, A&> {
+    typedef tamer::tamerpriv::coroutine_promise promise_type;
+};
+} // namespace std
+#endif /* TAMER_COROUTINE_HH */
@@ -13,25 +13,50 @@
  */
 #include "config.h"
 #include "dinternal.hh"
+#include <tamer/xadapter.hh>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <sstream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#if HAVE_SYS_EVENTFD_H
+# include <sys/eventfd.h>
+#endif
+#if TAMER_THREADS
+# include <mutex>
+#endif
+#if HAVE_TAMER_FILEIO
+# include "fdio.hh"
+#endif
 
 namespace tamer {
 namespace tamerpriv {
-timeval recent;
-bool need_recent = true;
+TAMER_THREAD_LOCAL timeval recent;
+TAMER_THREAD_LOCAL bool need_recent = true;
 time_type_t time_type = time_normal;
 static timeval virtual_offset = { 1000000000, 0 };
 simple_driver simple_driver::immediate_driver;
 } // namespace tamerpriv
 
-driver* driver::main;
+TAMER_THREAD_LOCAL driver* driver::main;
+driver* driver::sig_driver;
 driver* driver::indexed[capacity];
 int driver::next_index;
+#if TAMER_THREADS
+static std::mutex indexed_lock;
+#endif
 
-driver::driver() {
+driver::driver()
+    : timer_slack_(0), stats_(0), stats_mark_(0), posted_(0),
+      post_signaled_(false), npost_expected_(0) {
+    make_post_fd();
+
+#if TAMER_THREADS
+    std::lock_guard<std::mutex> guard(indexed_lock);
+#endif
     if (next_index < capacity) {
         index_ = next_index;
         ++next_index;
@@ -43,9 +68,107 @@ driver::driver() {
 }
 
 driver::~driver() {
+    delete stats_;
+    // drop undelivered posts; their events are cancelled in this thread
+    tamerpriv::post_node* n = posted_.exchange(0);
+    while (n) {
+        tamerpriv::post_node* next = n->post_next_;
+        delete n;
+        n = next;
+    }
+    if (post_fd_[0] >= 0)
+        close(post_fd_[0]);
+    if (post_fd_[1] >= 0 && post_fd_[1] != post_fd_[0])
+        close(post_fd_[1]);
+
+#if TAMER_THREADS
+    std::lock_guard<std::mutex> guard(indexed_lock);
+#endif
     indexed[index_] = 0;
     if (main == this)
         main = 0;
+    if (sig_driver == this)
+        sig_driver = 0;
+}
+
+void driver::make_post_fd() {
+    post_pid_ = getpid();
+#if HAVE_SYS_EVENTFD_H
+    post_fd_[0] = post_fd_[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+    post_fd_[0] = post_fd_[1] = -1;
+    if (pipe(post_fd_) >= 0)
+        for (int i = 0; i != 2; ++i) {
+            fcntl(post_fd_[i], F_SETFL, O_NONBLOCK);
+            fcntl(post_fd_[i], F_SETFD, FD_CLOEXEC);
+        }
+#endif
+}
+
+void driver::remake_post_fd() {
+    if (post_fd_[0] >= 0)
+        close(post_fd_[0]);
+    if (post_fd_[1] >= 0 && post_fd_[1] != post_fd_[0])
+        close(post_fd_[1]);
+    make_post_fd();
+    // posts queued before the fork still need a wakeup
+    post_signaled_.store(false, std::memory_order_release);
+    if (has_posted())
+        wake_post();
+}
+
+void driver::post(tamerpriv::post_node* n, bool expected) {
+    n->post_expected_ = expected;
+    // Treiber stack push: producers never block one another for long, and
+    // the owning driver takes the whole stack with one exchange.
+    tamerpriv::post_node* head = posted_.load(std::memory_order_relaxed);
+    do {
+        n->post_next_ = head;
+    } while (!posted_.compare_exchange_weak(head, n,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed));
+    wake_post();
+}
+
+void driver::wake_post() {
+    // Wake the driver, but only once per drain.
+    if (!post_signaled_.exchange(true, std::memory_order_acq_rel)
+        && post_fd_[1] >= 0) {
+#if HAVE_SYS_EVENTFD_H
+        uint64_t one = 1;
+        ssize_t r = write(post_fd_[1], &one, sizeof(one));
+#else
+        ssize_t r = write(post_fd_[1], "", 1);
+#endif
+        (void) r;
+    }
+}
+
+void driver::run_posted() {
+    if (post_fd_[0] >= 0) {
+        char buf[64];
+        while (read(post_fd_[0], buf, sizeof(buf)) > 0)
+            /* do nothing */;
+    }
+    post_signaled_.store(false, std::memory_order_release);
+
+    tamerpriv::post_node* n = posted_.exchange(0, std::memory_order_acquire);
+    // restore posting order
+    tamerpriv::post_node* fifo = 0;
+    while (n) {
+        tamerpriv::post_node* next = n->post_next_;
+        n->post_next_ = fifo;
+        fifo = n;
+        n = next;
+    }
+    while (fifo) {
+        tamerpriv::post_node* next = fifo->post_next_;
+        npost_expected_ -= fifo->post_expected_;
+        fifo->post_run();
+        delete fifo;
+        fifo = next;
+    }
+    run_unblocked();
 }
 
 void driver::blocked_locations(std::vector<std::string>& x) {
@@ -57,13 +180,19 @@ void driver::blocked_locations(std::vector<std::string>& x) {
 void driver::set_error_handler(error_handler_type) {
 }
 
+void driver::set_busy_poll(int) {
+}
+
 bool initialize(int flags) {
     if (driver::main)
         return true;
 
-    if (!(flags & (init_tamer | init_libevent | init_libev | init_strict))) {
+    if (!(flags & (init_tamer | init_libevent | init_libev | init_uring
+                   | init_strict))) {
         const char* dname = getenv("TAMER_DRIVER");
-        if (dname && strcmp(dname, "libev") == 0)
+        if (dname && strcmp(dname, "uring") == 0)
+            flags |= init_uring;
+        else if (dname && strcmp(dname, "libev") == 0)
             flags |= init_libev;
         else if (dname && strcmp(dname, "libevent") == 0)
             flags |= init_libevent;
@@ -71,6 +200,8 @@ bool initialize(int flags) {
             flags |= init_tamer;
     }
 
+    if (!driver::main && (flags & init_uring))
+        driver::main = driver::make_uring(flags);
     if (!driver::main && (flags & init_libev))
         driver::main = driver::make_libev();
     if (!driver::main && (flags & init_libevent))
@@ -80,12 +211,37 @@ bool initialize(int flags) {
     if (!driver::main)
         return false;
 
+    if (!driver::sig_driver)
+        driver::sig_driver = driver::main;
     if (!(flags & init_sigpipe))
         signal(SIGPIPE, SIG_IGN);
     return true;
 }
 
+bool initialize_thread(int flags) {
+#if TAMER_THREADS
+    if (driver::main)
+        return true;
+
+    // libev's default loop and libevent's global base are process-wide
+    if ((flags & (init_libev | init_libevent)) && (flags & init_strict)
+        && !(flags & (init_tamer | init_uring)))
+        return false;
+    if (flags & init_uring)
+        driver::main = driver::make_uring(flags);
+    if (!driver::main && ((flags & init_tamer) || !(flags & init_strict)))
+        driver::main = driver::make_tamer(flags);
+    return driver::main != 0;
+#else
+    return initialize(flags);
+#endif
+}
+
 void cleanup() {
+#if HAVE_TAMER_FILEIO
+    // file I/O workers report to the driver, so stop them first
+    tamerpriv::file_io::cleanup();
+#endif
     while (driver::main->has_unblocked())
         driver::main->run_unblocked();
     delete driver::main;
@@ -117,21 +273,83 @@ timeval now() {
     return tamerpriv::recent;
 }
 
+static timeval delay_expiry(double delay) {
+    timeval tv = recent();
+    long ldelay = (long) delay;
+    tv.tv_sec += ldelay;
+    tv.tv_usec += (long) ((delay - ldelay) * 1000000 + 0.5);
+    if (tv.tv_usec >= 1000000) {
+        tv.tv_sec++;
+        tv.tv_usec -= 1000000;
+    }
+    return tv;
+}
+
+// Slack in microseconds, capped at 4000 seconds to fit in an unsigned.
+static unsigned slack_usec(double slack) {
+    if (slack <= 0)
+        return 0;
+    else if (slack >= 4000)
+        return 4000000000U;
+    else
+        return (unsigned) (slack * 1000000 + 0.5);
+}
+
 void driver::at_delay(double delay, event<> e, bool bg)
 {
     if (delay <= 0)
         at_asap(e);
-    else {
-        timeval tv = recent();
-        long ldelay = (long) delay;
-        tv.tv_sec += ldelay;
-        tv.tv_usec += (long) ((delay - ldelay) * 1000000 + 0.5);
-        if (tv.tv_usec >= 1000000) {
-            tv.tv_sec++;
-            tv.tv_usec -= 1000000;
-        }
-        at_time(tv, e, bg);
-    }
+    else
+        at_slack_time(delay_expiry(delay), e, bg, timer_slack_);
+}
+
+/** @brief  Register event for a given delay, with timer slack.
+ *  @param  delay  Delay time.
+ *  @param  e      Event.
+ *  @param  slack  Acceptable lateness, in seconds.
+ *  @param  bg     If true, the timer does not keep the driver loop alive.
+ *
+ *  Triggers @a e at some point in [@a delay, @a delay + @a slack) seconds
+ *  after recent(). The driver rounds the expiry so that timers with
+ *  overlapping windows fire together. A @a slack of 0 asks for an exact
+ *  timer, even if the driver has a default slack. */
+void driver::at_delay_slack(double delay, event<> e, double slack, bool bg)
+{
+    if (delay <= 0)
+        at_asap(e);
+    else
+        at_slack_time(delay_expiry(delay), e, bg, slack_usec(slack));
+}
+
+/** @brief  Set the default timer slack.
+ *  @param  slack  Acceptable lateness, in seconds.
+ *
+ *  Relative timers, from at_delay() and its variants and from
+ *  with_timeout(), may then fire up to @a slack late, so that timers with
+ *  nearby expiries share one wakeup. at_time() stays exact. The default
+ *  is 0. */
+void driver::set_timer_slack(double slack)
+{
+    timer_slack_ = slack_usec(slack);
+}
+
+/** @brief  Trigger @a e at @a expiry unless it triggers first.
+ *
+ *  Sets @a result to 0 now. If @a expiry passes before @a e triggers, then
+ *  @a result is set to -ETIMEDOUT and @a e is unblocked (triggered without
+ *  a value). The built-in drivers keep @a result in the timer itself, so
+ *  this allocates nothing beyond the timer. */
+void driver::at_deadline(const timeval& expiry, event<> e, int& result) {
+    result = 0;
+    at_time(expiry, tamerpriv::with_helper(e, &result, -ETIMEDOUT), false);
+}
+
+/** @brief  Note that I/O on @a fd in direction @a action returned EAGAIN.
+ *
+ *  Drivers that track readiness themselves, like the tamer driver with
+ *  init_epoll_et, consider @a fd ready from its last readiness edge until
+ *  this is called. Others ignore it. */
+void driver::note_would_block(int, int) {
 }
 
 timeval driver::next_wake() const {
@@ -139,34 +357,172 @@ timeval driver::next_wake() const {
     return unknown;
 }
 
+static inline double monotonic_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.;
+}
+
+/** @brief  Start or stop collecting event-loop statistics.
+ *
+ *  Statistics cost two clock reads per trip through the loop, so they are
+ *  off by default. Turning them off discards the counters.
+ *  @sa stats() */
+void driver::enable_stats(bool on) {
+    if (on && !stats_) {
+        stats_ = new driver_stats();
+        stats_mark_ = monotonic_now();
+    } else if (!on) {
+        delete stats_;
+        stats_ = 0;
+    }
+}
+
+/** @brief  Copy this driver's statistics into @a st.
+ *  @return  False, leaving @a st alone, if statistics are not enabled.
+ *
+ *  Like the driver itself, this must be called from the driver's thread. */
+bool driver::stats(driver_stats& st) const {
+    if (!stats_)
+        return false;
+    st = *stats_;
+    st.nunblocked = nunblocked();
+    return true;
+}
+
+/** @brief  Zero the statistics counters, if they are enabled. */
+void driver::reset_stats() {
+    if (stats_) {
+        *stats_ = driver_stats();
+        stats_mark_ = monotonic_now();
+    }
+}
+
+/** @brief  Return how long the current trip through the loop has run.
+ *
+ *  Called from a closure, this is how long the driver has gone without
+ *  checking for new events. It is zero unless statistics are enabled and
+ *  the driver collects them. @sa driver_stats::avg_lag */
+double driver::loop_lag() const {
+    if (!stats_ || !stats_->loops)
+        return 0;
+    return monotonic_now() - stats_mark_;
+}
+
+/** @brief  Report the memory this driver and its thread use into @a m.
+ *
+ *  Counts capacity, not just what is in use: a descriptor table sized for
+ *  a million connections stays that size after they close. Closure fields
+ *  are zero unless Tamer was configured with the closure pool. Like the
+ *  driver itself, this must be called from the driver's thread.
+ *  @sa http_parser::buffer_memory() */
+void driver::memory_usage(driver_memory& m) const {
+    m = driver_memory();
+    m.small_objects = tamerpriv::slab_bytes;
+#if TAMER_CLOSURE_POOL
+    m.closures = tamerpriv::closure_pool::local.live_bytes();
+    m.closure_cache = tamerpriv::closure_pool::local.cached_bytes();
+#endif
+}
+
+void driver::record_wait_begin() {
+    double t = monotonic_now(), ran = t - stats_mark_;
+    stats_->run_time += ran;
+    if (ran > stats_->max_lag)
+        stats_->max_lag = ran;
+    stats_->avg_lag += (ran - stats_->avg_lag) / 8;
+    uint64_t usec = (uint64_t) (ran * 1000000);
+    int b = 0;
+    for (; usec && b != driver_stats::nlag - 1; usec >>= 1)
+        ++b;
+    ++stats_->lag[b];
+    stats_mark_ = t;
+}
+
+void driver::record_wait_end(unsigned nevents) {
+    double t = monotonic_now();
+    stats_->block_time += t - stats_mark_;
+    ++stats_->loops;
+    stats_->fd_events += nevents;
+    stats_mark_ = t;
+}
+
 
 namespace tamerpriv {
 
 driver_asapset::~driver_asapset() {
-    while (!empty()) {
-        simple_event::unuse(ses_[head_ & capmask_]);
-        ++head_;
+    for (int p = 0; p != npriority; ++p) {
+        queue& q = q_[p];
+        for (; q.head != q.tail; ++q.head)
+            simple_event::unuse(q.ses[q.head & q.capmask]);
+        delete[] q.ses;
     }
-    delete[] ses_;
 }
 
-void driver_asapset::expand() {
-    unsigned ncapmask = (capmask_ + 1 ? capmask_ * 4 + 3 : 31);
+void driver_asapset::expand(queue& q) {
+    unsigned ncapmask = (q.capmask + 1 ? q.capmask * 4 + 3 : 31);
     tamerpriv::simple_event **na = new tamerpriv::simple_event *[ncapmask + 1];
     unsigned i = 0;
-    for (unsigned x = head_; x != tail_; ++x, ++i)
-        na[i] = ses_[x & capmask_];
-    delete[] ses_;
-    ses_ = na;
-    capmask_ = ncapmask;
-    head_ = 0;
-    tail_ = i;
+    for (unsigned x = q.head; x != q.tail; ++x, ++i)
+        na[i] = q.ses[x & q.capmask];
+    delete[] q.ses;
+    q.ses = na;
+    q.capmask = ncapmask;
+    q.head = 0;
+    q.tail = i;
 }
 
 driver_timerset::~driver_timerset() {
     for (unsigned i = 0; i != nts_; ++i)
         simple_event::unuse(ts_[i].se);
     delete[] ts_;
+    if (wheel_) {
+        for (unsigned i = 0; i != wheel_size; ++i)
+            while (wnode* n = wheel_[i]) {
+                wheel_[i] = n->next;
+                if (!simple_event::remove_at_trigger(n->se, wheel_disinterest, n))
+                    n->state = wnode_heap;
+                simple_event::unuse(n->se);
+            }
+        wheel_cull();
+        delete[] wheel_;
+        delete[] wheel_map_;
+    }
+    // An event that moved to the heap, or whose at_trigger couldn't be
+    // removed, still points at its node and will call wheel_disinterest
+    // when it triggers. Such a node's block stays until the last of them
+    // reports in.
+    for (std::vector<wblock*>::iterator it = wblocks_.begin();
+         it != wblocks_.end(); ++it) {
+        wblock* b = *it;
+        b->norphans = 0;
+        for (unsigned i = 0; i != wblock_size; ++i)
+            if (b->n[i].state == wnode_heap) {
+                b->n[i].state = wnode_orphan;
+                b->n[i].owner = 0;
+                ++b->norphans;
+            }
+        if (!b->norphans)
+            delete b;
+    }
+}
+
+void driver_timerset::enable_wheel() {
+    if (!wheel_) {
+        wheel_ = new wnode*[wheel_size];
+        memset(wheel_, 0, sizeof(wnode*) * wheel_size);
+        wheel_map_ = new uint64_t[wheel_size / 64];
+        memset(wheel_map_, 0, sizeof(uint64_t) * (wheel_size / 64));
+        wheel_cursor_ = wheel_tick(tamer::recent());
+    }
+}
+
+size_t driver_timerset::memory() const {
+    size_t n = sizeof(trec) * tcap_
+        + sizeof(wblock) * wblocks_.size();
+    if (wheel_)
+        n += sizeof(wnode*) * wheel_size + sizeof(uint64_t) * (wheel_size / 64);
+    return n;
 }
 
 void driver_timerset::check() {
@@ -217,20 +573,28 @@ void driver_timerset::expand() {
     tcap_ = ncap;
 }
 
-void driver_timerset::push(timeval when, simple_event* se, bool bg) {
-    using std::swap;
+void driver_timerset::push(timeval when, simple_event* se, bool bg,
+                           int* result) {
     assert(!se->empty());
+    order_ += 2;
+    if (!wheel_ || !wheel_push(when, order_ + !bg, se, result))
+        heap_push(when, order_ + !bg, se, result);
+}
+
+void driver_timerset::heap_push(timeval when, unsigned order,
+                                simple_event* se, int* result) {
+    using std::swap;
 
     // Append new trec
     if (nts_ == tcap_)
         expand();
     unsigned pos = nts_;
     ts_[pos].when = when;
-    order_ += 2;
-    ts_[pos].order = order_ + !bg;
+    ts_[pos].order = order;
     ts_[pos].se = se;
+    ts_[pos].result = result;
     ++nts_;
-    nfg_ += !bg;
+    nfg_ += order & 1;
 
     // Swap trec to proper position in heap
     while (pos != 0) {
@@ -260,6 +624,8 @@ void driver_timerset::hard_cull(unsigned pos) const {
 
     if (pos == (unsigned) -1) {
         pos = 0;
+        if (ts_[pos].result && !ts_[pos].se->empty())
+            *ts_[pos].result = -ETIMEDOUT;
         ts_[pos].se->simple_trigger(false);
     } else
         ts_[pos].clean();
@@ -291,5 +657,149 @@ void driver_timerset::hard_cull(unsigned pos) const {
     }
 }
 
+bool driver_timerset::wheel_push(timeval when, unsigned order,
+                                 simple_event* se, int* result) {
+    uint64_t tick = wheel_tick(when);
+    if (tick <= wheel_cursor_ + 1)
+        // near-term: the heap is exact and cheap for these
+        return false;
+
+    if (!wfree_) {
+        wblock* block = new wblock;
+        wblocks_.push_back(block);
+        for (unsigned i = 0; i != wblock_size; ++i) {
+            block->n[i].state = wnode_free;
+            block->n[i].block = block;
+            block->n[i].next = wfree_;
+            wfree_ = &block->n[i];
+        }
+    }
+    wnode* n = wfree_;
+    wfree_ = n->next;
+
+    n->when = when;
+    n->order = order;
+    n->state = wnode_slot;
+    n->se = se;
+    n->result = result;
+    n->tick = tick;
+    n->owner = this;
+    unsigned slot = tick & wheel_mask;
+    n->pprev = &wheel_[slot];
+    n->next = wheel_[slot];
+    if (n->next)
+        n->next->pprev = &n->next;
+    wheel_[slot] = n;
+    wheel_map_[slot / 64] |= uint64_t(1) << (slot % 64);
+    ++wheel_n_;
+    wheel_nfg_ += order & 1;
+    simple_event::at_trigger(se, wheel_disinterest, n);
+
+    if (!wheel_dirty_ && (wheel_n_ == 1 || wheel_tick(wheel_next_) > tick))
+        wheel_dirty_ = true;
+    return true;
+}
+
+void driver_timerset::wheel_disinterest(void* arg) {
+    wnode* n = static_cast<wnode*>(arg);
+    driver_timerset* ts = n->owner;
+    if (n->state == wnode_slot) {
+        // Cancelled while waiting in the wheel: unlink now. The event is
+        // released in cull(), since our caller may still be walking it.
+        unsigned slot = n->tick & wheel_mask;
+        *n->pprev = n->next;
+        if (n->next)
+            n->next->pprev = n->pprev;
+        if (!ts->wheel_[slot])
+            ts->wheel_map_[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+        --ts->wheel_n_;
+        ts->wheel_nfg_ -= n->order & 1;
+        ts->wheel_dirty_ = true;
+        n->state = wnode_dead;
+        n->next = ts->wdead_;
+        ts->wdead_ = n;
+    } else if (n->state == wnode_heap) {
+        // The heap owns the event; we only held on for this callback.
+        n->state = wnode_free;
+        n->next = ts->wfree_;
+        ts->wfree_ = n;
+    } else if (n->state == wnode_orphan) {
+        // the timerset is gone
+        n->state = wnode_free;
+        if (--n->block->norphans == 0)
+            delete n->block;
+    }
+}
+
+void driver_timerset::wheel_cull() {
+    while (wnode* n = wdead_) {
+        wdead_ = n->next;
+        simple_event::unuse_clean(n->se);
+        n->state = wnode_free;
+        n->next = wfree_;
+        wfree_ = n;
+    }
+}
+
+const timeval& driver_timerset::wheel_expiry() const {
+    if (wheel_dirty_) {
+        // find the next occupied slot after the cursor
+        unsigned start = (wheel_cursor_ + 1) & wheel_mask;
+        unsigned slot = start, dist = 0;
+        while (true) {
+            uint64_t bits = wheel_map_[slot / 64] >> (slot % 64);
+            if (bits) {
+                unsigned skip = __builtin_ctzll(bits);
+                slot += skip;
+                dist += skip;
+                break;
+            }
+            unsigned skip = 64 - slot % 64;
+            slot = (slot + skip) & wheel_mask;
+            dist += skip;
+            assert(dist < 2 * wheel_size);
+        }
+        uint64_t usec = (wheel_cursor_ + 1 + dist) << wheel_shift;
+        wheel_next_.tv_sec = usec / 1000000;
+        wheel_next_.tv_usec = usec % 1000000;
+        wheel_dirty_ = false;
+    }
+    if (nts_ != 0 && !timercmp(&wheel_next_, &ts_[0].when, <))
+        return ts_[0].when;
+    else
+        return wheel_next_;
+}
+
+void driver_timerset::wheel_advance() {
+    // open the next occupied slot, moving its due entries into the heap
+    wheel_expiry();
+    uint64_t tick = wheel_tick(wheel_next_);
+    unsigned slot = tick & wheel_mask;
+    wheel_cursor_ = tick;
+    wnode** pprev = &wheel_[slot];
+    while (wnode* n = *pprev) {
+        if (n->tick > tick) {
+            // a later revolution of the wheel
+            pprev = &n->next;
+            continue;
+        }
+        *pprev = n->next;
+        if (n->next)
+            n->next->pprev = pprev;
+        --wheel_n_;
+        wheel_nfg_ -= n->order & 1;
+        heap_push(n->when, n->order, n->se, n->result);
+        if (simple_event::remove_at_trigger(n->se, wheel_disinterest, n)) {
+            n->state = wnode_free;
+            n->next = wfree_;
+            wfree_ = n;
+        } else
+            n->state = wnode_heap;
+    }
+    if (!wheel_[slot])
+        wheel_map_[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+    wheel_dirty_ = true;
+}
+
 } // namespace tamerpriv
 } // namespace tamer
@@ -4,6 +4,7 @@
 #include <tamer/driver.hh>
 #include <sys/types.h>
 #include <string.h>
+#include <vector>
 namespace tamer {
 namespace tamerpriv {
 
@@ -27,6 +28,7 @@ struct driver_fdset {
     inline bool has_change() const;
 
     inline int size() const;
+    inline size_t memory() const;
     inline const driver_fd<T>& operator[](int fd) const;
     inline driver_fd<T>& operator[](int fd);
 
@@ -50,27 +52,39 @@ struct driver_asapset {
     ~driver_asapset();
 
     inline bool empty() const;
-    inline void push(simple_event* se);
+    inline unsigned size() const;
+    inline size_t memory() const;
+    inline void push(simple_event* se, priority_class p = priority_normal);
     inline void pop_trigger();
+    inline void run(unsigned low_budget);
 
   private:
-    simple_event** ses_;
-    unsigned head_;
-    unsigned tail_;
-    unsigned capmask_;
+    struct queue {
+        simple_event** ses;
+        unsigned head;
+        unsigned tail;
+        unsigned capmask;
+    };
+    enum { npriority = priority_low + 1 };
+    queue q_[npriority];
 
-    void expand();
+    inline bool trigger_first(int maxp);
+    void expand(queue& q);
 };
 
 struct driver_timerset {
     inline driver_timerset();
     ~driver_timerset();
 
+    void enable_wheel();
+
     inline bool empty() const;
+    inline unsigned size() const;
+    size_t memory() const;
     inline bool has_foreground() const;
     inline const timeval &expiry() const;
     inline void cull();
-    void push(timeval when, simple_event* se, bool bg);
+    void push(timeval when, simple_event* se, bool bg, int* result = 0);
     inline void pop_trigger();
 
     void check();
@@ -80,10 +94,43 @@ struct driver_timerset {
         timeval when;
         unsigned order;
         simple_event* se;
+        int* result;            // set to -ETIMEDOUT if this timer fires
         inline bool operator<(const trec &x) const;
         inline void clean();
     };
 
+    // Timers more than a couple of ticks away live in a hashed timing wheel
+    // rather than the heap. A wheel entry unlinks itself as soon as its event
+    // is cancelled, so abandoned timeouts never reach the heap. When the
+    // wheel reaches a slot, its due entries move to the heap, which keeps
+    // exact ordering for near-term deadlines.
+    struct wblock;
+    struct wnode {
+        timeval when;
+        unsigned order;
+        int state;
+        simple_event* se;
+        int* result;
+        uint64_t tick;
+        wnode* next;
+        wnode** pprev;
+        driver_timerset* owner;
+        wblock* block;
+    };
+    enum { wnode_free = 0, wnode_slot = 1, wnode_dead = 2, wnode_heap = 3,
+           wnode_orphan = 4 };
+    enum { wheel_shift = 14,    // one tick is 2^14 usec, about 16ms
+           wheel_order = 12,
+           wheel_size = 1 << wheel_order,
+           wheel_mask = wheel_size - 1,
+           wblock_size = 256 };
+    // Blocks outlive the timerset while events still point at their
+    // nodes; see ~driver_timerset.
+    struct wblock {
+        unsigned norphans;
+        wnode n[wblock_size];
+    };
+
     enum { arity = 4 };
     trec *ts_;
     mutable unsigned nts_;
@@ -92,11 +139,32 @@ struct driver_timerset {
     unsigned tcap_;
     unsigned order_;
 
+    wnode** wheel_;
+    uint64_t* wheel_map_;
+    unsigned wheel_n_;
+    unsigned wheel_nfg_;
+    uint64_t wheel_cursor_;
+    mutable timeval wheel_next_;
+    mutable bool wheel_dirty_;
+    wnode* wfree_;
+    wnode* wdead_;
+    std::vector<wblock*> wblocks_;
+
     static inline unsigned heap_parent(unsigned i);
     static inline unsigned heap_first_child(unsigned i);
     inline unsigned heap_last_child(unsigned i) const;
     void hard_cull(unsigned pos) const;
+    void heap_push(timeval when, unsigned order, simple_event* se,
+                   int* result);
     void expand();
+
+    static inline uint64_t wheel_tick(const timeval& tv);
+    const timeval& wheel_expiry() const;
+    bool wheel_push(timeval when, unsigned order, simple_event* se,
+                    int* result);
+    void wheel_advance();
+    void wheel_cull();
+    static void wheel_disinterest(void* arg);
 };
 
 
@@ -164,6 +232,14 @@ void driver_fdset<T>::hard_expand(O owner, int need_fd) {
     }
 }
 
+template <typename T>
+inline size_t driver_fdset<T>::memory() const {
+    size_t n = sizeof(driver_fd<T>) * fdcap_;
+    if (fdcap_ > fdblksiz)
+        n += sizeof(driver_fd<T>*) * (fdcap_ / fdblksiz);
+    return n;
+}
+
 template <typename T>
 inline bool driver_fdset<T>::has_change() const {
     return changedfd1_ != 0;
@@ -220,50 +296,109 @@ inline int fd_callback_fd(void* callback) {
     return x / driver::capacity;
 }
 
-inline driver_asapset::driver_asapset()
-    : ses_(), head_(0), tail_(0), capmask_(~0U) {
+inline driver_asapset::driver_asapset() {
+    for (int p = 0; p != npriority; ++p) {
+        q_[p].ses = 0;
+        q_[p].head = q_[p].tail = 0;
+        q_[p].capmask = ~0U;
+    }
 }
 
 inline bool driver_asapset::empty() const {
-    return head_ == tail_;
+    return size() == 0;
+}
+
+inline unsigned driver_asapset::size() const {
+    unsigned n = 0;
+    for (int p = 0; p != npriority; ++p)
+        n += q_[p].tail - q_[p].head;
+    return n;
+}
+
+inline size_t driver_asapset::memory() const {
+    size_t n = 0;
+    for (int p = 0; p != npriority; ++p)
+        if (q_[p].ses)
+            n += sizeof(simple_event*) * (q_[p].capmask + 1);
+    return n;
+}
+
+inline void driver_asapset::push(simple_event *se, priority_class p) {
+    queue& q = q_[p];
+    if (q.tail - q.head == q.capmask + 1)
+        expand(q);
+    q.ses[q.tail & q.capmask] = se;
+    ++q.tail;
 }
 
-inline void driver_asapset::push(simple_event *se) {
-    if (tail_ - head_ == capmask_ + 1)
-        expand();
-    ses_[tail_ & capmask_] = se;
-    ++tail_;
+inline bool driver_asapset::trigger_first(int maxp) {
+    for (int p = 0; p <= maxp; ++p) {
+        queue& q = q_[p];
+        if (q.head != q.tail) {
+            simple_event *se = q.ses[q.head & q.capmask];
+            ++q.head;
+            se->simple_trigger(false);
+            return true;
+        }
+    }
+    return false;
 }
 
+/** @brief Trigger the highest-priority event. */
 inline void driver_asapset::pop_trigger() {
-    assert(head_ != tail_);
-    simple_event *se = ses_[head_ & capmask_];
-    ++head_;
-    se->simple_trigger(false);
+    bool ok = trigger_first(priority_low);
+    assert(ok);
+    (void) ok;
+}
+
+/** @brief Trigger events until only low-priority events remain and
+    @a low_budget of those have also been triggered. */
+inline void driver_asapset::run(unsigned low_budget) {
+    while (1) {
+        if (trigger_first(priority_normal))
+            continue;
+        if (low_budget == 0 || !trigger_first(priority_low))
+            break;
+        --low_budget;
+    }
 }
 
 inline driver_timerset::driver_timerset()
-    : ts_(0), nts_(0), nfg_(0), rand_(8173), tcap_(0), order_(0) {
+    : ts_(0), nts_(0), nfg_(0), rand_(8173), tcap_(0), order_(0),
+      wheel_(0), wheel_map_(0), wheel_n_(0), wheel_nfg_(0), wheel_cursor_(0),
+      wheel_dirty_(false), wfree_(0), wdead_(0) {
 }
 
 inline bool driver_timerset::empty() const {
-    return nts_ == 0;
+    return nts_ == 0 && wheel_n_ == 0;
+}
+
+inline unsigned driver_timerset::size() const {
+    return nts_ + wheel_n_;
 }
 
 inline bool driver_timerset::has_foreground() const {
-    return nfg_ != 0;
+    return nfg_ != 0 || wheel_nfg_ != 0;
 }
 
 inline const timeval &driver_timerset::expiry() const {
-    assert(nts_ != 0);
-    return ts_[0].when;
+    assert(!empty());
+    if (wheel_n_ == 0)
+        return ts_[0].when;
+    return wheel_expiry();
 }
 
 inline void driver_timerset::cull() {
+    if (wdead_)
+        wheel_cull();
     while (nts_ != 0 && ts_[0].se->empty())
         hard_cull(0);
 }
 
+inline uint64_t driver_timerset::wheel_tick(const timeval& tv) {
+    return (uint64_t(tv.tv_sec) * 1000000 + tv.tv_usec) >> wheel_shift;
+}
+
 inline bool driver_timerset::trec::operator<(const trec &x) const {
     return when.tv_sec < x.when.tv_sec
         || (when.tv_sec == x.when.tv_sec
@@ -290,7 +425,10 @@ inline unsigned driver_timerset::heap_last_child(unsigned i) const {
 }
 
 inline void driver_timerset::pop_trigger() {
-    hard_cull((unsigned) -1);
+    if (wheel_n_ != 0 && (nts_ == 0 || &expiry() != &ts_[0].when))
+        wheel_advance();
+    else
+        hard_cull((unsigned) -1);
 }
 
 } // namespace tamerpriv
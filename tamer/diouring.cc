@@ -0,0 +1,438 @@
+/* Copyright (c) 2007-2015, Eddie Kohler
+ * Copyright (c) 2007, Regents of the University of California
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include "config.h"
+#include <tamer/tamer.hh>
+#include <stdio.h>
+#include <string.h>
+#include "xuring.hh"
+#if TAMER_HAVE_XURING
+# include "dinternal.hh"
+# include <poll.h>
+# ifndef POLLRDHUP
+#  define POLLRDHUP 0
+# endif
+#endif
+
+namespace tamer {
+#if TAMER_HAVE_XURING
+namespace {
+using tamerpriv::xuring;
+using tamerpriv::make_fd_callback;
+using tamerpriv::fd_callback_driver;
+using tamerpriv::fd_callback_fd;
+
+class driver_uring : public driver {
+  public:
+    driver_uring(int flags);
+    ~driver_uring();
+
+    bool setup();
+    bool recreate();
+
+    virtual void at_fd(int fd, int action, event<int> e);
+    virtual void at_time(const timeval &expiry, event<> e, bool bg);
+    virtual void at_deadline(const timeval &expiry, event<> e, int &result);
+    virtual void at_asap(event<> e, priority_class p);
+    virtual void at_preblock(event<> e);
+    virtual void kill_fd(int fd);
+
+    virtual void set_error_handler(error_handler_type errh);
+
+    virtual void loop(loop_flags flags);
+    virtual void break_loop();
+    virtual timeval next_wake() const;
+    virtual bool stats(driver_stats& st) const;
+    virtual void memory_usage(driver_memory& m) const;
+
+  private:
+    // Per-direction poll state. A poll is either absent, outstanding in the
+    // kernel, or on its way out (we asked for its removal but have not yet
+    // reaped its completion).
+    enum { poll_none = 0, poll_active = 1, poll_removing = 2 };
+
+    struct fdp {
+        unsigned char poll[2];
+        inline fdp(driver_uring*, int) {
+            poll[0] = poll[1] = poll_none;
+        }
+    };
+
+    // user_data encoding: (fd << 2) | (remove << 1) | action.
+    // The signal pipe and the post wakeup fd use reserved values.
+    enum { sig_user_data = ~0ULL, post_user_data = ~1ULL };
+
+    xuring ring_;
+    tamerpriv::driver_fdset<fdp> fds_;
+    unsigned npolls_;
+    bool sig_polling_;
+    bool post_polling_;
+
+    tamerpriv::driver_timerset timers_;
+
+    tamerpriv::driver_asapset asap_;
+    tamerpriv::driver_asapset preblock_;
+
+    bool loop_state_;
+    pid_t pid_;
+    error_handler_type errh_;
+
+    static void fd_disinterest(void* arg);
+    void update_fds();
+    inline void submit_poll(int fd, int action);
+    inline void submit_poll_remove(int fd, int action);
+    void submit_failure(int fd, int action);
+    void reap(struct io_uring_cqe* cqe);
+};
+
+
+driver_uring::driver_uring(int flags)
+    : npolls_(0), sig_polling_(false), post_polling_(false),
+      loop_state_(false), pid_(getpid()), errh_(0) {
+    if (flags & init_timer_wheel)
+        timers_.enable_wheel();
+}
+
+driver_uring::~driver_uring() {
+}
+
+bool driver_uring::setup() {
+    return ring_.setup(256);
+}
+
+bool driver_uring::recreate() {
+    // A forked child shares the parent's ring, polls and all. Give it a
+    // ring of its own and re-arm every poll someone still waits on.
+    pid_ = getpid();
+    refresh_post_fd(pid_);
+    npolls_ = 0;
+    sig_polling_ = post_polling_ = false;
+    for (int fd = 0; fd < fds_.size(); ++fd) {
+        tamerpriv::driver_fd<fdp>& x = fds_[fd];
+        x.poll[0] = x.poll[1] = poll_none;
+        if (x.e[0] || x.e[1])
+            fds_.push_change(fd);
+    }
+    return setup();
+}
+
+void driver_uring::set_error_handler(error_handler_type errh) {
+    errh_ = errh;
+}
+
+void driver_uring::fd_disinterest(void* arg) {
+    driver_uring* d = static_cast<driver_uring*>(fd_callback_driver(arg));
+    d->fds_.push_change(fd_callback_fd(arg));
+}
+
+void driver_uring::at_fd(int fd, int action, event<int> e) {
+    assert(fd >= 0);
+    if (e && (action == 0 || action == 1)) {
+        fds_.expand(this, fd);
+        tamerpriv::driver_fd<fdp>& x = fds_[fd];
+        x.e[action] += TAMER_MOVE(e);
+        tamerpriv::simple_event::at_trigger(x.e[action].__get_simple(),
+                                            fd_disinterest,
+                                            make_fd_callback(this, fd));
+        fds_.push_change(fd);
+    }
+}
+
+void driver_uring::kill_fd(int fd) {
+    if (fd >= 0 && fd < fds_.size()) {
+        tamerpriv::driver_fd<fdp> &x = fds_[fd];
+        x.e[0].trigger(-ECANCELED);
+        x.e[1].trigger(-ECANCELED);
+        // A ring poll pins the file, so it would outlive the close; a new
+        // file with the same number must not inherit it.
+        for (int action = 0; action < 2; ++action)
+            if (x.poll[action] == poll_active)
+                submit_poll_remove(fd, action);
+        fds_.push_change(fd);
+    }
+}
+
+inline void driver_uring::submit_poll(int fd, int action) {
+    struct io_uring_sqe* sqe = ring_.get_sqe();
+    if (!sqe) {
+        submit_failure(fd, action);
+        return;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = action ? POLLOUT : POLLIN | POLLRDHUP;
+    sqe->user_data = (uint64_t(fd) << 2) | action;
+    fds_[fd].poll[action] = poll_active;
+    ++npolls_;
+}
+
+inline void driver_uring::submit_poll_remove(int fd, int action) {
+    struct io_uring_sqe* sqe = ring_.get_sqe();
+    if (!sqe) {
+        // the poll stays armed; its eventual completion is harmless
+        submit_failure(fd, -1);
+        return;
+    }
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t(fd) << 2) | action;
+    sqe->user_data = (uint64_t(fd) << 2) | 2 | action;
+    fds_[fd].poll[action] = poll_removing;
+}
+
+void driver_uring::submit_failure(int fd, int action) {
+    if (errh_)
+        errh_(fd, EBUSY, "io_uring submission queue full");
+    // With no poll to wake them, waiters would block forever; fail them
+    // instead, as for any other poll error.
+    if (action >= 0)
+        fds_[fd].e[action].trigger(-EBUSY);
+}
+
+void driver_uring::update_fds() {
+    int fd;
+    while ((fd = fds_.pop_change()) >= 0) {
+        tamerpriv::driver_fd<fdp>& x = fds_[fd];
+        for (int action = 0; action < 2; ++action)
+            if (x.e[action] && x.poll[action] == poll_none)
+                submit_poll(fd, action);
+            else if (!x.e[action] && x.poll[action] == poll_active)
+                submit_poll_remove(fd, action);
+    }
+}
+
+void driver_uring::reap(struct io_uring_cqe* cqe) {
+    if (cqe->user_data == uint64_t(sig_user_data)) {
+        sig_polling_ = false;
+        // with signalfd, readability is the only sign of a signal
+        if (sig_use_fd)
+            dispatch_signals();
+        return;
+    } else if (cqe->user_data == uint64_t(post_user_data)) {
+        post_polling_ = false;
+        return;
+    }
+
+    int fd = cqe->user_data >> 2;
+    int action = cqe->user_data & 1;
+    if (cqe->user_data & 2)
+        // completion of a POLL_REMOVE request; the poll itself completes
+        // separately with -ECANCELED (or already completed)
+        return;
+
+    tamerpriv::driver_fd<fdp>& x = fds_[fd];
+    // A poll being removed may have watched a file since closed, and the
+    // number may name a new file now. Ignore its result; the re-armed
+    // poll reports the current file's state.
+    bool stale = x.poll[action] == poll_removing;
+    x.poll[action] = poll_none;
+    --npolls_;
+    int res = cqe->res;
+    if (res == -ECANCELED || stale)
+        /* removed */;
+    else if (res < 0)
+        x.e[action].trigger(res);
+    else if (action == 0 && (res & (POLLIN | POLLRDHUP)))
+        x.e[0].trigger(0);
+    else if (action == 1 && (res & POLLOUT))
+        x.e[1].trigger(0);
+    else if (res & (POLLERR | POLLHUP | POLLNVAL))
+        x.e[action].trigger(-1);
+    // polls are one-shot: re-arm if anyone is still waiting
+    fds_.push_change(fd);
+}
+
+void driver_uring::at_time(const timeval &expiry, event<> e, bool bg) {
+    if (e)
+        timers_.push(expiry, e.__release_simple(), bg);
+}
+
+void driver_uring::at_deadline(const timeval &expiry, event<> e, int &result) {
+    result = 0;
+    if (e)
+        timers_.push(expiry, e.__release_simple(), false, &result);
+}
+
+void driver_uring::at_asap(event<> e, priority_class p) {
+    if (e)
+        asap_.push(e.__release_simple(), p);
+}
+
+void driver_uring::at_preblock(event<> e) {
+    if (e)
+        preblock_.push(e.__release_simple());
+}
+
+void driver_uring::loop(loop_flags flags)
+{
+    if (!(flags & loop_once))
+        loop_state_ = true;
+    // io_uring instances are not inherited usefully across fork
+    if (pid_ != getpid() && !recreate()) {
+        if (errh_)
+            errh_(-1, errno, "io_uring_setup failure after fork");
+        return;
+    }
+
+ again:
+    bool sigs = owns_signals();
+    // a signalfd's completion dispatches signals; sig_any_active serves
+    // the pipe
+    bool sigflag = sigs && !sig_use_fd;
+
+    // process preblock events
+    while (!preblock_.empty())
+        preblock_.pop_trigger();
+    stats_resumed(driver_stats::phase_preblock, run_unblocked());
+
+    // fix file descriptors
+    if (fds_.has_change())
+        update_fds();
+    if (sigs && !sig_polling_ && sig_pipe[0] >= 0)
+        if (struct io_uring_sqe* sqe = ring_.get_sqe()) {
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = sig_pipe[0];
+            sqe->poll32_events = POLLIN;
+            sqe->user_data = uint64_t(sig_user_data);
+            sig_polling_ = true;
+        }
+    if (!post_polling_ && post_fd() >= 0)
+        if (struct io_uring_sqe* sqe = ring_.get_sqe()) {
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = post_fd();
+            sqe->poll32_events = POLLIN;
+            sqe->user_data = uint64_t(post_user_data);
+            post_polling_ = true;
+        }
+
+    // determine timeout
+    timers_.cull();
+    timeval to, *toptr = &to;
+    timerclear(&to);
+    if (asap_.empty() && !(sigflag && sig_any_active) && !has_unblocked()
+        && !has_posted()) {
+        if (timers_.empty()) {
+            if (npolls_ == 0 && (!sigs || sig_nforeground == 0)
+                && !expects_post())
+                // no foreground events!
+                return;
+            toptr = 0;
+        } else {
+            timeval tnow = now();
+            if (!timers_.has_foreground() && npolls_ == 0
+                && (!sigs || sig_nforeground == 0) && !expects_post()
+                && timercmp(&timers_.expiry(), &tnow, >))
+                // no foreground events!
+                return;
+            if (tamerpriv::time_type != time_virtual
+                && timercmp(&timers_.expiry(), &tnow, >))
+                timersub(&timers_.expiry(), &tnow, &to);
+        }
+    }
+
+    // submit everything queued and wait, all in one system call
+    bool block = !toptr || to.tv_sec != 0 || to.tv_usec != 0;
+    stats_wait_begin();
+    if (ring_.enter(block ? 1 : 0, toptr) < 0 && errh_)
+        errh_(-1, errno, "io_uring_enter failure");
+    stats_wait_end(ring_.ready_cqes());
+
+    // process signals
+    set_recent();
+    if (sigflag && sig_any_active)
+        dispatch_signals();
+
+    // process fd events
+    int nreaped = 0;
+    while (struct io_uring_cqe* cqe = ring_.peek_cqe()) {
+        reap(cqe);
+        ring_.advance_cqe();
+        ++nreaped;
+    }
+    if (nreaped)
+        stats_resumed(driver_stats::phase_fd, run_unblocked());
+
+    // process events posted from other threads
+    if (has_posted()) {
+        run_posted();
+        stats_resumed(driver_stats::phase_fd, run_unblocked());
+    }
+
+    // process timer events
+    if (!timers_.empty() && tamerpriv::time_type == time_virtual && nreaped == 0)
+        tamerpriv::recent = timers_.expiry();
+    while (!timers_.empty() && !timercmp(&timers_.expiry(), &recent(), >))
+        timers_.pop_trigger();
+    stats_resumed(driver_stats::phase_timer, run_unblocked());
+
+    // process asap events
+    asap_.run(low_priority_budget());
+    stats_resumed(driver_stats::phase_asap, run_unblocked());
+
+    // check flags
+    if (loop_state_)
+        goto again;
+}
+
+void driver_uring::break_loop() {
+    loop_state_ = false;
+}
+
+timeval driver_uring::next_wake() const {
+    struct timeval tv = { 0, 0 };
+    if (!asap_.empty()
+        || (sig_any_active && !sig_use_fd && owns_signals())
+        || has_unblocked()
+        || has_posted())
+        /* already zero */;
+    else if (timers_.empty())
+        tv.tv_sec = -1;
+    else
+        tv = timers_.expiry();
+    return tv;
+}
+
+bool driver_uring::stats(driver_stats& st) const {
+    if (!driver::stats(st))
+        return false;
+    st.nasap = asap_.size();
+    st.ntimers = timers_.size();
+    return true;
+}
+
+void driver_uring::memory_usage(driver_memory& m) const {
+    driver::memory_usage(m);
+    m.fd_table = fds_.memory();
+    m.timers = timers_.memory();
+    m.asap = asap_.memory() + preblock_.memory();
+}
+
+} // namespace
+
+driver *driver::make_uring(int flags) {
+    driver_uring* d = new driver_uring(flags);
+    if (!d->setup()) {
+        delete d;
+        return 0;
+    }
+    return d;
+}
+
+#else
+
+driver *driver::make_uring(int) {
+    return 0;
+}
+
+#endif
+} // namespace tamer
@@ -40,12 +40,14 @@ public:
 
     virtual void at_fd(int fd, int action, event<int> e);
     virtual void at_time(const timeval &expiry, event<> e, bool bg);
-    virtual void at_asap(event<> e);
+    virtual void at_deadline(const timeval &expiry, event<> e, int &result);
+    virtual void at_asap(event<> e, priority_class p);
     virtual void at_preblock(event<> e);
     virtual void kill_fd(int fd);
 
     virtual void loop(loop_flags flags);
     virtual void break_loop();
+    virtual void memory_usage(driver_memory& m) const;
 
     struct fdp {
         union {
@@ -74,6 +76,10 @@ public:
         ev_watcher w;
         ev_io io;
     } sigwatcher_;
+    union {
+        ev_watcher w;
+        ev_io io;
+    } postwatcher_;
 
     void update_fds();
     static void fd_disinterest(void* arg);
@@ -103,6 +109,12 @@ void libev_sigtrigger(struct ev_loop *, ev_io *ev, int)
     driver_libev *d = static_cast<driver_libev *>(ev->data);
     d->dispatch_signals();
 }
+
+void libev_posttrigger(struct ev_loop *, ev_io *ev, int)
+{
+    driver_libev *d = static_cast<driver_libev *>(ev->data);
+    d->run_posted();
+}
 } // extern "C"
 
 
@@ -114,11 +126,20 @@ driver_libev::driver_libev()
     ev_io_set(&sigwatcher_.io, sig_pipe[0], EV_READ);
     sigwatcher_.io.data = this;
     ev_io_start(eloop_, &sigwatcher_.io);
+
+    if (post_fd() >= 0) {
+        ev_init(&postwatcher_.w, (ev_watcher_type) libev_posttrigger);
+        ev_io_set(&postwatcher_.io, post_fd(), EV_READ);
+        postwatcher_.io.data = this;
+        ev_io_start(eloop_, &postwatcher_.io);
+    }
 }
 
 driver_libev::~driver_libev() {
     // Stop the special signal FD pipe.
     ev_io_stop(eloop_, &sigwatcher_.io);
+    if (post_fd() >= 0)
+        ev_io_stop(eloop_, &postwatcher_.io);
     for (int fd = 0; fd < fds_.size(); ++fd)
         ev_io_stop(eloop_, &fds_[fd].base_.io);
 }
@@ -146,6 +167,11 @@ void driver_libev::kill_fd(int fd) {
         tamerpriv::driver_fd<fdp> &x = fds_[fd];
         for (int action = 0; action < 2; ++action)
             x.e[action].trigger(-ECANCELED);
+        // drop the registration now, before the fd number is reused
+        if (ev_is_active(&x.base_.w)) {
+            ev_io_stop(eloop_, &x.base_.io);
+            --fdactive_;
+        }
         fds_.push_change(fd);
     }
 }
@@ -173,9 +199,15 @@ void driver_libev::at_time(const timeval &expiry, event<> e, bool bg) {
         timers_.push(expiry, e.__release_simple(), bg);
 }
 
-void driver_libev::at_asap(event<> e) {
+void driver_libev::at_deadline(const timeval &expiry, event<> e, int &result) {
+    result = 0;
     if (e)
-        asap_.push(e.__release_simple());
+        timers_.push(expiry, e.__release_simple(), false, &result);
+}
+
+void driver_libev::at_asap(event<> e, priority_class p) {
+    if (e)
+        asap_.push(e.__release_simple(), p);
 }
 
 void driver_libev::at_preblock(event<> e) {
@@ -205,11 +237,13 @@ void driver_libev::loop(loop_flags flags) {
     if (!asap_.empty()
         || (!timers_.empty() && !timercmp(&timers_.expiry(), &recent(), >))
         || sig_any_active
-        || has_unblocked())
+        || has_unblocked()
+        || has_posted())
         event_flags |= EVRUN_NOWAIT;
     else if (!timers_.has_foreground()
              && fdactive_ == 0
-             && sig_nforeground == 0)
+             && sig_nforeground == 0
+             && !expects_post())
         // no foreground events!
         return;
     else if (!timers_.empty()) {
@@ -232,6 +266,8 @@ void driver_libev::loop(loop_flags flags) {
     // process fd events
     set_recent();
     run_unblocked();
+    if (has_posted())
+        run_posted();
 
     // process timer events
     while (!timers_.empty() && !timercmp(&timers_.expiry(), &recent(), >))
@@ -239,11 +275,10 @@ void driver_libev::loop(loop_flags flags) {
     run_unblocked();
 
     // process asap events
-    while (!asap_.empty())
-        asap_.pop_trigger();
+    asap_.run(low_priority_budget());
     run_unblocked();
 
-    if (flags == loop_forever)
+    if (!(flags & loop_once))
         goto again;
 }
 
@@ -251,6 +286,13 @@ void driver_libev::break_loop() {
     ev_break(eloop_);
 }
 
+void driver_libev::memory_usage(driver_memory& m) const {
+    driver::memory_usage(m);
+    m.fd_table = fds_.memory();
+    m.timers = timers_.memory();
+    m.asap = asap_.memory() + preblock_.memory();
+}
+
 } // namespace
 #endif
 
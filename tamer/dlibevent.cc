@@ -36,12 +36,14 @@ class driver_libevent : public driver {
 
     virtual void at_fd(int fd, int action, event<int> e);
     virtual void at_time(const timeval &expiry, event<> e, bool bg);
-    virtual void at_asap(event<> e);
+    virtual void at_deadline(const timeval &expiry, event<> e, int &result);
+    virtual void at_asap(event<> e, priority_class p);
     virtual void at_preblock(event<> e);
     virtual void kill_fd(int fd);
 
     virtual void loop(loop_flags flags);
     virtual void break_loop();
+    virtual void memory_usage(driver_memory& m) const;
 
     struct fdp {
         ::event base;
@@ -57,6 +59,7 @@ class driver_libevent : public driver {
     tamerpriv::driver_fdset<fdp> fds_;
     int fdactive_;
     ::event signal_base_;
+    ::event post_base_;
 
     tamerpriv::driver_timerset timers_;
 
@@ -87,6 +90,11 @@ void libevent_sigtrigger(int, short, void *arg) {
     driver_libevent *d = static_cast<driver_libevent *>(arg);
     d->dispatch_signals();
 }
+
+void libevent_posttrigger(int, short, void *arg) {
+    driver_libevent *d = static_cast<driver_libevent *>(arg);
+    d->run_posted();
+}
 } // extern "C"
 
 
@@ -103,10 +111,18 @@ driver_libevent::driver_libevent()
                 libevent_sigtrigger, this);
     ::event_priority_set(&signal_base_, 0);
     ::event_add(&signal_base_, 0);
+    if (post_fd() >= 0) {
+        ::event_set(&post_base_, post_fd(), EV_READ | EV_PERSIST,
+                    libevent_posttrigger, this);
+        ::event_priority_set(&post_base_, 0);
+        ::event_add(&post_base_, 0);
+    }
 }
 
 driver_libevent::~driver_libevent() {
     ::event_del(&signal_base_);
+    if (post_fd() >= 0)
+        ::event_del(&post_base_);
 }
 
 void driver_libevent::fd_disinterest(void* arg) {
@@ -132,6 +148,11 @@ void driver_libevent::kill_fd(int fd) {
         tamerpriv::driver_fd<fdp> &x = fds_[fd];
         for (int action = 0; action < 2; ++action)
             x.e[action].trigger(-ECANCELED);
+        // drop the registration now, before the fd number is reused
+        if (::event_pending(&x.base, EV_READ | EV_WRITE, 0)) {
+            ::event_del(&x.base);
+            --fdactive_;
+        }
         fds_.push_change(fd);
     }
 }
@@ -161,9 +182,15 @@ void driver_libevent::at_time(const timeval &expiry, event<> e, bool bg) {
         timers_.push(expiry, e.__release_simple(), bg);
 }
 
-void driver_libevent::at_asap(event<> e) {
+void driver_libevent::at_deadline(const timeval &expiry, event<> e, int &result) {
+    result = 0;
     if (e)
-        asap_.push(e.__release_simple());
+        timers_.push(expiry, e.__release_simple(), false, &result);
+}
+
+void driver_libevent::at_asap(event<> e, priority_class p) {
+    if (e)
+        asap_.push(e.__release_simple(), p);
 }
 
 void driver_libevent::at_preblock(event<> e) {
@@ -191,11 +218,13 @@ void driver_libevent::loop(loop_flags flags)
     if (!asap_.empty()
         || (!timers_.empty() && !timercmp(&timers_.expiry(), &recent(), >))
         || sig_any_active
-        || has_unblocked())
+        || has_unblocked()
+        || has_posted())
         event_flags |= EVLOOP_NONBLOCK;
     else if (!timers_.has_foreground()
              && fdactive_ == 0
-             && sig_nforeground == 0)
+             && sig_nforeground == 0
+             && !expects_post())
         // no foreground events!
         return;
     else if (!timers_.empty()) {
@@ -214,6 +243,8 @@ void driver_libevent::loop(loop_flags flags)
     // process fd events
     set_recent();
     run_unblocked();
+    if (has_posted())
+        run_posted();
 
     // process timer events
     if (!timers_.empty()) {
@@ -225,11 +256,10 @@ void driver_libevent::loop(loop_flags flags)
     }
 
     // process asap events
-    while (!asap_.empty())
-        asap_.pop_trigger();
+    asap_.run(low_priority_budget());
     run_unblocked();
 
-    if (flags == loop_forever)
+    if (!(flags & loop_once))
         goto again;
 }
 
@@ -237,6 +267,13 @@ void driver_libevent::break_loop() {
     event_loopbreak();
 }
 
+void driver_libevent::memory_usage(driver_memory& m) const {
+    driver::memory_usage(m);
+    m.fd_table = fds_.memory();
+    m.timers = timers_.memory();
+    m.asap = asap_.memory() + preblock_.memory();
+}
+
 } // namespace
 #endif
 
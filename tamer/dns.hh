@@ -7,6 +7,7 @@
 #include <map>
 #include <list>
 #include <set>
+#include <vector>
 #include <sstream>
 #include <string.h>
 #include <stdio.h>
@@ -16,6 +17,15 @@
 
 #define DNS_REPARSE_TIME 60
 
+/* entries in a resolver's reply cache */
+#define DNS_CACHE_SIZE 1024
+/* seconds to remember a failed lookup */
+#define DNS_NEGATIVE_TTL 30
+/* longest time a positive reply is cached, whatever its TTL */
+#define DNS_MAX_CACHE_TTL 86400
+/* seconds tcp_connect(host, ...) waits before trying the next address */
+#define DNS_CONNECT_STAGGER 0.25
+
 #define DNS_OPTION_SEARCH 1
 #define DNS_OPTION_NAMESERVERS 2
 #define DNS_OPTION_MISC 4
@@ -61,6 +71,8 @@ typedef ref_ptr<nameserver_imp> nameserver;
 
 void gethostbyname(std::string name, bool search, event<dns::reply> result);
 void gethostbyaddr(struct in_addr *in, event<dns::reply> result);
+void tcp_connect(std::string host, int port, event<fd> result);
+void tcp_connect(std::vector<uint32_t> addrs, int port, event<fd> result);
 
 namespace dns {
 
@@ -551,6 +563,19 @@ class resolver : public enable_ref_ptr_with_full_release<resolver> {
 
   std::map<uint16_t, query> _requests;
 
+  // Replies by lookup key. An entry with waiters is a lookup in flight;
+  // later lookups for the same key join it rather than sending a query.
+  struct cache_entry {
+    reply r;
+    double expiry;
+    std::vector<event<reply> > waiters;
+    cache_entry() : expiry(0) {}
+  };
+  typedef std::map<std::string, cache_entry> cache_type;
+  cache_type _cache;
+  size_t _cache_capacity;
+  int _negative_ttl;
+
   nameservers _nameservers;
   nameservers _failed;
   nameservers::iterator _nsindex;
@@ -562,6 +587,9 @@ class resolver : public enable_ref_ptr_with_full_release<resolver> {
   uint16_t get_trans_id();
 
   void resolve(request q, event<reply> e);
+  void lookup(const std::string& key, request q, event<reply> e);
+  void fill(std::string key, request q);
+  void make_cache_room();
 
   void add_nameservers(nameservers n, event<>);
   void handle_nameserver(nameserver n);
@@ -592,6 +620,9 @@ class resolver : public enable_ref_ptr_with_full_release<resolver> {
   class closure__resolve__7requestQ5reply_;
   void resolve(closure__resolve__7requestQ5reply_&);
 
+  class closure__fill__Ss7request;
+  void fill(closure__fill__Ss7request&);
+
   class closure__add_nameservers__11nameserversQ_;
   void add_nameservers(closure__add_nameservers__11nameserversQ_&);
 
@@ -619,12 +650,17 @@ class resolver : public enable_ref_ptr_with_full_release<resolver> {
     void resolve_a(std::string name, bool search, event<reply> e);
     void resolve_ptr(struct in_addr *in, event<reply> e);
 
+    void set_cache(size_t capacity, int negative_ttl = DNS_NEGATIVE_TTL);
+    size_t cache_size() const;
+    void flush_cache();
+
     void full_release();
 };
 
 inline resolver::resolver(int flags, std::string rc)
   : _rcname(rc), _flags(flags), _err(0), _reqs_inflight(0),
-    _fst(), _nsindex(_nameservers.begin()), _is_init(false) {
+    _fst(), _cache_capacity(DNS_CACHE_SIZE), _negative_ttl(DNS_NEGATIVE_TTL),
+    _nsindex(_nameservers.begin()), _is_init(false) {
   struct timeval tv;
   set_default_options();
   gettimeofday(&tv, NULL);
@@ -647,14 +683,28 @@ inline void resolver::resolve_a(std::string name, bool search, event<reply> e) {
   if (!*q)
     e.trigger(reply());
   else
-    resolve(q, e);
+    lookup((search ? "S" : "A") + name, q, e);
 }
 
 inline void resolver::resolve_ptr(struct in_addr *in, event<reply> e) {
   request q;
 
   q = make_request_ptr(in);
-  resolve(q, e);
+  lookup("P" + std::string(reinterpret_cast<char *>(&in->s_addr), 4), q, e);
+}
+
+/** @brief Set the reply cache's size and how long failures are cached.
+ *
+ *  A @a capacity of 0 turns caching off; concurrent lookups for the same
+ *  name still share one query. @a negative_ttl is in seconds. */
+inline void resolver::set_cache(size_t capacity, int negative_ttl) {
+  _cache_capacity = capacity;
+  _negative_ttl = negative_ttl;
+  make_cache_room();
+}
+
+inline size_t resolver::cache_size() const {
+  return _cache.size();
 }
 
 inline void resolver::full_release() {
@@ -664,6 +714,10 @@ inline void resolver::full_release() {
       i != _requests.end(); i++)
     i->second.p.trigger(reply());
   _requests.clear();
+  for (cache_type::iterator i = _cache.begin(); i != _cache.end(); ++i)
+    for (size_t j = 0; j != i->second.waiters.size(); ++j)
+      i->second.waiters[j].trigger(reply());
+  _cache.clear();
 }
 
 inline nameserver resolver::next_nameserver() {
@@ -25,9 +25,12 @@ enum init_flags {
     init_tamer = 1,
     init_libevent = 2,
     init_libev = 4,
+    init_uring = 8,
     init_sigpipe = 0x1000,
     init_strict = 0x2000,
-    init_no_epoll = 0x4000
+    init_no_epoll = 0x4000,
+    init_timer_wheel = 0x8000,
+    init_epoll_et = 0x10000
 };
 
 /** @brief  Initialize the Tamer event loop.
@@ -35,8 +38,28 @@ enum init_flags {
  *
  *  Call tamer::initialize at least once before registering any primitive
  *  Tamer events. The @a flags argument may contain one or more
- *  constants to request a specific driver (init_tamer, init_libevent, or
- *  init_libev).
+ *  constants to request a specific driver (init_tamer, init_libevent,
+ *  init_libev, or init_uring). The init_uring driver uses a Linux io_uring
+ *  submission ring, so that one system call per loop iteration both submits
+ *  and reaps readiness polls; it is only available on Linux 5.11 and later.
+ *  The TAMER_DRIVER environment variable (one of "tamer", "libevent",
+ *  "libev", or "uring") selects a driver when @a flags names none.
+ *
+ *  Add init_timer_wheel to keep far-off timers in a hashed timing wheel
+ *  rather than the timer heap (tamer and io_uring drivers only). Wheel
+ *  timers are inserted in constant time and removed as soon as their
+ *  events are cancelled, which helps programs that set many long timeouts
+ *  that rarely fire.
+ *
+ *  Add init_epoll_et to register each file descriptor with epoll once, in
+ *  edge-triggered mode, instead of updating its registration whenever the
+ *  set of waiting events changes (tamer driver only). The driver keeps
+ *  each fd ready from its last readiness edge until I/O on it returns
+ *  EAGAIN, and at_fd_read() or at_fd_write() on a ready fd triggers at
+ *  once. This saves most epoll_ctl() calls on busy sockets, but callers
+ *  that do their own I/O must report EAGAIN with read_would_block() or
+ *  write_would_block() before waiting, as tamer::fd does, and must close
+ *  file descriptors through tamer::fd so the driver forgets them.
  *
  *  By default Tamer ignores the SIGPIPE signal, which is generally what
  *  event-driven programs want. Add init_sigpipe to @a flags if you
@@ -44,13 +67,46 @@ enum init_flags {
  */
 bool initialize(int flags = 0);
 
+/** @brief  Initialize a Tamer event loop for the calling thread.
+ *  @param  flags  Initialization flags, taken from init_flags.
+ *
+ *  When Tamer is configured with --enable-threads, driver::main and the
+ *  recent-time state are thread-local, and each thread that wants to run
+ *  Tamer events calls initialize_thread() before registering any of them.
+ *  Events and closures belong to the driver of the thread that created
+ *  them; they must only be triggered from that thread. Only the init_tamer
+ *  and init_uring drivers can be created this way.
+ *
+ *  Signals are process-wide. They are dispatched only by the driver created
+ *  by tamer::initialize (driver::sig_driver), and tamer::at_signal should
+ *  only be called from that driver's thread.
+ *
+ *  Without --enable-threads, there is a single driver::main and this
+ *  function behaves like tamer::initialize.
+ */
+bool initialize_thread(int flags = 0);
+
 /** @brief  Clean up the Tamer event loop.
  *
- *  Delete the driver. Should not be called unless all Tamer objects are
- *  deleted.
+ *  Delete the calling thread's driver. Should not be called unless all Tamer
+ *  objects belonging to that driver are deleted.
  */
 void cleanup();
 
+#if TAMER_CLOSURE_POOL
+/** @brief  Replace the allocator for tamed-function closures.
+ *  @param allocator  Returns memory for a closure of the given size.
+ *  @param deallocator  Frees memory returned by @a allocator.
+ *
+ *  By default, closures come from per-thread size-class freelists. Passing
+ *  null for both functions restores that behavior. The allocator must not
+ *  change while any tamed function is blocked, since each closure is freed
+ *  with the deallocator in effect at that time.
+ */
+void set_closure_allocator(void* (*allocator)(size_t),
+                           void (*deallocator)(void*, size_t));
+#endif
+
 enum time_type_t {
     time_normal,
     time_virtual
@@ -88,7 +144,15 @@ inline double drecent() {
     return dtime(recent());
 }
 
-/** @brief  Run driver loop according to @a flags. */
+/** @brief  Run driver loop according to @a flags.
+ *
+ *  @a flags is loop_forever or loop_once, optionally combined with
+ *  loop_busy_poll. With loop_busy_poll, the tamer driver polls for
+ *  file descriptor events without blocking for a short time slice before
+ *  it blocks in epoll_wait. This trades a spinning core for lower wakeup
+ *  latency. The slice is 0, so nothing spins, until driver::set_busy_poll
+ *  sets it. Other drivers ignore loop_busy_poll.
+ */
 inline void loop(loop_flags flags) {
     driver::main->loop(flags);
 }
@@ -108,6 +172,75 @@ inline void break_loop() {
     driver::main->break_loop();
 }
 
+/** @brief  Trigger an event from any thread.
+ *  @param  d  The driver that owns @a e.
+ *  @param  e  Event.
+ *
+ *  Hands @a e to @a d, which triggers it from its own loop. This is the only
+ *  safe way to trigger an event from a thread other than its driver's, for
+ *  example when a thread-pool computation finishes. Producers never take a
+ *  lock; @a d is woken through an eventfd.
+ *
+ *  Pass @a e by move: the calling thread must not keep other copies, since
+ *  event reference counts are not atomic. A pending post does not keep
+ *  @a d's loop running; see expect_post().
+ */
+inline void post(driver* d, event<> e) {
+    d->post(new tamerpriv::event_post_node<>(TAMER_MOVE(e)));
+}
+
+/** @brief  Trigger an event with a value from any thread.
+ *  @param  d  The driver that owns @a e.
+ *  @param  e  Event.
+ *  @param  v  Trigger value.
+ *
+ *  @sa post(driver*, event<>)
+ */
+template <typename T, typename V>
+inline void post(driver* d, event<T> e, V&& v) {
+    d->post(new tamerpriv::event_post_node<T>(TAMER_MOVE(e),
+                                              std::forward<V>(v)));
+}
+
+/** @brief  Keep the current driver's loop running until a post arrives.
+ *
+ *  A driver's loop returns once it has no events to wait for, and an event
+ *  handed to another thread does not count. Call expect_post() before
+ *  handing it off, and have the other thread deliver it with
+ *  post_expected(); the loop keeps running until then.
+ *
+ *  @code
+ *     tamer::driver* home = tamer::driver::main;
+ *     tamer::expect_post();
+ *     std::thread([home, e]() mutable {
+ *         tamer::post_expected(home, std::move(e), compute());
+ *     }).detach();
+ *  @endcode
+ *
+ *  @sa driver::expect_post */
+inline void expect_post() {
+    driver::main->expect_post();
+}
+
+/** @brief  Trigger an event from any thread, releasing one expect_post().
+ *  @param  d  The driver that owns @a e.
+ *  @param  e  Event.
+ *
+ *  @sa post(driver*, event<>), expect_post() */
+inline void post_expected(driver* d, event<> e) {
+    d->post(new tamerpriv::event_post_node<>(TAMER_MOVE(e)), true);
+}
+
+/** @brief  Trigger an event with a value from any thread, releasing one
+ *  expect_post().
+ *
+ *  @sa post(driver*, event<>), expect_post() */
+template <typename T, typename V>
+inline void post_expected(driver* d, event<T> e, V&& v) {
+    d->post(new tamerpriv::event_post_node<T>(TAMER_MOVE(e),
+                                              std::forward<V>(v)), true);
+}
+
 /** @brief  Register event for file descriptor readability.
  *  @param  fd  File descriptor.
  *  @param  e   Event.
@@ -138,6 +271,22 @@ inline void at_fd_write(int fd, event<int> e) {
     driver::main->at_fd_write(fd, e);
 }
 
+/** @brief  Note that reading @a fd returned EAGAIN.
+ *
+ *  Call this before waiting for readability after a read, recv, or accept
+ *  on @a fd would have blocked. Under init_epoll_et the driver treats
+ *  @a fd as readable until it is told otherwise; other drivers ignore it.
+ */
+inline void read_would_block(int fd) {
+    driver::main->note_would_block(fd, driver::fdread);
+}
+
+/** @brief  Note that writing @a fd returned EAGAIN.
+ *  @sa read_would_block() */
+inline void write_would_block(int fd) {
+    driver::main->note_would_block(fd, driver::fdwrite);
+}
+
 /** @brief  Register event for a given time.
  *  @param  expiry  Time.
  *  @param  e       Event.
@@ -208,12 +357,35 @@ inline void at_delay_usec(int delay, event<> e, bool bg = false) {
     driver::main->at_delay_usec(delay, e, bg);
 }
 
+/** @brief  Register event for a given delay, with timer slack.
+ *  @param  delay  Delay time.
+ *  @param  e      Event.
+ *  @param  slack  Acceptable lateness in seconds.
+ *
+ *  Triggers @a e between @a delay and @a delay + @a slack seconds after
+ *  @c recent(). Timers with overlapping windows fire together.
+ *
+ *  @sa driver::set_timer_slack
+ */
+inline void at_delay_slack(double delay, event<> e, double slack, bool bg = false) {
+    driver::main->at_delay_slack(delay, e, slack, bg);
+}
+
 /** @brief  Register event for signal occurrence.
  *  @param  signo  Signal number.
  *  @param  e      Event.
  *
  *  Triggers @a e soon after @a signo is received.  The signal @a signo
  *  is blocked while @a e is triggered and unblocked afterwards.
+ *
+ *  On Linux, Tamer reads signals from a signalfd in the driver's poll set
+ *  and keeps watched signals blocked in the calling thread until their
+ *  last event is gone. Threads created later inherit that mask; signals
+ *  caught by earlier threads are passed on to the calling thread. A
+ *  signal directed at a later thread, as by raise() or pthread_kill()
+ *  there, stays pending. Programs started with tamer::exec get the usual
+ *  signal mask back; code that forks and execs by other means should call
+ *  driver::sig_restore_mask() in the child.
  */
 inline void at_signal(int signo, event<> e) {
     driver::at_signal(signo, e);
@@ -228,6 +400,21 @@ inline void at_asap(event<> e) {
     driver::main->at_asap(e);
 }
 
+/** @brief  Register event to trigger soon, with a priority.
+ *  @param  e  Event.
+ *  @param  p  Priority class.
+ *
+ *  Like at_asap(event<>), but the driver triggers asap events in order of
+ *  priority: all @c priority_high events, then @c priority_normal ones,
+ *  then at most driver::low_priority_budget() @c priority_low ones per
+ *  loop iteration. Leftover low-priority events wait until the driver has
+ *  polled for I/O again. Closures blocked on a rendezvous are scheduled
+ *  the same way, by their rendezvous's priority.
+ */
+inline void at_asap(event<> e, priority_class p) {
+    driver::main->at_asap(e, p);
+}
+
 /** @brief  Register event to trigger before Tamer blocks.
  *  @param  e  Event.
  *
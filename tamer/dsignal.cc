@@ -18,10 +18,16 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <unistd.h>
+#if HAVE_SYS_SIGNALFD_H && !TAMER_NOSIGNALFD
+# include <sys/signalfd.h>
+# include <pthread.h>
+# define TAMER_SIGNALFD 1
+#endif
 namespace tamer {
 
 volatile sig_atomic_t driver::sig_any_active;
 int driver::sig_pipe[2] = { -1, -1 };
+bool driver::sig_use_fd;
 unsigned driver::sig_nforeground = 0;
 unsigned driver::sig_ntotal = 0;
 
@@ -54,12 +60,34 @@ volatile sig_atomic_t sig_active[NSIG];
 event<> sig_handlers[NSIG];
 sigset_t sig_dispatching;
 
+#if TAMER_SIGNALFD
+// With signalfd, sig_pipe[0] is a signalfd and sig_pipe[1] is -1. Watched
+// signals are blocked in the owning thread (and threads it creates later)
+// and read from the signalfd, so no handler runs and nothing is written.
+sigset_t sig_fdmask;
+pthread_t sig_owner;
+#endif
+
+void sig_unwatch(int signo) {
+    tamer_sigaction(signo, SIG_DFL);
+#if TAMER_SIGNALFD
+    if (driver::sig_use_fd && sigismember(&sig_fdmask, signo) > 0) {
+        sigdelset(&sig_fdmask, signo);
+        signalfd(driver::sig_pipe[0], &sig_fdmask, 0);
+        sigset_t one;
+        sigemptyset(&one);
+        sigaddset(&one, signo);
+        pthread_sigmask(SIG_UNBLOCK, &one, 0);
+    }
+#endif
+}
+
 void sigcancel_rendezvous::hook(tamerpriv::functional_rendezvous *,
                                 tamerpriv::simple_event *e, bool) TAMER_NOEXCEPT {
     uintptr_t rid = e->rid();
     int signo = rid >> 1;
     if (!sig_handlers[signo] && sigismember(&sig_dispatching, signo) == 0)
-        tamer_sigaction(signo, SIG_DFL);
+        sig_unwatch(signo);
     if (rid & 1)
         --driver::sig_nforeground;
     --driver::sig_ntotal;
@@ -69,6 +97,16 @@ void sigcancel_rendezvous::hook(tamerpriv::functional_rendezvous *,
 
 extern "C" {
 static void tamer_signal_handler(int signo) {
+#if TAMER_SIGNALFD
+    // a thread that does not block the signal caught it; pass it on to the
+    // owning thread, where it is blocked and so reaches the signalfd
+    if (driver::sig_use_fd && !pthread_equal(pthread_self(), sig_owner)) {
+        int save_errno = errno;
+        pthread_kill(sig_owner, signo);
+        errno = save_errno;
+        return;
+    }
+#endif
     driver::sig_any_active = sig_active[signo] = 1;
     // ensure select wakes up
     if (driver::sig_pipe[1] >= 0) {
@@ -78,6 +116,20 @@ static void tamer_signal_handler(int signo) {
         errno = save_errno;
     }
 }
+
+#if TAMER_SIGNALFD
+// A forked child shares the parent's signalfd, and so its mask. Give the
+// child its own, under the same descriptor number, before it changes the
+// set of watched signals.
+static void tamer_signalfd_atfork_child() {
+    int f = signalfd(-1, &sig_fdmask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (f >= 0) {
+        dup3(f, driver::sig_pipe[0], O_CLOEXEC);
+        close(f);
+    }
+    sig_owner = pthread_self();
+}
+#endif
 }
 
 
@@ -85,6 +137,17 @@ void driver::at_signal(int signo, event<> trigger, signal_flags flags)
 {
     assert(signo >= 0 && signo < NSIG);
 
+#if TAMER_SIGNALFD
+    if (sig_pipe[0] < 0) {
+        sigemptyset(&sig_fdmask);
+        sig_pipe[0] = signalfd(-1, &sig_fdmask, SFD_NONBLOCK | SFD_CLOEXEC);
+        if ((sig_use_fd = sig_pipe[0] >= 0)) {
+            sig_owner = pthread_self();
+            sigemptyset(&sig_dispatching);
+            pthread_atfork(0, 0, tamer_signalfd_atfork_child);
+        }
+    }
+#endif
     if (sig_pipe[0] < 0 && pipe(sig_pipe) >= 0) {
         fcntl(sig_pipe[0], F_SETFL, O_NONBLOCK);
         fcntl(sig_pipe[1], F_SETFL, O_NONBLOCK);
@@ -102,19 +165,55 @@ void driver::at_signal(int signo, event<> trigger, signal_flags flags)
     sig_ntotal += 1;
 
     sig_handlers[signo] += TAMER_MOVE(trigger);
+#if TAMER_SIGNALFD
+    if (sig_use_fd && sigismember(&sig_fdmask, signo) == 0) {
+        sigaddset(&sig_fdmask, signo);
+        signalfd(sig_pipe[0], &sig_fdmask, 0);
+        sigset_t one;
+        sigemptyset(&one);
+        sigaddset(&one, signo);
+        pthread_sigmask(SIG_BLOCK, &one, 0);
+    }
+#endif
     if (sigismember(&sig_dispatching, signo) == 0)
         tamer_sigaction(signo, tamer_signal_handler);
 }
 
+/** @brief  Unblock signals blocked for signal delivery.
+ *
+ *  Where Tamer reads signals from a signalfd, it blocks the signals it
+ *  watches. Child processes call this before exec so the new program
+ *  starts with the signal mask it would otherwise have had. */
+void driver::sig_restore_mask()
+{
+#if TAMER_SIGNALFD
+    if (sig_use_fd)
+        pthread_sigmask(SIG_UNBLOCK, &sig_fdmask, 0);
+#endif
+}
+
 
 void driver::dispatch_signals()
 {
     sig_any_active = 0;
 
-    // kill crap data written to pipe
-    char crap[64];
-    while (read(sig_pipe[0], crap, 64) > 0)
-        /* do nothing */;
+#if TAMER_SIGNALFD
+    if (sig_use_fd) {
+        // collect pending signals; they are already blocked
+        struct signalfd_siginfo si[16];
+        ssize_t r;
+        while ((r = read(sig_pipe[0], si, sizeof(si))) > 0)
+            for (size_t i = 0; i != size_t(r) / sizeof(si[0]); ++i)
+                if (si[i].ssi_signo < unsigned(NSIG))
+                    sig_active[si[i].ssi_signo] = 1;
+    } else
+#endif
+    {
+        // kill crap data written to pipe
+        char crap[64];
+        while (read(sig_pipe[0], crap, 64) > 0)
+            /* do nothing */;
+    }
 
     // find and block signals that have happened
     for (int signo = 0; signo < NSIG; ++signo)
@@ -136,10 +235,16 @@ void driver::dispatch_signals()
     for (int signo = 0; signo < NSIG; ++signo)
         if (sigismember(&sig_dispatching, signo) > 0
             && !sig_handlers[signo])
-            tamer_sigaction(signo, SIG_DFL);
+            sig_unwatch(signo);
 
     // now that the signal responders have potentially reinstalled signal
-    // handlers, unblock the signals
+    // handlers, unblock the signals (signalfd keeps watched ones blocked)
+#if TAMER_SIGNALFD
+    if (sig_use_fd)
+        for (int signo = 0; signo < NSIG; ++signo)
+            if (sigismember(&sig_fdmask, signo) > 0)
+                sigdelset(&sig_dispatching, signo);
+#endif
     sigprocmask(SIG_UNBLOCK, &sig_dispatching, 0);
     sigemptyset(&sig_dispatching);
 }
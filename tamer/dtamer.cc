@@ -19,11 +19,15 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
+#include <time.h>
 #if HAVE_SYS_EPOLL_H && !TAMER_NOEPOLL
 # include <sys/epoll.h>
 # ifndef EPOLLRDHUP
 #  define EPOLLRDHUP 0
 # endif
+# if HAVE_SYS_TIMERFD_H
+#  include <sys/timerfd.h>
+# endif
 #endif
 
 namespace tamer {
@@ -164,14 +168,15 @@ inline void xfd_setpair::clear() {
 #if HAVE_SYS_EPOLL_H && !TAMER_NOEPOLL
 class xepoll_eventset {
   public:
+    enum { initial_size = 128, max_size = 8192 };
     xepoll_eventset()
-        : es_(new struct epoll_event[128]) {
+        : es_(new struct epoll_event[initial_size]), size_(initial_size) {
     }
     ~xepoll_eventset() {
         delete[] es_;
     }
     int size() const {
-        return 128;
+        return size_;
     }
     struct epoll_event* data() {
         return es_;
@@ -179,8 +184,18 @@ class xepoll_eventset {
     epoll_event& operator[](int i) {
         return es_[i];
     }
+    // A full batch means more events are likely waiting; take more next
+    // time, up to one slot per descriptor registered with epoll.
+    void adapt(int nevents, unsigned nregistered) {
+        if (nevents == size_ && size_ < max_size && unsigned(size_) < nregistered) {
+            delete[] es_;
+            size_ *= 2;
+            es_ = new struct epoll_event[size_];
+        }
+    }
   private:
     struct epoll_event* es_;
+    int size_;
 };
 #endif
 
@@ -191,27 +206,37 @@ class driver_tamer : public driver {
 
     virtual void at_fd(int fd, int action, event<int> e);
     virtual void at_time(const timeval &expiry, event<> e, bool bg);
-    virtual void at_asap(event<> e);
+    virtual void at_deadline(const timeval &expiry, event<> e, int &result);
+    virtual void at_asap(event<> e, priority_class p);
     virtual void at_preblock(event<> e);
     virtual void kill_fd(int fd);
+    virtual void note_would_block(int fd, int action);
 
     virtual void set_error_handler(error_handler_type errh);
+    virtual void set_busy_poll(int usec);
 
     virtual void loop(loop_flags flags);
     virtual void break_loop();
     virtual timeval next_wake() const;
+    virtual bool stats(driver_stats& st) const;
+    virtual void memory_usage(driver_memory& m) const;
 
   private:
 
     struct fdp {
-        inline fdp(driver_tamer*, int) {
+        unsigned char et;
+        inline fdp(driver_tamer*, int)
+            : et(0) {
         }
     };
+    enum { et_readable = 1, et_writable = 2, et_want_read = 4, et_want_write = 8 };
 
     tamerpriv::driver_fdset<fdp> fds_;
     unsigned fdbound_;
 #if HAVE_SYS_EPOLL_H && !TAMER_NOEPOLL
     int epollfd_;
+    unsigned epoll_nregistered_;
+    xepoll_eventset epollnow_;
 #endif
     xfd_setpair fdsets_;
 
@@ -223,11 +248,14 @@ class driver_tamer : public driver {
     bool loop_state_;
 #if HAVE_SYS_EPOLL_H && !TAMER_NOEPOLL
     bool epoll_sig_pipe_;
+    bool epoll_pwait2_;
     pid_t epoll_pid_;
     int epoll_errcount_;
+    int timerfd_;
     enum { EPOLL_MAX_ERRCOUNT = 32 };
 #endif
     int flags_;
+    int busy_poll_usec_;
     error_handler_type errh_;
 
     static void fd_disinterest(void* arg);
@@ -235,6 +263,11 @@ class driver_tamer : public driver {
     int find_bad_fds(xfd_setpair&);
 #if HAVE_SYS_EPOLL_H && !TAMER_NOEPOLL
     static inline int epoll_events(bool readable, bool writable);
+    inline bool epoll_et() const;
+    static inline int epoll_et_events(int et);
+    inline void process_epoll_et(int fd, int events);
+    int epoll_busy_poll(timeval* to);
+    int epoll_block(const timeval* to);
     void report_epoll_error(int fd, int old_events, int events);
     inline void mark_epoll(int fd, int old_events, int events);
     bool epoll_recreate();
@@ -243,19 +276,26 @@ class driver_tamer : public driver {
 
 
 driver_tamer::driver_tamer(int flags)
-    : fdbound_(0), loop_state_(false), flags_(flags), errh_(0) {
+    : fdbound_(0), loop_state_(false), flags_(flags), busy_poll_usec_(0),
+      errh_(0) {
+    if (flags_ & init_timer_wheel)
+        timers_.enable_wheel();
 #if HAVE_SYS_EPOLL_H && !TAMER_NOEPOLL
     epollfd_ = -1;
+    epoll_nregistered_ = 0;
     epoll_errcount_ = EPOLL_MAX_ERRCOUNT;
+    epoll_pwait2_ = true;
+    timerfd_ = -1;
     if (!(flags_ & init_no_epoll)) {
         epollfd_ = epoll_create1(EPOLL_CLOEXEC);
         epoll_sig_pipe_ = false;
         epoll_pid_ = getpid();
     }
-    if (epollfd_ >= 0)
+    if (epollfd_ >= 0) {
         epoll_errcount_ = 0;
-#else
-    (void) flags_;
+        if (post_fd() >= 0)
+            mark_epoll(post_fd(), 0, epoll_events(true, false));
+    }
 #endif
 }
 
@@ -263,6 +303,8 @@ driver_tamer::~driver_tamer() {
 #if HAVE_SYS_EPOLL_H && !TAMER_NOEPOLL
     if (epollfd_ >= 0)
         close(epollfd_);
+    if (timerfd_ >= 0)
+        close(timerfd_);
 #endif
 }
 
@@ -270,6 +312,10 @@ void driver_tamer::set_error_handler(error_handler_type errh) {
     errh_ = errh;
 }
 
+void driver_tamer::set_busy_poll(int usec) {
+    busy_poll_usec_ = std::max(usec, 0);
+}
+
 void driver_tamer::fd_disinterest(void* arg) {
     driver_tamer* d = static_cast<driver_tamer*>(fd_callback_driver(arg));
     d->fds_.push_change(fd_callback_fd(arg));
@@ -280,6 +326,11 @@ void driver_tamer::at_fd(int fd, int action, event<int> e) {
     if (e && (action == 0 || action == 1)) {
         fds_.expand(this, fd);
         tamerpriv::driver_fd<fdp>& x = fds_[fd];
+        if (x.et & (et_readable << action)) {
+            // edge-triggered mode: ready until I/O reports EAGAIN
+            e.trigger(0);
+            return;
+        }
         x.e[action] += TAMER_MOVE(e);
         tamerpriv::simple_event::at_trigger(x.e[action].__get_simple(),
                                             fd_disinterest,
@@ -293,15 +344,49 @@ void driver_tamer::kill_fd(int fd) {
         tamerpriv::driver_fd<fdp> &x = fds_[fd];
         x.e[0].trigger(-ECANCELED);
         x.e[1].trigger(-ECANCELED);
+        // The number may be reused before update_fds() runs, so forget the
+        // registration now; otherwise a new fd with the same interests
+        // would never reach the kernel.
+        if (fd < fdsets_.size()) {
+#if HAVE_SYS_EPOLL_H && !TAMER_NOEPOLL
+            if (!epoll_et() && epollfd_ >= 0)
+                mark_epoll(fd, epoll_events(fdsets_.isset(0, fd),
+                                            fdsets_.isset(1, fd)), 0);
+#endif
+            fdsets_.clear(0, fd);
+            fdsets_.clear(1, fd);
+        }
+#if HAVE_SYS_EPOLL_H && !TAMER_NOEPOLL
+        // A dup of the fd would keep the registration alive past close.
+        if (epoll_et())
+            mark_epoll(fd, epoll_et_events(x.et), 0);
+#endif
+        x.et = 0;
         fds_.push_change(fd);
     }
 }
 
+void driver_tamer::note_would_block(int fd, int action) {
+    if (fd >= 0 && fd < fds_.size() && (action == 0 || action == 1))
+        fds_[fd].et &= ~(et_readable << action);
+}
+
 #if HAVE_SYS_EPOLL_H && !TAMER_NOEPOLL
 inline int driver_tamer::epoll_events(bool readable, bool writable) {
     return (readable ? int(EPOLLIN | EPOLLRDHUP) : 0) | (writable ? int(EPOLLOUT) : 0);
 }
 
+inline bool driver_tamer::epoll_et() const {
+    return (flags_ & init_epoll_et) && epollfd_ >= 0;
+}
+
+inline int driver_tamer::epoll_et_events(int et) {
+    if (et & (et_want_read | et_want_write))
+        return epoll_events(et & et_want_read, et & et_want_write) | EPOLLET;
+    else
+        return 0;
+}
+
 void driver_tamer::report_epoll_error(int fd, int old_events, int events) {
     if (!events && (errno == EBADF || errno == ENOENT))
         return;
@@ -333,23 +418,123 @@ inline void driver_tamer::mark_epoll(int fd, int old_events, int events) {
         else
             action = EPOLL_CTL_DEL;
         int r = epoll_ctl(epollfd_, action, fd, &ev);
+        // a failed delete still counts: closing fd unregistered it
+        if (action == EPOLL_CTL_DEL)
+            --epoll_nregistered_;
+        else if (action == EPOLL_CTL_ADD && r >= 0)
+            ++epoll_nregistered_;
         if (r < 0)
             report_epoll_error(fd, old_events, events);
     }
 }
 
+inline void driver_tamer::process_epoll_et(int fd, int events) {
+    tamerpriv::driver_fd<fdp>& x = fds_[fd];
+    for (int action = 0; action < 2; ++action) {
+        int value;
+        if (events & (action ? int(EPOLLOUT) : int(EPOLLIN | EPOLLRDHUP)))
+            value = 0;
+        else if (events & (EPOLLERR | EPOLLHUP))
+            value = -1;
+        else
+            continue;
+        // The edge won't come again, so the fd stays ready, for this
+        // waiter and the next, until I/O on it reports EAGAIN.
+        x.et |= et_readable << action;
+        x.e[action].trigger(value);
+    }
+}
+
+int driver_tamer::epoll_busy_poll(timeval* to) {
+    // Spin on nonblocking epoll_wait for up to busy_poll_usec_, but not
+    // past the blocking deadline; then charge the time spent to *to.
+    struct timespec start, t;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long limit = busy_poll_usec_;
+    if (to && to->tv_sec == 0 && to->tv_usec < limit)
+        limit = to->tv_usec;
+    long spent;
+    int n;
+    do {
+        n = epoll_wait(epollfd_, epollnow_.data(), epollnow_.size(), 0);
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        spent = (t.tv_sec - start.tv_sec) * 1000000L
+            + (t.tv_nsec - start.tv_nsec) / 1000;
+    } while (n == 0 && spent < limit);
+    if (n == 0 && to) {
+        timeval tspent = { spent / 1000000, spent % 1000000 };
+        if (timercmp(&tspent, to, <))
+            timersub(to, &tspent, to);
+        else
+            timerclear(to);
+    }
+    return n;
+}
+
+int driver_tamer::epoll_block(const timeval* to) {
+    // epoll_wait's timeout is in milliseconds. Rather than spin through
+    // zero-timeout waits, block on a timerfd in the epoll set when the
+    // deadline is under a millisecond away; unlike epoll_pwait2, a timerfd
+    // is not subject to the thread's timer slack. Longer timeouts use
+    // epoll_pwait2 where present.
+    if (!to)
+        return epoll_wait(epollfd_, epollnow_.data(), epollnow_.size(), -1);
+    else if (!timerisset(to))
+        return epoll_wait(epollfd_, epollnow_.data(), epollnow_.size(), 0);
+#if HAVE_SYS_TIMERFD_H
+    if (to->tv_sec == 0 && to->tv_usec < 1000) {
+        if (timerfd_ < 0
+            && (timerfd_ = timerfd_create(CLOCK_MONOTONIC,
+                                          TFD_NONBLOCK | TFD_CLOEXEC)) >= 0)
+            mark_epoll(timerfd_, 0, epoll_events(true, false));
+        struct itimerspec its;
+        memset(&its, 0, sizeof(its));
+        its.it_value.tv_nsec = to->tv_usec * 1000;
+        if (timerfd_ >= 0 && timerfd_settime(timerfd_, 0, &its, 0) == 0) {
+            int n = epoll_wait(epollfd_, epollnow_.data(), epollnow_.size(), -1);
+            // disarming also clears the expiration count
+            its.it_value.tv_nsec = 0;
+            timerfd_settime(timerfd_, 0, &its, 0);
+            return n;
+        }
+    }
+#endif
+#if HAVE_EPOLL_PWAIT2
+    if (epoll_pwait2_) {
+        struct timespec ts = { to->tv_sec, to->tv_usec * 1000 };
+        int n = epoll_pwait2(epollfd_, epollnow_.data(), epollnow_.size(),
+                             &ts, 0);
+        if (n != -1 || errno != ENOSYS)
+            return n;
+        epoll_pwait2_ = false;
+    }
+#endif
+    int blockms = to->tv_sec * 1000 + (to->tv_usec + 250) / 1000;
+    return epoll_wait(epollfd_, epollnow_.data(), epollnow_.size(), blockms);
+}
+
 bool driver_tamer::epoll_recreate() {
     while (epollfd_ < 0 && epoll_errcount_ < EPOLL_MAX_ERRCOUNT
            && (epollfd_ = epoll_create1(EPOLL_CLOEXEC)) >= 0) {
+        epoll_nregistered_ = 0;
         int max = std::min(fds_.size(), fdsets_.size());
         for (int fd = 0; fd < max; ++fd) {
             int events = epoll_events(fdsets_.isset(0, fd),
                                       fdsets_.isset(1, fd));
+            if (flags_ & init_epoll_et) {
+                fds_[fd].et = (fdsets_.isset(0, fd) ? et_want_read : 0)
+                    | (fdsets_.isset(1, fd) ? et_want_write : 0);
+                events = epoll_et_events(fds_[fd].et);
+            }
             if (events)
                 mark_epoll(fd, 0, events);
         }
         if (epoll_sig_pipe_)
             mark_epoll(sig_pipe[0], 0, epoll_events(true, false));
+        if (post_fd() >= 0)
+            mark_epoll(post_fd(), 0, epoll_events(true, false));
+        if (timerfd_ >= 0)
+            mark_epoll(timerfd_, 0, epoll_events(true, false));
         epoll_pid_ = getpid();
     }
     return epollfd_ >= 0;
@@ -372,7 +557,16 @@ void driver_tamer::update_fds() {
         }
 
 #if HAVE_SYS_EPOLL_H && !TAMER_NOEPOLL
-        if (epollfd_ >= 0)
+        if (epoll_et()) {
+            // Interests only grow, so each fd needs at most two epoll_ctl
+            // calls until it is killed.
+            int et = x.et | (x.e[0] ? et_want_read : 0)
+                | (x.e[1] ? et_want_write : 0);
+            if (et != x.et) {
+                mark_epoll(fd, epoll_et_events(x.et), epoll_et_events(et));
+                x.et = et;
+            }
+        } else if (epollfd_ >= 0)
             mark_epoll(fd, epoll_events(wasset[0], wasset[1]),
                        epoll_events(x.e[0], x.e[1]));
 #else
@@ -396,9 +590,15 @@ void driver_tamer::at_time(const timeval &expiry, event<> e, bool bg) {
         timers_.push(expiry, e.__release_simple(), bg);
 }
 
-void driver_tamer::at_asap(event<> e) {
+void driver_tamer::at_deadline(const timeval &expiry, event<> e, int &result) {
+    result = 0;
     if (e)
-        asap_.push(e.__release_simple());
+        timers_.push(expiry, e.__release_simple(), false, &result);
+}
+
+void driver_tamer::at_asap(event<> e, priority_class p) {
+    if (e)
+        asap_.push(e.__release_simple(), p);
 }
 
 void driver_tamer::at_preblock(event<> e) {
@@ -408,22 +608,33 @@ void driver_tamer::at_preblock(event<> e) {
 
 void driver_tamer::loop(loop_flags flags)
 {
-    if (flags == loop_forever)
+    if (!(flags & loop_once))
         loop_state_ = true;
     xfd_setpair fdnow;
+    pid_t pid = getpid();
+    refresh_post_fd(pid);
 #if HAVE_SYS_EPOLL_H && !TAMER_NOEPOLL
-    xepoll_eventset epollnow;
-    if (epollfd_ >= 0 && epoll_pid_ != getpid()) {
+    if (epollfd_ >= 0 && epoll_pid_ != pid) {
         close(epollfd_);
         epollfd_ = -1;
+        // the parent shares the timerfd too
+        if (timerfd_ >= 0) {
+            close(timerfd_);
+            timerfd_ = -1;
+        }
     }
 #endif
 
  again:
-    // process asap events
+    bool sigs = owns_signals();
+    // With a signalfd, the fd's readiness is the only report of a signal,
+    // and dispatches them directly; sig_any_active serves the pipe.
+    bool sigflag = sigs && !sig_use_fd;
+
+    // process preblock events
     while (!preblock_.empty())
         preblock_.pop_trigger();
-    run_unblocked();
+    stats_resumed(driver_stats::phase_preblock, run_unblocked());
 
     // fix file descriptors
     if (fds_.has_change())
@@ -433,15 +644,18 @@ void driver_tamer::loop(loop_flags flags)
     timers_.cull();
     timeval to, *toptr = &to;
     timerclear(&to);
-    if (asap_.empty() && !sig_any_active && !has_unblocked()) {
+    if (asap_.empty() && !(sigflag && sig_any_active) && !has_unblocked()
+        && !has_posted()) {
         if (timers_.empty()) {
-            if (fdbound_ == 0 && sig_nforeground == 0)
+            if (fdbound_ == 0 && (!sigs || sig_nforeground == 0)
+                && !expects_post())
                 // no foreground events!
                 return;
             toptr = 0;
         } else {
             timeval tnow = now();
-            if (!timers_.has_foreground() && fdbound_ == 0 && sig_nforeground == 0
+            if (!timers_.has_foreground() && fdbound_ == 0
+                && (!sigs || sig_nforeground == 0) && !expects_post()
                 && timercmp(&timers_.expiry(), &tnow, >))
                 // no foreground events!
                 return;
@@ -456,51 +670,66 @@ void driver_tamer::loop(loop_flags flags)
 #if HAVE_SYS_EPOLL_H && !TAMER_NOEPOLL
     int nepoll = 0;
     if (epollfd_ >= 0 || epoll_recreate()) {
-        if (!epoll_sig_pipe_ && sig_pipe[0] >= 0) {
+        if (sigs && !epoll_sig_pipe_ && sig_pipe[0] >= 0) {
             mark_epoll(sig_pipe[0], 0, epoll_events(true, false));
             epoll_sig_pipe_ = true;
         }
-        int blockms;
-        if (!toptr)
-            blockms = -1;
-        else
-            blockms = toptr->tv_sec * 1000 + (toptr->tv_usec + 250) / 1000;
-        nepoll = epoll_wait(epollfd_, epollnow.data(), epollnow.size(),
-                            blockms);
+        stats_wait_begin();
+        if ((flags & loop_busy_poll) && (!toptr || timerisset(toptr))
+            && busy_poll_usec_)
+            nepoll = epoll_busy_poll(toptr);
+        if (nepoll == 0)
+            nepoll = epoll_block(toptr);
+        stats_wait_end(nepoll > 0 ? nepoll : 0);
         goto after_select;
     }
 #endif
 
     nfds = fdbound_;
-    if (sig_pipe[0] > nfds) {
+    if (sigs && sig_pipe[0] > nfds) {
         fdsets_.ensure(sig_pipe[0]);
         nfds = sig_pipe[0] + 1;
     }
+    if (post_fd() >= nfds) {
+        fdsets_.ensure(post_fd());
+        nfds = post_fd() + 1;
+    }
     if (nfds > 0) {
         fdnow.copy(fdsets_, nfds);
-        if (sig_pipe[0] >= 0)
+        if (sigs && sig_pipe[0] >= 0)
             fdnow.set(0, sig_pipe[0]);
+        if (post_fd() >= 0)
+            fdnow.set(0, post_fd());
     }
+    stats_wait_begin();
     if (nfds > 0 || !toptr || to.tv_sec != 0 || to.tv_usec != 0) {
         nfds = select(nfds, fdnow.get_fd_set(0), fdnow.get_fd_set(1), 0, toptr);
         if (nfds == -1 && errno == EBADF)
             nfds = find_bad_fds(fdnow);
-        goto after_select;
     }
+    stats_wait_end(nfds > 0 ? nfds : 0);
 
  after_select:
     // process signals
     set_recent();
-    if (sig_any_active)
+    if (sigflag && sig_any_active)
         dispatch_signals();
 
     // process fd events
 #if HAVE_SYS_EPOLL_H && !TAMER_NOEPOLL
     if (epollfd_ >= 0) {
         for (int i = 0; i < nepoll; ++i) {
-            struct epoll_event& e = epollnow[i];
-            if (e.data.fd == sig_pipe[0])
+            struct epoll_event& e = epollnow_[i];
+            if (e.data.fd == sig_pipe[0]) {
+                if (sigs && sig_use_fd)
+                    dispatch_signals();
                 continue;
+            } else if (e.data.fd == post_fd() || e.data.fd == timerfd_)
+                continue;
+            if (flags_ & init_epoll_et) {
+                process_epoll_et(e.data.fd, e.events);
+                continue;
+            }
             if (e.events & (EPOLLIN | EPOLLRDHUP))
                 fds_[e.data.fd].e[0].trigger(0);
             else if (e.events & (EPOLLERR | EPOLLHUP))
@@ -510,34 +739,47 @@ void driver_tamer::loop(loop_flags flags)
             else if (e.events & (EPOLLERR | EPOLLHUP))
                 fds_[e.data.fd].e[1].trigger(-1);
         }
-        run_unblocked();
+        epollnow_.adapt(nepoll, epoll_nregistered_);
+        stats_resumed(driver_stats::phase_fd, run_unblocked());
         goto after_fd;
     }
 #endif
 
     if (nfds > 0) {
+        if (post_fd() >= 0)
+            fdnow.clear(0, post_fd());
+        if (sigs && sig_pipe[0] >= 0 && fdnow.isset(0, sig_pipe[0])) {
+            fdnow.clear(0, sig_pipe[0]);
+            if (sig_use_fd)
+                dispatch_signals();
+        }
         for (unsigned fd = 0; fd < fdbound_; ++fd) {
             tamerpriv::driver_fd<fdp> &x = fds_[fd];
             for (int action = 0; action < 2; ++action)
                 if (fdnow.isset(action, fd))
                     x.e[action].trigger(0);
         }
-        run_unblocked();
+        stats_resumed(driver_stats::phase_fd, run_unblocked());
         goto after_fd;
     }
 
  after_fd:
+    // process events posted from other threads
+    if (has_posted()) {
+        run_posted();
+        stats_resumed(driver_stats::phase_fd, run_unblocked());
+    }
+
     // process timer events
     if (!timers_.empty() && tamerpriv::time_type == time_virtual && nfds == 0)
         tamerpriv::recent = timers_.expiry();
     while (!timers_.empty() && !timercmp(&timers_.expiry(), &recent(), >))
         timers_.pop_trigger();
-    run_unblocked();
+    stats_resumed(driver_stats::phase_timer, run_unblocked());
 
     // process asap events
-    while (!asap_.empty())
-        asap_.pop_trigger();
-    run_unblocked();
+    asap_.run(low_priority_budget());
+    stats_resumed(driver_stats::phase_asap, run_unblocked());
 
     // check flags
     if (loop_state_)
@@ -585,8 +827,9 @@ void driver_tamer::break_loop() {
 timeval driver_tamer::next_wake() const {
     struct timeval tv = { 0, 0 };
     if (!asap_.empty()
-        || sig_any_active
-        || has_unblocked())
+        || (sig_any_active && !sig_use_fd && owns_signals())
+        || has_unblocked()
+        || has_posted())
         /* already zero */;
     else if (timers_.empty())
         tv.tv_sec = -1;
@@ -595,6 +838,21 @@ timeval driver_tamer::next_wake() const {
     return tv;
 }
 
+bool driver_tamer::stats(driver_stats& st) const {
+    if (!driver::stats(st))
+        return false;
+    st.nasap = asap_.size();
+    st.ntimers = timers_.size();
+    return true;
+}
+
+void driver_tamer::memory_usage(driver_memory& m) const {
+    driver::memory_usage(m);
+    m.fd_table = fds_.memory();
+    m.timers = timers_.memory();
+    m.asap = asap_.memory() + preblock_.memory();
+}
+
 } // namespace
 
 driver *driver::make_tamer(int flags) {
@@ -636,7 +636,7 @@ class preevent : public std::unary_function<const T0&, void> {
         operator()(std::get<0>(vs));
     }
     inline void trigger(T0 v0) {
-        operator()(v0);
+        operator()(std::move(v0));
     }
     inline void trigger(const arguments_type& vs) {
         operator()(vs);
@@ -836,7 +836,7 @@ inline void event<T0, T1, T2, T3>::operator()(const arguments_type& vs) {
  */
 template <typename T0, typename T1, typename T2, typename T3>
 inline void event<T0, T1, T2, T3>::trigger(T0 v0, T1 v1, T2 v2, T3 v3) {
-    operator()(v0, v1, v2, v3);
+    operator()(std::move(v0), std::move(v1), std::move(v2), std::move(v3));
 }
 
 /** @brief  Trigger event.
@@ -998,7 +998,7 @@ inline void event<T0, T1, T2>::operator()(const arguments_type& vs) {
 
 template <typename T0, typename T1, typename T2>
 inline void event<T0, T1, T2>::trigger(T0 v0, T1 v1, T2 v2) {
-    operator()(v0, v1, v2);
+    operator()(std::move(v0), std::move(v1), std::move(v2));
 }
 
 template <typename T0, typename T1, typename T2>
@@ -1052,7 +1052,7 @@ inline void event<T0, T1>::operator()(const arguments_type& vs) {
 
 template <typename T0, typename T1>
 inline void event<T0, T1>::trigger(T0 v0, T1 v1) {
-    operator()(v0, v1);
+    operator()(std::move(v0), std::move(v1));
 }
 
 template <typename T0, typename T1>
@@ -1105,7 +1105,7 @@ inline void event<T0>::operator()(const arguments_type& vs) {
 
 template <typename T0>
 inline void event<T0>::trigger(T0 v0) {
-    operator()(v0);
+    operator()(std::move(v0));
 }
 
 template <typename T0>
@@ -1870,4 +1870,8 @@ inline int event<>::line_annotation() const {
 }
 
 } // namespace tamer
+
+#if TAMER_HAVE_CXX_COROUTINES
+# include <tamer/coroutine.hh>
+#endif
 #endif /* TAMER_EVENT_HH */
@@ -29,6 +29,33 @@ namespace tamer {
  *  @brief  Event-based file descriptor wrapper class.
  */
 
+/** @brief  One datagram for fd::recv_batch() and fd::send_batch().
+ *
+ *  For receiving, @a data and @a size describe the caller's buffer; on
+ *  return, @a length is the datagram's length, @a addr and @a addrlen hold
+ *  the sender's address, and @a flags holds the message flags (MSG_TRUNC if
+ *  the datagram was longer than @a size). For sending, @a data and @a size
+ *  describe the payload, and @a addr is the destination when @a addrlen is
+ *  nonzero.
+ *
+ *  @a segment_size supports UDP segmentation offload on kernels that have
+ *  it. When sending, a nonzero @a segment_size asks the kernel to split the
+ *  payload into datagrams of that size (GSO). When receiving on a socket
+ *  with fd::set_udp_gro(true), @a segment_size is set to the size of the
+ *  coalesced segments, or 0 if the datagram was not coalesced (GRO). */
+struct datagram {
+    void* data;
+    size_t size;
+    size_t length;
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    int flags;
+    int segment_size;
+
+    inline datagram();
+    inline datagram(void* data, size_t size);
+};
+
 class fd {
     struct fdimp;
 
@@ -102,12 +129,24 @@ class fd {
     void sendmsg(const void* buf, size_t size, int transfer_fd, event<int> done);
     inline void sendmsg(const void* buf, size_t size, event<int> done);
 
+    void recv_batch(datagram* dgs, int n, event<int> done);
+    void send_batch(const datagram* dgs, int n, event<int> done);
+    int set_udp_gro(bool on);
+
+    void sendfile(fd src, off_t offset, size_t size, size_t* nsent_ptr, event<int> done);
+    inline void sendfile(fd src, off_t offset, size_t size, size_t& nsent, event<int> done);
+    inline void sendfile(fd src, off_t offset, size_t size, event<int> done);
+    static void splice(fd src, fd dst, size_t size, size_t* nspliced_ptr, event<int> done);
+    static inline void splice(fd src, fd dst, size_t size, size_t& nspliced, event<int> done);
+    static inline void splice(fd src, fd dst, size_t size, event<int> done);
+
     void fstat(struct stat& stat, event<int> done);
 
     int listen(int backlog = default_backlog);
     int bind(const struct sockaddr* addr, socklen_t addrlen);
     void accept(struct sockaddr* addr, socklen_t* addrlen, event<fd> result);
     inline void accept(event<fd> result);
+    void accept_many(size_t max, std::vector<fd>& result, event<int> done);
     void connect(const struct sockaddr* addr, socklen_t addrlen,
                  event<int> done);
     inline int shutdown(int how);
@@ -119,41 +158,65 @@ class fd {
     static int open_limit();
     static int open_limit(int n);
 
+    enum file_io_type {
+        file_io_auto = 0, file_io_threads = 1, file_io_uring = 2
+    };
+    static int set_file_io(int type, unsigned nthreads = 0,
+                           unsigned queue_depth = 0);
+
     static int make_nonblocking(int f);
     static int make_blocking(int f);
     inline int make_nonblocking();
 
   private:
+    // A pending write(), visible to the writes queued ahead of it so that
+    // the first of a run can send them all with one writev().
+    struct wreq {
+        const char* buf;
+        size_t size;
+        size_t pos;
+        size_t* nwritten_ptr;
+        event<int>* done;
+        unsigned ticket;
+        fdimp* imp;
+        wreq* prev;
+        wreq* next;
+
+        inline wreq(const void* buf, size_t size, size_t* nwritten_ptr,
+                    event<int>* done);
+        inline ~wreq();
+        inline void link(fdimp* imp);
+    };
+
     struct fdimp {
         int fde_;
         int fdv_;
         mutex rlock_;
         mutex wlock_;
         event<> _at_close;
-#if HAVE_TAMER_FDHELPER
-        bool _is_file;
-#endif
+        bool _is_file;          // offload blocking I/O, if configured
         unsigned ref_count_;
         unsigned weak_count_;
+        unsigned wticket_;
+        wreq* wq_head_;
+        wreq* wq_tail_;
 
         fdimp(int fd)
-            : fde_(fd < 0 ? fd : 0), fdv_(fd)
-#if HAVE_TAMER_FDHELPER
-            , _is_file(false)
-#endif
-            , ref_count_(1), weak_count_(0) {
+            : fde_(fd < 0 ? fd : 0), fdv_(fd), _is_file(false),
+              ref_count_(1), weak_count_(0), wticket_(0),
+              wq_head_(0), wq_tail_(0) {
         }
         void deref() {
             if (!--ref_count_)
-                close();
-            if (!ref_count_ && !weak_count_)
-                delete this;
+                last_deref();
         }
         void weak_deref() {
             if (!--weak_count_ && !ref_count_)
                 delete this;
         }
+        void last_deref();
         int close(int leave_error = -EBADF);
+        ssize_t write_batch(wreq& head);
     };
 
     struct fdcloser {
@@ -171,6 +234,7 @@ class fd {
     };
 
     class closure__accept__P8sockaddrP9socklen_tQ2fd_; void accept(closure__accept__P8sockaddrP9socklen_tQ2fd_&);
+    class closure__accept_many__kRNSt6vectorI2fdEEQi_; void accept_many(closure__accept_many__kRNSt6vectorI2fdEEQi_&);
     class closure__connect__PK8sockaddr9socklen_tQi_; void connect(closure__connect__PK8sockaddr9socklen_tQi_&);
     class closure__read__PvkPkQi_; void read(closure__read__PvkPkQi_&);
     class closure__read__P5ioveciPkQi_; void read(closure__read__P5ioveciPkQi_&);
@@ -182,6 +246,10 @@ class fd {
     class closure__write_once__PKvkRkQi_; void write_once(closure__write_once__PKvkRkQi_ &);
     class closure__write_once__PK5ioveciRkQi_; void write_once(closure__write_once__PK5ioveciRkQi_&);
     class closure__sendmsg__PKvkiQi_; void sendmsg(closure__sendmsg__PKvkiQi_ &);
+    class closure__recv_batch__P8datagramiQi_; void recv_batch(closure__recv_batch__P8datagramiQi_&);
+    class closure__send_batch__PK8datagramiQi_; void send_batch(closure__send_batch__PK8datagramiQi_&);
+    class closure__sendfile__2fd5off_tkPkQi_; void sendfile(closure__sendfile__2fd5off_tkPkQi_&);
+    class closure__splice__2fd2fdkPkQi_; static void splice(closure__splice__2fd2fdkPkQi_&);
     class closure__open__PKci6mode_tQ2fd_; static void open(closure__open__PKci6mode_tQ2fd_ &);
 
     fdimp* _p;
@@ -233,6 +301,9 @@ inline fd tcp_listen(int port);
 fd tcp_listen(int port, int backlog);
 inline void tcp_listen(int port, event<fd> result);
 void tcp_listen(int port, int backlog, event<fd> result);
+fd tcp_listen_reuseport(int port, int backlog = fd::default_backlog);
+int tcp_listen_group(int port, int n, std::vector<fd>& listeners,
+                     int backlog = fd::default_backlog);
 void tcp_connect(struct in_addr addr, int port, event<fd> result);
 inline void tcp_connect(int port, event<fd> result);
 
@@ -664,6 +735,42 @@ inline void fd::sendmsg(const void *buf, size_t size, event<int> done) {
     sendmsg(buf, size, -1, done);
 }
 
+/** @brief  Send file data to this file descriptor.
+ *  @param       src     Source file descriptor.
+ *  @param       offset  Offset in @a src.
+ *  @param       size    Number of bytes to send.
+ *  @param[out]  nsent   Number of bytes sent.
+ *  @param       done    Event triggered on completion.
+ *
+ *  @sa sendfile(fd, off_t, size_t, size_t*, event<int>)
+ */
+inline void fd::sendfile(fd src, off_t offset, size_t size, size_t& nsent, event<int> done) {
+    sendfile(TAMER_MOVE(src), offset, size, &nsent, done);
+}
+
+/** @overload */
+inline void fd::sendfile(fd src, off_t offset, size_t size, event<int> done) {
+    sendfile(TAMER_MOVE(src), offset, size, 0, done);
+}
+
+/** @brief  Move data from one file descriptor to another.
+ *  @param       src        Source file descriptor.
+ *  @param       dst        Destination file descriptor.
+ *  @param       size       Number of bytes to move.
+ *  @param[out]  nspliced   Number of bytes moved.
+ *  @param       done       Event triggered on completion.
+ *
+ *  @sa splice(fd, fd, size_t, size_t*, event<int>)
+ */
+inline void fd::splice(fd src, fd dst, size_t size, size_t& nspliced, event<int> done) {
+    splice(TAMER_MOVE(src), TAMER_MOVE(dst), size, &nspliced, done);
+}
+
+/** @overload */
+inline void fd::splice(fd src, fd dst, size_t size, event<int> done) {
+    splice(TAMER_MOVE(src), TAMER_MOVE(dst), size, 0, done);
+}
+
 /** @brief  Close file descriptor, marking it with an error.
  *  @param  errcode  Optional negative error code.
  *
@@ -686,7 +793,7 @@ inline void fd::error_close(int errcode) {
 /** @brief  Make this file descriptor use nonblocking I/O.
  */
 inline int fd::make_nonblocking() {
-    return make_nonblocking(_p ? _p->fde_ : -EBADF);
+    return make_nonblocking(_p ? _p->fdv_ : -EBADF);
 }
 
 /** @brief  Test whether two file descriptors refer to the same object.
@@ -793,12 +900,36 @@ inline ssize_t fdref::read(void* buf, size_t size) {
 inline void fdref::acquire_write(event<> done) {
     assert(!(flags_ & write_locked));
     flags_ |= write_locked;
-    if (imp_)
+    if (imp_) {
+        ++imp_->wticket_;
         imp_->wlock_.acquire(std::move(done));
-    else
+    } else
         done();
 }
 
+inline fd::wreq::wreq(const void* buf, size_t size, size_t* nwritten_ptr,
+                      event<int>* done)
+    : buf(static_cast<const char*>(buf)), size(size), pos(0),
+      nwritten_ptr(nwritten_ptr), done(done), imp(0) {
+}
+
+inline fd::wreq::~wreq() {
+    if (imp) {
+        (next ? next->prev : imp->wq_tail_) = prev;
+        (prev ? prev->next : imp->wq_head_) = next;
+    }
+}
+
+inline void fd::wreq::link(fdimp* fi) {
+    // call right after acquire_write(), which takes the ticket
+    imp = fi;
+    ticket = fi->wticket_;
+    prev = fi->wq_tail_;
+    next = 0;
+    (prev ? prev->next : fi->wq_head_) = this;
+    fi->wq_tail_ = this;
+}
+
 inline void fdref::release_write() {
     assert(flags_ & write_locked);
     flags_ &= ~write_locked;
@@ -871,6 +1002,15 @@ inline fd unix_stream_listen(std::string path) {
     return unix_stream_listen(TAMER_MOVE(path), fd::default_backlog);
 }
 
+inline datagram::datagram()
+    : data(0), size(0), length(0), addrlen(0), flags(0), segment_size(0) {
+}
+
+inline datagram::datagram(void* data, size_t size)
+    : data(data), size(size), length(0), addrlen(0), flags(0),
+      segment_size(0) {
+}
+
 inline exec_fd::exec_fd(int child_fd, fdtype type, fd f)
     : child_fd(child_fd), type(type), f(f) {
 }
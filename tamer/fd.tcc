@@ -18,6 +18,11 @@
 #include <sys/ioctl.h>
 #include <sys/resource.h>
 #include <sys/un.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#if HAVE_SYS_SENDFILE_H
+# include <sys/sendfile.h>
+#endif
 #include <stdio.h>
 #include <signal.h>
 #include <unistd.h>
@@ -26,7 +31,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <tamer/tamer.hh>
-#if HAVE_TAMER_FDHELPER
+#if HAVE_TAMER_FILEIO
+# include "fdio.hh"
+# include <memory>
+#elif HAVE_TAMER_FDHELPER
 # include <tamer/fdh.hh>
 #endif
 #include <algorithm>
@@ -73,8 +81,65 @@ namespace tamer {
  *  <code>f.write()</code> calls hypothetically happen in parallel.
  */
 
-#if HAVE_TAMER_FDHELPER
-static fdhelper _fdhm;
+#if HAVE_TAMER_FILEIO
+static TAMER_THREAD_LOCAL std::unique_ptr<tamerpriv::file_io> _fio;
+
+static tamerpriv::file_io* file_io() {
+    if (!_fio)
+        _fio.reset(tamerpriv::file_io::make(fd::file_io_auto, 0, 0));
+    return _fio.get();
+}
+
+void tamerpriv::file_io::cleanup() {
+    _fio.reset();
+}
+
+// Like read() and write(), regular-file operations on one fd complete in
+// order: each holds the fd's lock while the backend works.
+tamed static void file_read(fd f, void* buf, size_t size, size_t* nread_ptr,
+                            event<int> done)
+{
+    tvars {
+        fdref fi(f, fdref::weak);
+        std::string data;
+        int ret = -ECANCELED;
+    }
+    twait { fi.acquire_read(make_event()); }
+    if (done && fi) {
+        twait { file_io()->read(fi.fdnum(), size, data, make_event(ret)); }
+    }
+    // the caller's buffer is only valid while it still wants the result
+    if (done) {
+        memcpy(buf, data.data(), data.length());
+        if (nread_ptr)
+            *nread_ptr = data.length();
+    }
+    done.trigger(ret);
+}
+
+tamed static void file_write(fd f, const void* buf, size_t size,
+                             size_t* nwritten_ptr, event<int> done)
+{
+    tvars {
+        fdref fi(f, fdref::weak);
+        size_t nw = 0;
+        int ret = -ECANCELED;
+    }
+    twait { fi.acquire_write(make_event()); }
+    // the backend may outlive buf, so it gets a copy
+    if (done && fi) {
+        twait {
+            file_io()->write(fi.fdnum(),
+                             std::string(static_cast<const char*>(buf), size),
+                             nw, make_event(ret));
+        }
+    }
+    if (done && nwritten_ptr)
+        *nwritten_ptr = nw;
+    done.trigger(ret);
+}
+#elif HAVE_TAMER_FDHELPER
+static TAMER_THREAD_LOCAL fdhelper _fdhm;
 #endif
 
 /** @brief  Make a file descriptor use nonblocking I/O.
@@ -149,7 +214,19 @@ fd fd::open(const char *filename, int flags, mode_t mode) {
     return fd(f == -1 ? -errno : f);
 }
 
-#if HAVE_TAMER_FDHELPER
+#if HAVE_TAMER_FILEIO
+tamed static void fd::open(const char *filename, int flags, mode_t mode, event<fd> done)
+{
+    tvars { int f(); fd nfd; struct stat st; }
+    twait { file_io()->open(filename, flags | O_NONBLOCK, mode, make_event(f)); }
+    nfd = fd(f);
+    // Only regular files block; a named pipe or device uses the driver
+    // like any other fd.
+    if (f >= 0 && ::fstat(f, &st) == 0 && S_ISREG(st.st_mode))
+        nfd._p->_is_file = true;
+    done.trigger(nfd);
+}
+#elif HAVE_TAMER_FDHELPER
 tamed static void fd::open(const char *filename, int flags, mode_t mode, event<fd> done)
 {
     tvars { int f(); fd nfd; }
@@ -213,7 +290,12 @@ void fd::fstat(struct stat &stat_out, event<int> done)
 {
     fdimp *fi = _p;
     if (fi && fi->fde_ >= 0) {
-#if HAVE_TAMER_FDHELPER
+#if HAVE_TAMER_FILEIO
+        if (fi->_is_file)
+            file_io()->fstat(fi->fdv_, stat_out, done);
+        else
+            done.trigger(::fstat(fi->fdv_, &stat_out) == -1 ? -errno : 0);
+#elif HAVE_TAMER_FDHELPER
         _fdhm.fstat(fi->fdv_, stat_out, done);
 #else
         int x = ::fstat(fi->fdv_, &stat_out);
@@ -239,7 +321,12 @@ tamed void fd::read(void *buf, size_t size, size_t* nread_ptr, event<int> done)
         return;
     }
 
-#if HAVE_TAMER_FDHELPER
+#if HAVE_TAMER_FILEIO
+    if (fi.imp_->_is_file) {
+        file_read(*this, buf, size, nread_ptr, done);
+        return;
+    }
+#elif HAVE_TAMER_FDHELPER
     if (fi.imp_->_is_file) {
         _fdhm.read(fi.fdnum(), buf, size, nread, done);
         return;
@@ -257,6 +344,7 @@ tamed void fd::read(void *buf, size_t size, size_t* nread_ptr, event<int> done)
         } else if (amt == 0)
             break;
         else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            tamer::read_would_block(fi.fdnum());
             twait { tamer::at_fd_read(fi.fdnum(), make_event()); }
         } else if (errno != EINTR) {
             done.trigger(-errno);
@@ -315,6 +403,7 @@ tamed void fd::read(struct iovec* iov, int iov_count, size_t* nread_ptr, event<i
         } else if (amt == 0)
             break;
         else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            tamer::read_would_block(fi.fdnum());
             twait { tamer::at_fd_read(fi.fdnum(), make_event()); }
         } else if (errno != EINTR) {
             done.trigger(-errno);
@@ -347,6 +436,7 @@ tamed void fd::read_once(void* buf, size_t size, size_t& nread, event<int> done)
             nread = amt;
             break;
         } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            tamer::read_would_block(fi.fdnum());
             twait { tamer::at_fd_read(fi.fdnum(), make_event()); }
         } else if (errno != EINTR) {
             done.trigger(-errno);
@@ -379,6 +469,7 @@ tamed void fd::read_once(const struct iovec* iov, int iov_count, size_t& nread,
             nread = amt;
             break;
         } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            tamer::read_would_block(fi.fdnum());
             twait { tamer::at_fd_read(fi.fdnum(), make_event()); }
         } else if (errno != EINTR) {
             done.trigger(-errno);
@@ -389,13 +480,24 @@ tamed void fd::read_once(const struct iovec* iov, int iov_count, size_t& nread,
     done.trigger(0);
 }
 
+/** @brief  Write to file descriptor.
+ *  @param       buf           Buffer.
+ *  @param       size          Buffer size.
+ *  @param[out]  nwritten_ptr  If nonnull, number of characters written.
+ *  @param       done          Event triggered on completion.
+ *
+ *  Consecutive write() calls on the same file descriptor are coalesced:
+ *  the write at the head of a run of queued writes sends all of their
+ *  data with a single writev(), and each caller's @a done is triggered
+ *  once its own data is written.
+ */
 tamed void fd::write(const void* buf, size_t size, size_t* nwritten_ptr,
                      event<int> done)
 {
     tvars {
-        size_t pos = 0;
         ssize_t amt;
         fdref fi(*this, fdref::weak);
+        wreq req(buf, size, nwritten_ptr, &done);
     }
 
     if (nwritten_ptr)
@@ -406,24 +508,32 @@ tamed void fd::write(const void* buf, size_t size, size_t* nwritten_ptr,
         return;
     }
 
-#if HAVE_TAMER_FDHELPER
+#if HAVE_TAMER_FILEIO
+    if (fi.imp_->_is_file) {
+        file_write(*this, buf, size, nwritten_ptr, done);
+        return;
+    }
+#elif HAVE_TAMER_FDHELPER
     if (fi.imp_->_is_file) {
         _fdhm.write(fi.fdnum(), buf, size, nwritten, done);
         return;
     }
 #endif
 
-    twait { fi.acquire_write(make_event()); }
+    twait {
+        fi.acquire_write(make_event());
+        req.link(fi.imp_);
+    }
 
-    while (pos != size && done && fi) {
-        amt = fi.write(static_cast<const char*>(buf) + pos, size - pos);
-        if (amt != 0 && amt != (ssize_t) -1) {
-            pos += amt;
-            if (nwritten_ptr)
-                *nwritten_ptr = pos;
-        } else if (amt == 0)
+    // An earlier write may already have sent some or all of our data.
+    while (req.pos != size && done && fi) {
+        amt = fi.imp_->write_batch(req);
+        if (amt != 0 && amt != (ssize_t) -1)
+            /* progress */;
+        else if (amt == 0)
             break;
         else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            tamer::write_would_block(fi.fdnum());
             twait { tamer::at_fd_write(fi.fdnum(), make_event()); }
         } else if (errno != EINTR) {
             done.trigger(-errno);
@@ -431,7 +541,50 @@ tamed void fd::write(const void* buf, size_t size, size_t* nwritten_ptr,
         }
     }
 
-    done.trigger(pos == size || fi ? 0 : -ECANCELED);
+    done.trigger(req.pos == size || fi ? 0 : -ECANCELED);
+}
+
+ssize_t fd::fdimp::write_batch(wreq& head) {
+    // Gather the unwritten part of head, then the writes queued directly
+    // behind it. A gap in tickets means some other operation holds a place
+    // in the write lock queue, and writes after it must wait their turn.
+    enum { max_iov = 64 };
+    struct iovec iov[max_iov];
+    wreq* last = &head;
+    int niov = 0;
+    iov[niov].iov_base = const_cast<char*>(head.buf + head.pos);
+    iov[niov].iov_len = head.size - head.pos;
+    ++niov;
+    for (wreq* r = head.next;
+         r && niov != max_iov && r->ticket == last->ticket + 1
+             && *r->done && r->pos == 0;
+         last = r, r = r->next)
+        if (r->size) {
+            iov[niov].iov_base = const_cast<char*>(r->buf);
+            iov[niov].iov_len = r->size;
+            ++niov;
+        }
+
+    ssize_t amt = niov == 1 ? ::write(fdv_, iov[0].iov_base, iov[0].iov_len)
+        : ::writev(fdv_, iov, niov);
+    if (amt == 0 || amt == (ssize_t) -1)
+        return amt;
+
+    // Credit the written bytes in order. Writes that are complete finish
+    // now, head first; a partly written one continues when it gets the lock.
+    size_t left = amt;
+    for (wreq* r = &head; left != 0 || r->pos == r->size; r = r->next) {
+        size_t n = std::min(left, r->size - r->pos);
+        r->pos += n;
+        left -= n;
+        if (r->nwritten_ptr)
+            *r->nwritten_ptr = r->pos;
+        if (r->pos == r->size)
+            r->done->trigger(0);
+        if (r == last)
+            break;
+    }
+    return amt;
 }
 
 tamed void fd::write(std::string s, size_t* nwritten_ptr, event<int> done)
@@ -491,6 +644,7 @@ tamed void fd::write(struct iovec* iov, int iov_count, size_t* nwritten_ptr,
         } else if (amt == 0)
             break;
         else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            tamer::write_would_block(fi.fdnum());
             twait { tamer::at_fd_write(fi.fdnum(), make_event()); }
         } else if (errno != EINTR) {
             done.trigger(-errno);
@@ -538,6 +692,7 @@ tamed void fd::write_once(const void *buf, size_t size, size_t &nwritten, event<
             nwritten = amt;
             break;
         } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            tamer::write_would_block(fi.fdnum());
             twait { tamer::at_fd_write(fi.fdnum(), make_event()); }
         } else if (errno != EINTR) {
             done.trigger(-errno);
@@ -586,6 +741,7 @@ tamed void fd::write_once(const struct iovec* iov, int iov_count, size_t& nwritt
             nwritten = amt;
             break;
         } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            tamer::write_would_block(fi.fdnum());
             twait { tamer::at_fd_write(fi.fdnum(), make_event()); }
         } else if (errno != EINTR) {
             done.trigger(-errno);
@@ -666,6 +822,7 @@ tamed void fd::sendmsg(const void *buf, size_t size, int transfer_fd,
         if (amt != (ssize_t) -1)
             break;
         else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            tamer::write_would_block(fi.fdnum());
             twait { tamer::at_fd_write(fi.fdnum(), make_event()); }
         } else if (errno != EINTR)
             done.trigger(-errno);
@@ -674,6 +831,512 @@ tamed void fd::sendmsg(const void *buf, size_t size, int transfer_fd,
     done.trigger(fi ? 0 : -ECANCELED);
 }
 
+// Batched datagram I/O. Each system call moves at most datagram_batch
+// datagrams, so the message headers can live on the stack.
+enum { datagram_batch = 64 };
+
+union datagram_control {
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+};
+
+static void datagram_received(datagram& d, const struct msghdr& m,
+                              size_t len)
+{
+    d.length = len;
+    d.addrlen = m.msg_namelen;
+    d.flags = m.msg_flags;
+    d.segment_size = 0;
+#ifdef UDP_GRO
+    for (struct cmsghdr* c = CMSG_FIRSTHDR(&m); c;
+         c = CMSG_NXTHDR(const_cast<struct msghdr*>(&m), c))
+        if (c->cmsg_level == IPPROTO_UDP && c->cmsg_type == UDP_GRO
+            && c->cmsg_len >= CMSG_LEN(sizeof(int)))
+            memcpy(&d.segment_size, CMSG_DATA(c), sizeof(int));
+#endif
+}
+
+// Receive up to @a n datagrams without blocking. Returns the number
+// received, or -1 with errno set if none were.
+static int recv_datagrams(int f, datagram* dgs, int n)
+{
+    struct mmsghdr mm[datagram_batch];
+    struct iovec iov[datagram_batch];
+    datagram_control control[datagram_batch];
+    int nrecv = 0;
+
+    while (nrecv < n) {
+        int k = std::min(n - nrecv, (int) datagram_batch);
+        for (int i = 0; i != k; ++i) {
+            datagram& d = dgs[nrecv + i];
+            struct msghdr& m = mm[i].msg_hdr;
+            iov[i].iov_base = d.data;
+            iov[i].iov_len = d.size;
+            m.msg_name = &d.addr;
+            m.msg_namelen = sizeof(d.addr);
+            m.msg_iov = &iov[i];
+            m.msg_iovlen = 1;
+            m.msg_control = control[i].buf;
+            m.msg_controllen = sizeof(control[i].buf);
+            m.msg_flags = 0;
+            mm[i].msg_len = 0;
+        }
+
+        int r;
+#if HAVE_RECVMMSG
+        r = ::recvmmsg(f, mm, k, MSG_DONTWAIT, 0);
+#else
+        for (r = 0; r != k; ++r) {
+            ssize_t amt = ::recvmsg(f, &mm[r].msg_hdr, MSG_DONTWAIT);
+            if (amt == (ssize_t) -1)
+                break;
+            mm[r].msg_len = amt;
+        }
+        if (r == 0)
+            r = -1;
+#endif
+        if (r <= 0)
+            return nrecv ? nrecv : -1;
+        for (int i = 0; i != r; ++i)
+            datagram_received(dgs[nrecv + i], mm[i].msg_hdr, mm[i].msg_len);
+        nrecv += r;
+        if (r < k)
+            break;
+    }
+    return nrecv;
+}
+
+// Send up to @a n datagrams without blocking. Returns the number sent, or
+// -1 with errno set if none were.
+static int send_datagrams(int f, const datagram* dgs, int n)
+{
+    struct mmsghdr mm[datagram_batch];
+    struct iovec iov[datagram_batch];
+    datagram_control control[datagram_batch];
+    int nsent = 0;
+
+    while (nsent < n) {
+        int k = std::min(n - nsent, (int) datagram_batch);
+        for (int i = 0; i != k; ++i) {
+            const datagram& d = dgs[nsent + i];
+            struct msghdr& m = mm[i].msg_hdr;
+            iov[i].iov_base = d.data;
+            iov[i].iov_len = d.size;
+            m.msg_name = d.addrlen ? const_cast<struct sockaddr_storage*>(&d.addr) : 0;
+            m.msg_namelen = d.addrlen;
+            m.msg_iov = &iov[i];
+            m.msg_iovlen = 1;
+            m.msg_control = 0;
+            m.msg_controllen = 0;
+            m.msg_flags = 0;
+            if (d.segment_size > 0) {
+#ifdef UDP_SEGMENT
+                uint16_t segment_size = d.segment_size;
+                m.msg_control = control[i].buf;
+                m.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+                struct cmsghdr* c = CMSG_FIRSTHDR(&m);
+                c->cmsg_level = IPPROTO_UDP;
+                c->cmsg_type = UDP_SEGMENT;
+                c->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                memcpy(CMSG_DATA(c), &segment_size, sizeof(uint16_t));
+#else
+                if (i == 0 && nsent == 0) {
+                    errno = EOPNOTSUPP;
+                    return -1;
+                }
+                k = i;
+                break;
+#endif
+            }
+        }
+
+        int r;
+#if HAVE_SENDMMSG
+        r = ::sendmmsg(f, mm, k, MSG_DONTWAIT);
+#else
+        for (r = 0; r != k; ++r)
+            if (::sendmsg(f, &mm[r].msg_hdr, MSG_DONTWAIT) == (ssize_t) -1)
+                break;
+        if (r == 0)
+            r = -1;
+#endif
+        if (r <= 0)
+            return nsent ? nsent : -1;
+        nsent += r;
+        if (r < k)
+            break;
+    }
+    return nsent;
+}
+
+/** @brief  Receive a batch of datagrams.
+ *  @param       dgs   Datagram array.
+ *  @param       n     Number of elements in @a dgs.
+ *  @param       done  Event triggered on completion.
+ *
+ *  Waits for at least one datagram, then receives as many pending
+ *  datagrams as fit in @a dgs, using recvmmsg() where available. Each
+ *  datagram is stored in the caller's buffer given by its @a data and @a
+ *  size members, and its @a length, @a addr, @a addrlen, @a flags, and @a
+ *  segment_size members are filled in. @a done is triggered with the
+ *  number of datagrams received, or with a negative error code if none
+ *  were.
+ *
+ *  @sa send_batch(), datagram
+ */
+tamed void fd::recv_batch(datagram* dgs, int n, event<int> done)
+{
+    tvars {
+        int r = -ECANCELED;
+        fdref fi(*this, fdref::weak);
+    }
+
+    if (!fi) {
+        done.trigger(-EBADF);
+        return;
+    } else if (n <= 0) {
+        done.trigger(0);
+        return;
+    }
+
+    twait { fi.acquire_read(make_event()); }
+
+    while (done && fi) {
+        r = recv_datagrams(fi.fdnum(), dgs, n);
+        if (r >= 0)
+            break;
+        else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            r = -ECANCELED;
+            tamer::read_would_block(fi.fdnum());
+            twait { tamer::at_fd_read(fi.fdnum(), make_event()); }
+        } else if (errno != EINTR) {
+            r = -errno;
+            break;
+        }
+    }
+
+    done.trigger(r);
+}
+
+/** @brief  Send a batch of datagrams.
+ *  @param  dgs   Datagram array.
+ *  @param  n     Number of elements in @a dgs.
+ *  @param  done  Event triggered on completion.
+ *
+ *  Sends the datagrams in @a dgs in order, using sendmmsg() where
+ *  available, and waits whenever the socket buffer is full. Each
+ *  datagram's payload is given by its @a data and @a size members; its
+ *  destination is @a addr if @a addrlen is nonzero, and otherwise the
+ *  connected peer. A nonzero @a segment_size requests UDP segmentation
+ *  offload, and fails with -EOPNOTSUPP where the system lacks it. @a done
+ *  is triggered with the number of datagrams sent, which is less than @a n
+ *  only on error, or with a negative error code if none were sent.
+ *
+ *  @sa recv_batch(), datagram
+ */
+tamed void fd::send_batch(const datagram* dgs, int n, event<int> done)
+{
+    tvars {
+        int r, nsent = 0, err = -ECANCELED;
+        fdref fi(*this, fdref::weak);
+    }
+
+    if (!fi) {
+        done.trigger(-EBADF);
+        return;
+    }
+
+    twait { fi.acquire_write(make_event()); }
+
+    while (done && fi && nsent < n) {
+        r = send_datagrams(fi.fdnum(), dgs + nsent, n - nsent);
+        if (r >= 0)
+            nsent += r;
+        else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            tamer::write_would_block(fi.fdnum());
+            twait { tamer::at_fd_write(fi.fdnum(), make_event()); }
+        } else if (errno != EINTR) {
+            err = -errno;
+            break;
+        }
+    }
+
+    done.trigger(nsent != 0 || n <= 0 ? nsent : err);
+}
+
+/** @brief  Enable or disable UDP receive offload (GRO).
+ *  @param  on  True to enable.
+ *
+ *  With GRO on, recv_batch() may return several same-sized datagrams
+ *  coalesced into one buffer, with datagram::segment_size set to the size
+ *  of each. Returns 0 on success, or a negative error code
+ *  (-ENOPROTOOPT where the system lacks GRO).
+ */
+int fd::set_udp_gro(bool on)
+{
+    if (!*this)
+        return -EBADF;
+#ifdef UDP_GRO
+    int v = on;
+    return (::setsockopt(_p->fdv_, IPPROTO_UDP, UDP_GRO, &v, sizeof(v)) == 0
+            ? 0 : -errno);
+#else
+    return on ? -ENOPROTOOPT : 0;
+#endif
+}
+
+/** @brief  Send file data to this file descriptor.
+ *  @param       src        Source file descriptor.
+ *  @param       offset     Offset in @a src.
+ *  @param       size       Number of bytes to send.
+ *  @param[out]  nsent_ptr  If nonnull, number of bytes sent.
+ *  @param       done       Event triggered on completion.
+ *
+ *  Writes @a size bytes from @a src, starting at @a offset, to this file
+ *  descriptor. The file offset of @a src is not changed. Where possible
+ *  the data moves within the kernel via sendfile(2); otherwise, or if the
+ *  kernel refuses @a src, it is copied through a buffer with pread() and
+ *  write(). The send is ordered with respect to other writes on this file
+ *  descriptor. @a done is triggered with 0 on success or end-of-file, or a
+ *  negative error code. @a *nsent_ptr is kept up to date as the send
+ *  progresses.
+ */
+tamed void fd::sendfile(fd src, off_t offset, size_t size, size_t* nsent_ptr,
+                        event<int> done)
+{
+    tvars {
+        size_t pos = 0;
+        ssize_t amt;
+        bool copying = false;
+        std::string buf;
+        size_t bufpos = 0;
+        size_t buflen = 0;
+        fdref fi(*this, fdref::weak);
+        fdref si(src, fdref::weak);
+    }
+
+    if (nsent_ptr)
+        *nsent_ptr = 0;
+
+    if (!fi || !si) {
+        done.trigger(-EBADF);
+        return;
+    }
+
+    twait { fi.acquire_write(make_event()); }
+
+    while (pos != size && done && fi && si) {
+        if (!copying) {
+#if HAVE_SYS_SENDFILE_H
+            off_t off = offset + pos;
+            amt = ::sendfile(fi.fdnum(), si.fdnum(), &off, size - pos);
+            if (amt == (ssize_t) -1 && (errno == EINVAL || errno == ENOSYS))
+                copying = true;
+#else
+            copying = true;
+#endif
+            if (copying) {
+                buf.resize(65536);
+                continue;
+            }
+        } else {
+            if (bufpos == buflen) {
+                amt = ::pread(si.fdnum(), &buf[0],
+                              std::min(buf.size(), size - pos), offset + pos);
+                if (amt == 0)
+                    break;
+                else if (amt == (ssize_t) -1 && errno == EINTR)
+                    continue;
+                else if (amt == (ssize_t) -1) {
+                    done.trigger(-errno);
+                    break;
+                }
+                bufpos = 0;
+                buflen = amt;
+            }
+            amt = ::write(fi.fdnum(), &buf[bufpos], buflen - bufpos);
+            if (amt != 0 && amt != (ssize_t) -1)
+                bufpos += amt;
+        }
+        if (amt != 0 && amt != (ssize_t) -1) {
+            pos += amt;
+            if (nsent_ptr)
+                *nsent_ptr = pos;
+        } else if (amt == 0)
+            break;
+        else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            tamer::write_would_block(fi.fdnum());
+            twait { tamer::at_fd_write(fi.fdnum(), make_event()); }
+        } else if (errno != EINTR) {
+            done.trigger(-errno);
+            break;
+        }
+    }
+
+    done.trigger(pos == size || (fi && si) ? 0 : -ECANCELED);
+}
+
+/** @brief  Move data from one file descriptor to another.
+ *  @param       src           Source file descriptor.
+ *  @param       dst           Destination file descriptor.
+ *  @param       size          Number of bytes to move.
+ *  @param[out]  nspliced_ptr  If nonnull, number of bytes moved.
+ *  @param       done          Event triggered on completion.
+ *
+ *  Reads up to @a size bytes from @a src and writes them to @a dst. On
+ *  Linux the data moves within the kernel via splice(2), directly if either
+ *  end is a pipe and through a private pipe otherwise; elsewhere, or if
+ *  the kernel refuses either file descriptor, it is copied through a
+ *  buffer. The operation is ordered with respect to other reads on @a src
+ *  and other writes on @a dst. @a done is triggered with 0 on success or
+ *  end-of-file, or a negative error code. @a *nspliced_ptr is kept up to
+ *  date as the operation progresses.
+ */
+tamed static void fd::splice(fd src, fd dst, size_t size,
+                             size_t* nspliced_ptr, event<int> done)
+{
+    tvars {
+        size_t pos = 0;
+        ssize_t amt;
+        int mode = 0;
+        int pipe_r = -1;
+        int pipe_w = -1;
+        size_t inpipe = 0;
+        bool want_read = false;
+        std::string buf;
+        size_t bufpos = 0;
+        size_t buflen = 0;
+        fdref si(src, fdref::weak);
+        fdref di(dst, fdref::weak);
+    }
+
+    if (nspliced_ptr)
+        *nspliced_ptr = 0;
+
+    if (!si || !di) {
+        done.trigger(-EBADF);
+        return;
+    }
+
+    twait { si.acquire_read(make_event()); }
+    twait { di.acquire_write(make_event()); }
+
+    // mode 0 splices directly, mode 1 splices through a private pipe, and
+    // mode 2 copies through buf
+#if !HAVE_SPLICE
+    mode = 2;
+#endif
+
+    while (pos != size && done && si && di) {
+        amt = 0;
+        if (mode == 0) {
+#if HAVE_SPLICE
+            amt = ::splice(si.fdnum(), 0, di.fdnum(), 0, size - pos,
+                           SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (amt == (ssize_t) -1 && errno == EINVAL) {
+                // neither end is a pipe; interpose one
+                int p[2];
+                mode = ::pipe2(p, O_NONBLOCK | O_CLOEXEC) == 0 ? 1 : 2;
+                pipe_r = mode == 1 ? p[0] : -1;
+                pipe_w = mode == 1 ? p[1] : -1;
+                continue;
+            } else if (amt == (ssize_t) -1 && errno == EAGAIN) {
+                // which end is blocking us?
+                struct pollfd pfd;
+                pfd.fd = di.fdnum();
+                pfd.events = POLLOUT;
+                want_read = ::poll(&pfd, 1, 0) == 1;
+            } else if (amt > 0) {
+                pos += amt;
+                if (nspliced_ptr)
+                    *nspliced_ptr = pos;
+                continue;
+            }
+#endif
+        } else if (mode == 1 && inpipe == 0) {
+#if HAVE_SPLICE
+            amt = ::splice(si.fdnum(), 0, pipe_w, 0,
+                           std::min(size - pos, size_t(65536)),
+                           SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (amt == (ssize_t) -1 && errno == EINVAL) {
+                mode = 2;
+                continue;
+            } else if (amt > 0) {
+                inpipe = amt;
+                continue;
+            }
+            want_read = true;
+#endif
+        } else if (mode == 1) {
+#if HAVE_SPLICE
+            amt = ::splice(pipe_r, 0, di.fdnum(), 0, inpipe,
+                           SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (amt == (ssize_t) -1 && errno == EINVAL) {
+                // drain the pipe and finish by copying
+                buf.resize(65536);
+                amt = ::read(pipe_r, &buf[0], inpipe);
+                bufpos = 0;
+                buflen = amt > 0 ? amt : 0;
+                inpipe = 0;
+                mode = 2;
+                continue;
+            } else if (amt > 0) {
+                inpipe -= amt;
+                pos += amt;
+                if (nspliced_ptr)
+                    *nspliced_ptr = pos;
+                continue;
+            }
+            want_read = false;
+#endif
+        } else {
+            if (buf.empty())
+                buf.resize(65536);
+            if (bufpos == buflen) {
+                amt = ::read(si.fdnum(), &buf[0],
+                             std::min(buf.size(), size - pos));
+                if (amt > 0) {
+                    bufpos = 0;
+                    buflen = amt;
+                    continue;
+                }
+                want_read = true;
+            } else {
+                amt = ::write(di.fdnum(), &buf[bufpos], buflen - bufpos);
+                if (amt > 0) {
+                    bufpos += amt;
+                    pos += amt;
+                    if (nspliced_ptr)
+                        *nspliced_ptr = pos;
+                    continue;
+                }
+                want_read = false;
+            }
+        }
+
+        if (amt == 0)
+            break;
+        else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            if (want_read) {
+                tamer::read_would_block(si.fdnum());
+                twait { tamer::at_fd_read(si.fdnum(), make_event()); }
+            } else {
+                tamer::write_would_block(di.fdnum());
+                twait { tamer::at_fd_write(di.fdnum(), make_event()); }
+            }
+        } else if (errno != EINTR) {
+            done.trigger(-errno);
+            break;
+        }
+    }
+
+    if (pipe_r >= 0) {
+        ::close(pipe_r);
+        ::close(pipe_w);
+    }
+    done.trigger(pos == size || (si && di) ? 0 : -ECANCELED);
+}
+
 /** @brief  Create a socket file descriptor.
  *  @param  domain    Socket domain.
  *  @param  type      Socket type.
@@ -719,13 +1382,31 @@ int fd::bind(const struct sockaddr *addr, socklen_t addrlen)
         return -EBADF;
 }
 
+// Accepted descriptors are nonblocking and close-on-exec. accept4 does both
+// in the same system call.
+static int accept_nonblocking(int lfd, struct sockaddr* addr,
+                              socklen_t* addrlen)
+{
+#if HAVE_ACCEPT4 && defined(SOCK_NONBLOCK) && defined(SOCK_CLOEXEC)
+    return ::accept4(lfd, addr, addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+    int f = ::accept(lfd, addr, addrlen);
+    if (f >= 0) {
+        fd::make_nonblocking(f);
+        (void) ::fcntl(f, F_SETFD, FD_CLOEXEC);
+    }
+    return f;
+#endif
+}
+
 /** @brief  Accept new connection on listening socket file descriptor.
  *  @param[out]     addr     Socket address of connecting client.
  *  @param[in,out]  addrlen  Length of @a addr.
  *  @param          result   Event triggered on completion.
  *
  *  Accepts a new connection on a listening socket, returning it via the
- *  @a result event.  The returned file descriptor is made nonblocking.
+ *  @a result event.  The returned file descriptor is made nonblocking and
+ *  close-on-exec.
  *  To check whether the accept succeeded, use valid() or error() on the
  *  resulting file descriptor.
  *
@@ -751,11 +1432,11 @@ tamed void fd::accept(struct sockaddr *addr_out, socklen_t *addrlen_out,
     twait { fi.acquire_read(make_event()); }
 
     while (done && fi) {
-        f = ::accept(fi.fdnum(), addr_out, addrlen_out);
-        if (f >= 0) {
-            make_nonblocking(f);
+        f = accept_nonblocking(fi.fdnum(), addr_out, addrlen_out);
+        if (f >= 0)
             break;
-        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            tamer::read_would_block(fi.fdnum());
             twait { tamer::at_fd_read(fi.fdnum(), make_event()); }
         } else if (errno != EINTR) {
             f = -errno;
@@ -766,6 +1447,61 @@ tamed void fd::accept(struct sockaddr *addr_out, socklen_t *addrlen_out,
     done.trigger(fd(f));
 }
 
+/** @brief  Accept a batch of connections on a listening socket.
+ *  @param       max     Maximum number of connections to accept.
+ *  @param[out]  result  Accepted connections are appended here.
+ *  @param       done    Event triggered on completion.
+ *
+ *  Waits for at least one pending connection, then accepts pending
+ *  connections until the backlog is empty or @a max have been accepted,
+ *  all in one wakeup. Accepted file descriptors are nonblocking and
+ *  close-on-exec. @a done is triggered with the number of connections
+ *  appended to @a result, or with a negative error code if none were.
+ *  An error after some connections were accepted is reported by the next
+ *  call.
+ *
+ *  @sa accept(event<fd>)
+ */
+tamed void fd::accept_many(size_t max, std::vector<fd>& result,
+                           event<int> done)
+{
+    tvars {
+        int f = -ECANCELED;
+        size_t n = 0;
+        fdref fi(*this, fdref::weak);
+    }
+
+    if (!fi) {
+        done.trigger(-EBADF);
+        return;
+    } else if (max == 0) {
+        done.trigger(0);
+        return;
+    }
+
+    twait { fi.acquire_read(make_event()); }
+
+    while (done && fi) {
+        f = accept_nonblocking(fi.fdnum(), 0, 0);
+        if (f >= 0) {
+            result.push_back(fd(f));
+            if (++n == max)
+                break;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            tamer::read_would_block(fi.fdnum());
+            if (n != 0)
+                break;
+            f = -ECANCELED;
+            twait { tamer::at_fd_read(fi.fdnum(), make_event()); }
+        } else if (errno != EINTR) {
+            f = -errno;
+            break;
+        }
+    }
+
+    done.trigger(n != 0 ? (int) n : f);
+}
+
 /** @brief  Connect socket file descriptor.
  *  @param  addr     Remote address.
  *  @param  addrlen  Length of remote address.
@@ -809,6 +1545,14 @@ tamed void fd::connect(const struct sockaddr *addr, socklen_t addrlen,
 }
 
 
+// close() may trigger _at_close and drop the last weak reference, so a
+// weak reference is held until it returns.
+void fd::fdimp::last_deref() {
+    ++weak_count_;
+    close();
+    weak_deref();
+}
+
 /** @brief  Close file descriptor.
  *
  *  Equivalent to close(event<int>()).
@@ -820,14 +1564,15 @@ int fd::fdimp::close(int leave_error) {
     if (my_fd >= 0 || leave_error != -EBADF)
         fde_ = leave_error;
     if (my_fd >= 0) {
+        // drivers may need the fd open to drop their registrations
+        if (driver::main)
+            driver::main->kill_fd(my_fd);
         int x = ::close(my_fd);
         if (x == -1) {
             x = -errno;
             if (fde_ == -EBADF)
                 fde_ = x;
         }
-        if (driver::main)
-            driver::main->kill_fd(my_fd);
         _at_close.trigger();
     }
     return fde_ < 0 ? fde_ : fdv_;
@@ -844,6 +1589,34 @@ int fd::open_limit() {
 }
 
 
+/** @brief  Choose how this thread performs blocking file I/O.
+ *  @param  type         fd::file_io_threads, fd::file_io_uring, or
+ *                       fd::file_io_auto.
+ *  @param  nthreads     Worker threads for fd::file_io_threads.
+ *  @param  queue_depth  Most operations handed to the backend at once;
+ *                       more wait their turn.
+ *  @return 0 on success, -EBUSY if this thread has already done file I/O,
+ *          or -EOPNOTSUPP if @a type is unavailable.
+ *
+ *  When Tamer is configured with <code>--enable-file-io</code>, regular
+ *  files opened with fd::open(const char*, int, mode_t, event<fd>) are
+ *  read and written without blocking the driver. fd::file_io_threads uses
+ *  a pool of worker threads; fd::file_io_uring submits operations to an
+ *  io_uring. fd::file_io_auto, the default, prefers io_uring. Zero for
+ *  @a nthreads or @a queue_depth selects a default (4 and 256). */
+int fd::set_file_io(int type, unsigned nthreads, unsigned queue_depth) {
+#if HAVE_TAMER_FILEIO
+    if (_fio)
+        return -EBUSY;
+    _fio.reset(tamerpriv::file_io::make(type, nthreads, queue_depth));
+    return _fio ? 0 : -EOPNOTSUPP;
+#else
+    (void) type, (void) nthreads, (void) queue_depth;
+    return -EOPNOTSUPP;
+#endif
+}
+
+
 /** @brief Set the limit on the number of open files for this process.
     @return The new limit, or a negative error code.
 
@@ -866,23 +1639,25 @@ int fd::open_limit(int n) {
 }
 
 
-/** @brief  Open a TCP listening socket receiving connections to @a port.
- *  @param  port     Listening port (in host byte order).
- *  @param  backlog  Maximum connection backlog.
- *  @return File descriptor.
- *
- *  The returned file descriptor is made nonblocking, and is opened with the
- *  @c SO_REUSEADDR option. A negative value is returned on error. To check
- *  whether the function succeeded, use valid() or error() on the resulting
- *  file descriptor.
- */
-fd tcp_listen(int port, int backlog)
+static fd tcp_listen(int port, int backlog, bool reuseport)
 {
     fd f = fd::socket(AF_INET, SOCK_STREAM, 0);
     if (f) {
         // Default to reusing port addresses.  Don't worry if it fails
         int yes = 1;
         (void) setsockopt(f.fdnum(), SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int));
+#ifdef SO_REUSEPORT
+        if (reuseport
+            && setsockopt(f.fdnum(), SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(int)) != 0) {
+            f.close(-errno);
+            return f;
+        }
+#else
+        if (reuseport) {
+            f.close(-ENOPROTOOPT);
+            return f;
+        }
+#endif
 
         struct sockaddr_in saddr;
         saddr.sin_family = AF_INET;
@@ -897,6 +1672,78 @@ fd tcp_listen(int port, int backlog)
     return f;
 }
 
+/** @brief  Open a TCP listening socket receiving connections to @a port.
+ *  @param  port     Listening port (in host byte order).
+ *  @param  backlog  Maximum connection backlog.
+ *  @return File descriptor.
+ *
+ *  The returned file descriptor is made nonblocking, and is opened with the
+ *  @c SO_REUSEADDR option. A negative value is returned on error. To check
+ *  whether the function succeeded, use valid() or error() on the resulting
+ *  file descriptor.
+ */
+fd tcp_listen(int port, int backlog)
+{
+    return tcp_listen(port, backlog, false);
+}
+
+/** @brief  Open one member of a @c SO_REUSEPORT listening group on @a port.
+ *  @param  port     Listening port (in host byte order).
+ *  @param  backlog  Maximum connection backlog.
+ *  @return File descriptor.
+ *
+ *  Like tcp_listen(), but also sets @c SO_REUSEPORT, so several sockets,
+ *  for instance one per thread or per driver, can listen on the same port.
+ *  The kernel spreads new connections across them. Returns -ENOPROTOOPT
+ *  if the platform lacks @c SO_REUSEPORT.
+ *
+ *  @sa tcp_listen_group
+ */
+fd tcp_listen_reuseport(int port, int backlog)
+{
+    return tcp_listen(port, backlog, true);
+}
+
+/** @brief  Open @a n @c SO_REUSEPORT listening sockets on @a port.
+ *  @param       port       Listening port (in host byte order).
+ *  @param       n          Number of sockets.
+ *  @param[out]  listeners  The sockets are appended here.
+ *  @param       backlog    Maximum connection backlog for each socket.
+ *  @return 0 on success, or a negative error code.
+ *
+ *  If @a port is 0, the kernel picks a port for the first socket and the
+ *  others join it. On error, no sockets are appended and any sockets
+ *  already opened are closed.
+ *
+ *  @sa tcp_listen_reuseport
+ */
+int tcp_listen_group(int port, int n, std::vector<fd>& listeners,
+                     int backlog)
+{
+    size_t first = listeners.size();
+    for (int i = 0; i < n; ++i) {
+        fd f = tcp_listen(port, backlog, true);
+        struct sockaddr_in saddr;
+        socklen_t saddr_len = sizeof(saddr);
+        // With port 0, the rest of the group joins the port the kernel
+        // picked for the first socket.
+        if (f && port == 0
+            && getsockname(f.fdnum(), (struct sockaddr*) &saddr, &saddr_len) == 0)
+            port = ntohs(saddr.sin_port);
+        else if (f && port == 0)
+            f.close(-errno);
+        if (!f) {
+            while (listeners.size() != first) {
+                listeners.back().close();
+                listeners.pop_back();
+            }
+            return f.error();
+        }
+        listeners.push_back(f);
+    }
+    return 0;
+}
+
 /** @brief  Create a nonblocking TCP connection to @a addr:@a port.
  *  @param  addr    Remote host.
  *  @param  port    Remote port (in host byte order).
@@ -1036,6 +1883,7 @@ pid_t exec(std::vector<exec_fd>& exec_fds, const char* program, bool path,
     if (child < 0)
         return kill_exec_fds(exec_fds, inner_fds, -errno);
     else if (child == 0) {
+        driver::sig_restore_mask();
         if (exec_fds.size() > 0) {
             // close parent's descriptors
             for (std::vector<exec_fd>::iterator it = exec_fds.begin();
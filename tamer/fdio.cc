@@ -0,0 +1,595 @@
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include "config.h"
+#include <tamer/tamer.hh>
+#include <tamer/fd.hh>
+#include "fdio.hh"
+#include "xuring.hh"
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#if TAMER_HAVE_XURING && HAVE_SYS_EVENTFD_H
+# include <sys/eventfd.h>
+# define TAMER_FILEIO_URING 1
+#endif
+namespace tamer {
+namespace tamerpriv {
+namespace {
+
+struct file_job {
+    enum op_type { op_open, op_fstat, op_read, op_write };
+    op_type op;
+    int fd;
+    int flags;
+    mode_t mode;
+    std::string data;           // file name, read buffer, or write data
+    size_t size;
+    size_t pos;
+    struct stat st;
+    int result;
+    void* out;
+    event<int> done;
+
+    inline file_job(op_type op, int fd, void* out, event<int>&& done)
+        : op(op), fd(fd), flags(0), mode(0), size(0), pos(0), result(0),
+          out(out), done(std::move(done)) {
+    }
+
+    virtual ~file_job() {
+    }
+    void run();
+    void complete();
+};
+
+// Blocking version, run on a worker thread.
+void file_job::run() {
+    ssize_t r;
+    switch (op) {
+    case op_open:
+        result = ::open(data.c_str(), flags, mode);
+        if (result == -1)
+            result = -errno;
+        break;
+    case op_fstat:
+        result = ::fstat(fd, &st) == -1 ? -errno : 0;
+        break;
+    case op_read:
+        data.resize(size);
+        while (pos != size) {
+            r = ::read(fd, &data[pos], size - pos);
+            if (r > 0)
+                pos += r;
+            else if (r == 0)
+                break;
+            else if (errno != EINTR) {
+                result = -errno;
+                break;
+            }
+        }
+        break;
+    case op_write:
+        while (pos != data.length()) {
+            r = ::write(fd, data.data() + pos, data.length() - pos);
+            if (r > 0)
+                pos += r;
+            else if (r == -1 && errno != EINTR) {
+                result = -errno;
+                break;
+            }
+        }
+        break;
+    }
+}
+
+// Deliver results on the issuing thread.
+void file_job::complete() {
+    if (!done) {
+        // nobody wants the file any more
+        if (op == op_open && result >= 0)
+            ::close(result);
+        return;
+    }
+    switch (op) {
+    case op_open:
+        break;
+    case op_fstat:
+        if (result == 0)
+            *static_cast<struct stat*>(out) = st;
+        break;
+    case op_read:
+        data.resize(pos);
+        static_cast<std::string*>(out)->swap(data);
+        break;
+    case op_write:
+        *static_cast<size_t*>(out) = pos;
+        break;
+    }
+    done.trigger(result);
+}
+
+
+// Thread pool backend. Workers share a queue; finished jobs return to the
+// issuing driver through driver::post(), whose eventfd wakes the loop.
+
+struct pool_job;
+
+struct pool_state {
+    std::mutex lock;
+    std::condition_variable cond;
+    std::deque<pool_job*> queue;
+    std::vector<pool_job*> orphans;
+    bool stopping;
+
+    // touched only by the issuing thread
+    unsigned nqueued;
+    unsigned queue_depth;
+    std::deque<pool_job*> waiting;
+
+    pool_state(unsigned queue_depth)
+        : stopping(false), nqueued(0), queue_depth(queue_depth) {
+    }
+    inline void push(pool_job* j);
+};
+
+struct pool_job : public file_job, public post_node {
+    std::shared_ptr<pool_state> pool;
+    driver* home;
+
+    inline pool_job(op_type op, int fd, void* out, event<int>&& done)
+        : file_job(op, fd, out, std::move(done)) {
+    }
+    ~pool_job() {
+        if (fd >= 0)
+            ::close(fd);
+    }
+    virtual void post_run() {
+        complete();
+        --pool->nqueued;
+        if (!pool->waiting.empty()) {
+            pool_job* j = pool->waiting.front();
+            pool->waiting.pop_front();
+            pool->push(j);
+        }
+    }
+};
+
+inline void pool_state::push(pool_job* j) {
+    ++nqueued;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        queue.push_back(j);
+    }
+    cond.notify_one();
+}
+
+class thread_file_io : public file_io {
+  public:
+    thread_file_io(unsigned nthreads, unsigned queue_depth);
+    ~thread_file_io();
+
+    virtual void open(std::string filename, int flags, mode_t mode,
+                      event<int> done);
+    virtual void fstat(int fd, struct stat& st, event<int> done);
+    virtual void read(int fd, size_t size, std::string& data,
+                      event<int> done);
+    virtual void write(int fd, std::string data, size_t& nwritten,
+                       event<int> done);
+
+  private:
+    std::shared_ptr<pool_state> pool_;
+    std::vector<std::thread> workers_;
+
+    pool_job* make_job(file_job::op_type op, int fd, void* out,
+                       event<int>& done);
+    void submit(pool_job* j);
+    static void work(std::shared_ptr<pool_state> pool);
+};
+
+thread_file_io::thread_file_io(unsigned nthreads, unsigned queue_depth)
+    : pool_(std::make_shared<pool_state>(queue_depth)) {
+    for (unsigned i = 0; i != nthreads; ++i)
+        workers_.push_back(std::thread(work, pool_));
+}
+
+thread_file_io::~thread_file_io() {
+    {
+        std::lock_guard<std::mutex> guard(pool_->lock);
+        pool_->stopping = true;
+    }
+    pool_->cond.notify_all();
+    for (auto& w : workers_)
+        w.join();
+    // Jobs that never ran, or finished after we stopped, are canceled
+    // here on the issuing thread. Jobs already posted stay with the
+    // driver, which owns them (and their share of pool_).
+    for (pool_job* j : pool_->queue)
+        delete j;
+    for (pool_job* j : pool_->orphans)
+        delete j;
+    for (pool_job* j : pool_->waiting)
+        delete j;
+    pool_->queue.clear();
+    pool_->orphans.clear();
+    pool_->waiting.clear();
+}
+
+void thread_file_io::work(std::shared_ptr<pool_state> pool) {
+    std::unique_lock<std::mutex> guard(pool->lock);
+    while (1) {
+        while (!pool->stopping && pool->queue.empty())
+            pool->cond.wait(guard);
+        if (pool->stopping)
+            break;
+        pool_job* j = pool->queue.front();
+        pool->queue.pop_front();
+        guard.unlock();
+        j->run();
+        guard.lock();
+        if (pool->stopping)
+            pool->orphans.push_back(j);
+        else {
+            guard.unlock();
+            j->home->post(j);
+            guard.lock();
+        }
+    }
+}
+
+pool_job* thread_file_io::make_job(file_job::op_type op, int fd, void* out,
+                                   event<int>& done) {
+    if (fd >= 0) {
+        // A worker may get to the job after fd::close() has freed the
+        // descriptor number for reuse, so it works on its own copy.
+        fd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (fd == -1) {
+            done.trigger(-errno);
+            return 0;
+        }
+    }
+    pool_job* j = new pool_job(op, fd, out, std::move(done));
+    j->pool = pool_;
+    j->home = driver::main;
+    return j;
+}
+
+void thread_file_io::submit(pool_job* j) {
+    if (pool_->nqueued < pool_->queue_depth)
+        pool_->push(j);
+    else
+        pool_->waiting.push_back(j);
+}
+
+void thread_file_io::open(std::string filename, int flags, mode_t mode,
+                          event<int> done) {
+    if (pool_job* j = make_job(file_job::op_open, -1, 0, done)) {
+        j->data = std::move(filename);
+        j->flags = flags;
+        j->mode = mode;
+        submit(j);
+    }
+}
+
+void thread_file_io::fstat(int fd, struct stat& st, event<int> done) {
+    if (pool_job* j = make_job(file_job::op_fstat, fd, &st, done))
+        submit(j);
+}
+
+void thread_file_io::read(int fd, size_t size, std::string& data,
+                          event<int> done) {
+    if (pool_job* j = make_job(file_job::op_read, fd, &data, done)) {
+        j->size = size;
+        submit(j);
+    }
+}
+
+void thread_file_io::write(int fd, std::string data, size_t& nwritten,
+                           event<int> done) {
+    if (pool_job* j = make_job(file_job::op_write, fd, &nwritten, done)) {
+        j->data = std::move(data);
+        submit(j);
+    }
+}
+
+
+#if TAMER_FILEIO_URING
+// io_uring backend. Requests go straight to the kernel, which reads into
+// the job's own buffer; the ring's registered eventfd tells the driver
+// when completions are ready. Nothing here needs another thread.
+
+class uring_file_io;
+
+// Calls a member function when its event fires. Unlike fun_event, it
+// outlives each event, and its destructor detaches anything still
+// pending, so the driver never calls into a destroyed backend. Hooks
+// also run when a driver discards its events on the way out.
+class uring_hook : public functional_rendezvous,
+                   public zero_argument_rendezvous_tag<uring_hook> {
+  public:
+    inline uring_hook(uring_file_io* io, void (uring_file_io::*f)())
+        : functional_rendezvous(hook), io_(io), f_(f) {
+    }
+  private:
+    uring_file_io* io_;
+    void (uring_file_io::*f_)();
+    static void hook(functional_rendezvous* fr, simple_event*,
+                     bool) TAMER_NOEXCEPT;
+};
+
+struct uring_job : public file_job {
+    inline uring_job(op_type op, int fd, void* out, event<int>&& done)
+        : file_job(op, fd, out, std::move(done)) {
+    }
+    ~uring_job() {
+        if (fd >= 0)
+            ::close(fd);
+    }
+};
+
+class uring_file_io : public file_io {
+  public:
+    uring_file_io();
+    ~uring_file_io();
+
+    bool setup(unsigned queue_depth);
+
+    virtual void open(std::string filename, int flags, mode_t mode,
+                      event<int> done);
+    virtual void fstat(int fd, struct stat& st, event<int> done);
+    virtual void read(int fd, size_t size, std::string& data,
+                      event<int> done);
+    virtual void write(int fd, std::string data, size_t& nwritten,
+                       event<int> done);
+
+  private:
+    xuring ring_;
+    int efd_;
+    unsigned ninflight_;
+    std::deque<file_job*> waiting_;
+    bool watching_;
+    bool dying_;
+    int ready_result_;
+    uring_hook ready_hook_;
+    uring_hook rewatch_hook_;
+
+    uring_job* make_job(file_job::op_type op, int fd, void* out,
+                        event<int>& done);
+    void submit(file_job* j);
+    void prep(file_job* j);
+    void reap();
+    void ready();
+    void watch();
+
+    friend class uring_hook;
+};
+
+void uring_hook::hook(functional_rendezvous* fr, simple_event*,
+                      bool) TAMER_NOEXCEPT {
+    uring_hook* h = static_cast<uring_hook*>(fr);
+    if (!h->io_->dying_)
+        (h->io_->*h->f_)();
+}
+
+uring_file_io::uring_file_io()
+    : efd_(-1), ninflight_(0), watching_(false), dying_(false),
+      ready_result_(0), ready_hook_(this, &uring_file_io::ready),
+      rewatch_hook_(this, &uring_file_io::watch) {
+}
+
+bool uring_file_io::setup(unsigned queue_depth) {
+    if (!ring_.setup(queue_depth))
+        return false;
+    efd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return efd_ >= 0 && ring_.register_eventfd(efd_) == 0;
+}
+
+uring_file_io::~uring_file_io() {
+    dying_ = true;
+    if (watching_ && driver::main)
+        driver::main->kill_fd(efd_);
+    // The kernel may still write into in-flight jobs' buffers, so wait
+    // for them before freeing anything.
+    while (ninflight_ && ring_.enter(1, 0) >= 0)
+        while (struct io_uring_cqe* cqe = ring_.peek_cqe()) {
+            delete reinterpret_cast<file_job*>(cqe->user_data);
+            ring_.advance_cqe();
+            --ninflight_;
+        }
+    for (file_job* j : waiting_)
+        delete j;
+    if (efd_ >= 0)
+        ::close(efd_);
+}
+
+uring_job* uring_file_io::make_job(file_job::op_type op, int fd, void* out,
+                                   event<int>& done) {
+    if (fd >= 0) {
+        // A job may wait in waiting_, or be resubmitted after a short
+        // transfer, after fd::close() has freed the descriptor number for
+        // reuse, so the ring works on its own copy.
+        fd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (fd == -1) {
+            done.trigger(-errno);
+            return 0;
+        }
+    }
+    return new uring_job(op, fd, out, std::move(done));
+}
+
+void uring_file_io::prep(file_job* j) {
+    struct io_uring_sqe* sqe = ring_.get_sqe();
+    assert(sqe);
+    if (j->op == file_job::op_open) {
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uintptr_t>(j->data.c_str());
+        sqe->len = j->mode;
+        sqe->open_flags = j->flags;
+    } else if (j->op == file_job::op_read) {
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = j->fd;
+        sqe->addr = reinterpret_cast<uintptr_t>(&j->data[j->pos]);
+        sqe->len = j->size - j->pos;
+        sqe->off = (__u64) -1;  // at the file position, like read(2)
+    } else {
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = j->fd;
+        sqe->addr = reinterpret_cast<uintptr_t>(j->data.data() + j->pos);
+        sqe->len = j->data.length() - j->pos;
+        sqe->off = (__u64) -1;
+    }
+    sqe->user_data = reinterpret_cast<uintptr_t>(j);
+}
+
+void uring_file_io::submit(file_job* j) {
+    if (ninflight_ == ring_.sq_entries()) {
+        waiting_.push_back(j);
+        return;
+    }
+    if (j->op == file_job::op_read)
+        j->data.resize(j->size);
+    prep(j);
+    ++ninflight_;
+    ring_.enter(0, 0);
+    watch();
+}
+
+void uring_file_io::watch() {
+    if (ninflight_ && !watching_) {
+        watching_ = true;
+        // left alone if the driver drops the event rather than firing it
+        ready_result_ = -ECANCELED;
+        tamer::at_fd_read(efd_, make_event(ready_hook_, ready_result_));
+    }
+}
+
+void uring_file_io::ready() {
+    watching_ = false;
+    if (ready_result_ != 0)
+        return;
+    reap();
+    // The driver is still triggering the old watch, so a new one must
+    // wait until it's done.
+    if (ninflight_)
+        tamer::at_asap(make_event(rewatch_hook_));
+}
+
+void uring_file_io::reap() {
+    uint64_t count;
+    while (::read(efd_, &count, sizeof(count)) > 0)
+        /* do nothing */;
+    tamer::read_would_block(efd_);
+
+    bool resubmitted = false;
+    while (struct io_uring_cqe* cqe = ring_.peek_cqe()) {
+        file_job* j = reinterpret_cast<file_job*>(cqe->user_data);
+        int res = cqe->res;
+        ring_.advance_cqe();
+
+        bool more = false;
+        if (res == -EINTR || res == -EAGAIN)
+            more = true;
+        else if (res < 0)
+            j->result = res;
+        else if (j->op == file_job::op_open)
+            j->result = res;
+        else if (res > 0) {
+            j->pos += res;
+            more = j->pos != (j->op == file_job::op_read ? j->size
+                              : j->data.length());
+        }
+
+        if (more) {
+            // short transfer: continue from where it stopped
+            prep(j);
+            resubmitted = true;
+        } else {
+            --ninflight_;
+            j->complete();
+            delete j;
+        }
+    }
+
+    while (!waiting_.empty() && ninflight_ != ring_.sq_entries()) {
+        file_job* j = waiting_.front();
+        waiting_.pop_front();
+        if (j->op == file_job::op_read)
+            j->data.resize(j->size);
+        prep(j);
+        ++ninflight_;
+        resubmitted = true;
+    }
+    if (resubmitted)
+        ring_.enter(0, 0);
+}
+
+void uring_file_io::open(std::string filename, int flags, mode_t mode,
+                         event<int> done) {
+    file_job* j = make_job(file_job::op_open, -1, 0, done);
+    j->data = std::move(filename);
+    j->flags = flags;
+    j->mode = mode;
+    submit(j);
+}
+
+void uring_file_io::fstat(int fd, struct stat& st, event<int> done) {
+    // The inode of an open file is already in memory, so this doesn't
+    // wait on the disk.
+    int r = ::fstat(fd, &st);
+    done.trigger(r == -1 ? -errno : 0);
+}
+
+void uring_file_io::read(int fd, size_t size, std::string& data,
+                         event<int> done) {
+    if (file_job* j = make_job(file_job::op_read, fd, &data, done)) {
+        j->size = size;
+        submit(j);
+    }
+}
+
+void uring_file_io::write(int fd, std::string data, size_t& nwritten,
+                          event<int> done) {
+    if (file_job* j = make_job(file_job::op_write, fd, &nwritten, done)) {
+        j->data = std::move(data);
+        submit(j);
+    }
+}
+#endif
+
+} // namespace
+
+file_io* file_io::make(int type, unsigned nthreads, unsigned queue_depth) {
+    if (!nthreads)
+        nthreads = default_nthreads;
+    if (!queue_depth)
+        queue_depth = default_queue_depth;
+#if TAMER_FILEIO_URING
+    if (type != fd::file_io_threads) {
+        uring_file_io* u = new uring_file_io;
+        if (u->setup(queue_depth))
+            return u;
+        delete u;
+    }
+#endif
+    if (type == fd::file_io_uring)
+        return 0;
+    return new thread_file_io(nthreads, queue_depth);
+}
+
+} // namespace tamerpriv
+} // namespace tamer
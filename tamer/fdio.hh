@@ -0,0 +1,58 @@
+#ifndef TAMER_FDIO_HH
+#define TAMER_FDIO_HH 1
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <tamer/event.hh>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <string>
+namespace tamer {
+namespace tamerpriv {
+
+// In-process offload for disk I/O that would block the driver: a pool of
+// worker threads, or an io_uring where the kernel supports one. Each
+// driver thread has its own.
+//
+// Completions arrive on the thread that issued the request. Out-parameters
+// are written only if @a done is still live at that point, so a canceled
+// caller's memory is never touched; the data itself moves through buffers
+// the request owns.
+class file_io {
+  public:
+    enum { default_nthreads = 4, default_queue_depth = 256 };
+
+    // Return a backend of type @a type (an fd::file_io_type), or null if
+    // that type isn't available. Zero arguments select the defaults.
+    static file_io* make(int type, unsigned nthreads, unsigned queue_depth);
+    // Destroy this thread's backend, canceling its operations. Called by
+    // tamer::cleanup() while the driver they report to still exists.
+    static void cleanup();
+
+    virtual ~file_io() {
+    }
+
+    // @a done receives a file descriptor or a negative error code.
+    virtual void open(std::string filename, int flags, mode_t mode,
+                      event<int> done) = 0;
+    virtual void fstat(int fd, struct stat& st, event<int> done) = 0;
+    // Read up to @a size bytes, stopping early only at end of file or on
+    // error. @a data receives what was read, even on error.
+    virtual void read(int fd, size_t size, std::string& data,
+                      event<int> done) = 0;
+    virtual void write(int fd, std::string data, size_t& nwritten,
+                       event<int> done) = 0;
+};
+
+} // namespace tamerpriv
+} // namespace tamer
+#endif /* TAMER_FDIO_HH */
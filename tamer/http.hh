@@ -6,11 +6,64 @@
 #include <string>
 #include <sstream>
 #include <memory>
+#include <atomic>
 #include <unordered_map>
 #include <time.h>
 namespace tamer {
 class http_parser;
 
+class http_view {
+  public:
+    inline http_view()
+        : s_(0), len_(0) {
+    }
+    inline http_view(const char* s, size_t len)
+        : s_(s), len_(len) {
+    }
+    inline http_view(const std::string& str)
+        : s_(str.data()), len_(str.length()) {
+    }
+    inline const char* data() const {
+        return s_;
+    }
+    inline size_t length() const {
+        return len_;
+    }
+    inline size_t size() const {
+        return len_;
+    }
+    inline bool empty() const {
+        return len_ == 0;
+    }
+    inline const char* begin() const {
+        return s_;
+    }
+    inline const char* end() const {
+        return s_ + len_;
+    }
+    inline std::string str() const {
+        return std::string(s_, len_);
+    }
+    inline bool equals(const char* s, size_t len) const {
+        return len_ == len && memcmp(s_, s, len) == 0;
+    }
+  private:
+    const char* s_;
+    size_t len_;
+};
+
+enum http_header_id {
+    hh_unknown = 0,
+    hh_accept, hh_accept_encoding, hh_accept_language, hh_authorization,
+    hh_cache_control, hh_connection, hh_content_encoding, hh_content_length,
+    hh_content_type, hh_cookie, hh_date, hh_expect, hh_host,
+    hh_if_modified_since, hh_if_none_match, hh_keep_alive, hh_location,
+    hh_origin, hh_referer, hh_sec_websocket_accept, hh_sec_websocket_key,
+    hh_sec_websocket_protocol, hh_sec_websocket_version, hh_set_cookie,
+    hh_transfer_encoding, hh_upgrade, hh_user_agent, hh_x_forwarded_for,
+    hh_nknown
+};
+
 struct http_header {
     std::string name;
     std::string value;
@@ -62,15 +115,23 @@ class http_message {
     inline const std::string& status_message() const;
     inline enum http_method method() const;
     inline const std::string& url() const;
+    inline http_view url_view() const;
+    inline bool has_canonical_header(http_header_id id) const;
     inline bool has_canonical_header(const char* name, size_t length) const;
     inline bool has_canonical_header(const char* name) const;
     inline bool has_canonical_header(const std::string& name) const;
+    inline header_iterator find_canonical_header(http_header_id id) const;
     header_iterator find_canonical_header(const char* name, size_t length) const;
     inline header_iterator find_canonical_header(const char* name) const;
     inline header_iterator find_canonical_header(const std::string& name) const;
+    std::string canonical_header(http_header_id id) const;
     std::string canonical_header(const char* name, size_t length) const;
     inline std::string canonical_header(const char* name) const;
     inline std::string canonical_header(const std::string& name) const;
+    inline http_view canonical_header_view(http_header_id id) const;
+    http_view canonical_header_view(const char* name, size_t length) const;
+    inline http_view canonical_header_view(const char* name) const;
+    inline http_view canonical_header_view(const std::string& name) const;
     inline bool has_header(const std::string& name) const;
     inline header_iterator find_header(const std::string& name) const;
     inline std::string header(const std::string& name) const;
@@ -92,6 +153,7 @@ class http_message {
     inline header_iterator query_end() const;
 
     inline http_message& clear();
+    inline http_message& detach();
     void add_header(std::string key, std::string value);
 
     inline http_message& http_major(unsigned v);
@@ -104,10 +166,13 @@ class http_message {
     inline http_message& header(std::string key, std::string value);
     inline http_message& header(std::string key, size_t value);
     inline http_message& date_header(std::string key, time_t value);
+    inline http_message& date_header(std::string key);
     inline http_message& body(std::string body);
     inline http_message& append_body(const std::string& x);
 
     static std::string canonicalize(std::string x);
+    static http_header_id header_id(const char* name, size_t length);
+    static std::string date_string(time_t value);
     static const char* default_status_message(unsigned code);
 
   private:
@@ -115,6 +180,34 @@ class http_message {
         info_url = 1, info_query = 2
     };
 
+    struct buffer_type {
+        char* s;
+        size_t capacity;
+        explicit inline buffer_type(size_t cap)
+            : s(new char[cap]), capacity(cap) {
+            allocated.fetch_add(cap, std::memory_order_relaxed);
+        }
+        inline ~buffer_type() {
+            allocated.fetch_sub(capacity, std::memory_order_relaxed);
+            delete[] s;
+        }
+        void grow(size_t keep, size_t cap);
+        static std::atomic<size_t> allocated;
+      private:
+        buffer_type(const buffer_type&) = delete;
+        buffer_type& operator=(const buffer_type&) = delete;
+    };
+
+    struct header_ref {
+        unsigned name_pos;
+        unsigned name_len;
+        unsigned value_pos;
+        unsigned value_len;
+        inline header_ref(unsigned pos, unsigned len)
+            : name_pos(pos), name_len(len), value_pos(0), value_len(0) {
+        }
+    };
+
     struct info_type {
         unsigned flags;
         struct http_parser_url urlp;
@@ -130,14 +223,38 @@ class http_message {
     unsigned method_ : 8;
     unsigned error_ : 7;
     unsigned upgrade_ : 1;
+    mutable bool url_ref_;
 
-    std::string url_;
+    mutable std::string url_;
     std::string status_message_;
-    std::vector<http_header> raw_headers_;
+    mutable std::vector<http_header> raw_headers_;
     std::string body_;
 
+    // Parsed messages refer to their parser's input buffer until someone
+    // asks for a std::string: url_ref_ means the URL is buf_[url_pos_,
+    // url_pos_ + url_len_), and header_refs_, if nonempty, holds the
+    // headers (and raw_headers_ is empty).
+    std::shared_ptr<buffer_type> buf_;
+    mutable std::vector<header_ref> header_refs_;
+    unsigned url_pos_;
+    unsigned url_len_;
+
+    // hslot_[id] is 1 + the index of the first header classified as id,
+    // or 0; bit id of hmulti_ is set if more than one header has that id.
+    unsigned hslot_[hh_nknown];
+    unsigned hmulti_;
+
     mutable std::shared_ptr<info_type> info_;
 
+    inline http_view buffer_view(unsigned pos, unsigned len) const;
+    inline size_t nheaders() const;
+    inline http_view header_name_view(size_t i) const;
+    inline http_view header_value_view(size_t i) const;
+    inline void note_header(size_t i, const char* name, size_t length);
+    size_t find_header_index(const char* name, size_t length) const;
+    std::string join_headers(size_t i, const char* name, size_t length) const;
+    void materialize_url() const;
+    void materialize_headers() const;
     inline void kill_info(unsigned f) const;
     inline info_type& info(unsigned f) const;
     void make_info(unsigned f) const;
@@ -147,6 +264,21 @@ class http_message {
     friend class http_parser;
 };
 
+class http_prebuilt_response {
+  public:
+    inline http_prebuilt_response();
+    explicit http_prebuilt_response(const http_message& m);
+
+    inline bool empty() const;
+    inline const char* data() const;
+    inline size_t length() const;
+    inline bool closes_connection() const;
+
+  private:
+    std::shared_ptr<const std::string> s_;
+    bool close_;
+};
+
 class http_parser : public tamed_class {
   public:
     http_parser(enum http_parser_type type);
@@ -157,11 +289,18 @@ class http_parser : public tamed_class {
     inline bool should_keep_alive() const;
 
     void receive(fd f, event<http_message> done);
+    void receive_many(fd f, std::vector<http_message>& ms, event<> done);
+    inline size_t buffered() const;
+    inline bool idle_mode() const;
+    inline void set_idle_mode(bool idle);
+    static size_t buffer_memory();
     void send(fd f, const http_message& m, event<> done);
+    void send(fd f, const http_prebuilt_response& r, event<> done);
     static void send_request(fd f, const http_message& m, event<> done);
     static void send_request(fd f, http_message&& m, event<> done);
     static void send_response(fd f, const http_message& m, event<> done);
     static void send_response(fd f, http_message&& m, event<> done);
+    static void send_response(fd f, http_prebuilt_response r, event<> done);
     static void send_response_headers(fd f, const http_message& m, event<> done);
     static void send_response_chunk(fd f, std::string s, event<> done);
     static void send_response_end(fd f, event<> done);
@@ -170,11 +309,24 @@ class http_parser : public tamed_class {
 
   private:
     ::http_parser hp_;
+    std::shared_ptr<http_message::buffer_type> buf_;
+    std::shared_ptr<http_message::buffer_type> spare_buf_;
+    size_t pos_;
+    size_t len_;
+    bool idle_;
+
+    enum { initial_capacity = 8192, max_body_capacity = 32768 };
+    enum { max_pooled_buffers = 256 };
+    static TAMER_THREAD_LOCAL std::vector<std::shared_ptr<http_message::buffer_type> > buffer_pool;
+    enum { last_none = 0, last_field = 1, last_value = 2 };
 
     struct message_data {
         http_message hm;
-        std::string key;
-        std::ostringstream sbuf;
+        http_parser* parser;
+        const char* base;
+        size_t hold;
+        int last;
+        bool copying;
         bool done;
     };
 
@@ -184,32 +336,77 @@ class http_parser : public tamed_class {
     static int on_message_begin(::http_parser* hp);
     static int on_url(::http_parser* hp, const char* s, size_t len);
     static int on_status(::http_parser* hp, const char* s, size_t len);
+    static inline void finish_header_name(message_data* md);
     static int on_header_field(::http_parser* hp, const char* s, size_t len);
     static int on_header_value(::http_parser* hp, const char* s, size_t len);
     static int on_headers_complete(::http_parser* hp);
     static int on_body(::http_parser* hp, const char* s, size_t len);
     static int on_message_complete(::http_parser* hp);
     inline void copy_parser_status(message_data& md);
-    static void unparse_request_headers(std::ostringstream& buf,
+    void prepare_buffer();
+    void release_buffers();
+    inline bool parse_buffered(message_data& md);
+    bool receive_buffered(http_message& m);
+    static size_t unparse_size(const http_message& m);
+    static void unparse_request_headers(std::string& buf,
                                         const http_message& m);
-    static void unparse_response_headers(std::ostringstream& buf,
+    static void unparse_response_headers(std::string& buf,
                                          const http_message& m,
                                          bool include_content_length);
     static inline std::string prepare_headers(const http_message& m,
-                                              std::string& body,
-                                              bool is_response);
+                                              bool is_response,
+                                              bool& merged);
     static inline void send_message(fd f, std::string headers,
                                     std::string body, event<> done);
     static void send_two(fd f, std::string a, std::string b, event<> done);
 
     class closure__receive__2fdQ12http_message_; void receive(closure__receive__2fdQ12http_message_&);
+    class closure__receive_many__2fdRNSt6vectorI12http_messageEEQ_; void receive_many(closure__receive_many__2fdRNSt6vectorI12http_messageEEQ_&);
     class closure__send_response_chunk__2fdSsQ_; static void send_response_chunk(closure__send_response_chunk__2fdSsQ_&);
     class closure__send_two__2fdSsSsQ_; static void send_two(closure__send_two__2fdSsSsQ_&);
+    class closure__send_response__2fd22http_prebuilt_responseQ_; static void send_response(closure__send_response__2fd22http_prebuilt_responseQ_&);
+
+    friend class http_prebuilt_response;
 };
 
 inline http_message::http_message()
     : major_(1), minor_(1), status_code_(200), method_(HTTP_GET),
-      error_(HPE_OK), upgrade_(0) {
+      error_(HPE_OK), upgrade_(0), url_ref_(false), hmulti_(0) {
+    memset(hslot_, 0, sizeof(hslot_));
+}
+
+inline http_view http_message::buffer_view(unsigned pos, unsigned len) const {
+    return http_view(buf_->s + pos, len);
+}
+
+inline size_t http_message::nheaders() const {
+    if (header_refs_.empty())
+        return raw_headers_.size();
+    else
+        return header_refs_.size();
+}
+
+inline http_view http_message::header_name_view(size_t i) const {
+    if (header_refs_.empty())
+        return http_view(raw_headers_[i].name);
+    else
+        return buffer_view(header_refs_[i].name_pos, header_refs_[i].name_len);
+}
+
+inline http_view http_message::header_value_view(size_t i) const {
+    if (header_refs_.empty())
+        return http_view(raw_headers_[i].value);
+    else
+        return buffer_view(header_refs_[i].value_pos, header_refs_[i].value_len);
+}
+
+inline void http_message::note_header(size_t i, const char* name, size_t length) {
+    if (http_header_id id = header_id(name, length)) {
+        if (!hslot_[id])
+            hslot_[id] = i + 1;
+        else
+            hmulti_ |= 1U << id;
+    }
 }
 
 inline void http_message::kill_info(unsigned f) const {
@@ -250,19 +447,39 @@ inline enum http_method http_message::method() const {
 }
 
 inline const std::string& http_message::url() const {
+    if (url_ref_)
+        materialize_url();
     return url_;
 }
 
+inline http_view http_message::url_view() const {
+    if (url_ref_)
+        return buffer_view(url_pos_, url_len_);
+    else
+        return http_view(url_);
+}
+
+inline bool http_message::has_canonical_header(http_header_id id) const {
+    return hslot_[id] != 0;
+}
+
 inline bool http_message::has_canonical_header(const char* name, size_t length) const {
-    return find_canonical_header(name, length) != header_end();
+    return find_header_index(name, length) != (size_t) -1;
 }
 
 inline bool http_message::has_canonical_header(const char* name) const {
-    return find_canonical_header(name) != header_end();
+    return has_canonical_header(name, strlen(name));
 }
 
 inline bool http_message::has_canonical_header(const std::string& name) const {
-    return find_canonical_header(name) != header_end();
+    return has_canonical_header(name.data(), name.length());
+}
+
+inline http_message::header_iterator http_message::find_canonical_header(http_header_id id) const {
+    if (hslot_[id])
+        return header_begin() + (hslot_[id] - 1);
+    else
+        return header_end();
 }
 
 inline http_message::header_iterator http_message::find_canonical_header(const char* name) const {
@@ -281,6 +498,21 @@ inline std::string http_message::canonical_header(const std::string& name) const
     return canonical_header(name.data(), name.length());
 }
 
+inline http_view http_message::canonical_header_view(http_header_id id) const {
+    if (hslot_[id])
+        return header_value_view(hslot_[id] - 1);
+    else
+        return http_view();
+}
+
+inline http_view http_message::canonical_header_view(const char* name) const {
+    return canonical_header_view(name, strlen(name));
+}
+
+inline http_view http_message::canonical_header_view(const std::string& name) const {
+    return canonical_header_view(name.data(), name.length());
+}
+
 inline bool http_message::has_header(const std::string& name) const {
     return has_canonical_header(canonicalize(name));
 }
@@ -304,7 +536,7 @@ inline bool http_message::has_url_field(int field) const {
 inline std::string http_message::url_field(int field) const {
     const info_type& i = info(info_url);
     if (i.urlp.field_set & (1 << field))
-        return url_.substr(i.urlp.field_data[field].off,
+        return std::string(url_view().data() + i.urlp.field_data[field].off,
                            i.urlp.field_data[field].len);
     else
         return std::string();
@@ -345,6 +577,15 @@ inline http_message& http_message::clear() {
     return *this;
 }
 
+inline http_message& http_message::detach() {
+    if (url_ref_)
+        materialize_url();
+    if (!header_refs_.empty())
+        materialize_headers();
+    buf_.reset();
+    return *this;
+}
+
 inline http_message& http_message::error(enum http_errno e) {
     error_ = e;
     return *this;
@@ -369,6 +610,7 @@ inline http_message& http_message::method(enum http_method method) {
 
 inline http_message& http_message::url(std::string url) {
     url_ = TAMER_MOVE(url);
+    url_ref_ = false;
     kill_info(info_url | info_query);
     return *this;
 }
@@ -379,20 +621,20 @@ inline http_message& http_message::header(std::string key, std::string value) {
 }
 
 inline http_message& http_message::header(std::string key, size_t value) {
-    std::ostringstream buf;
-    buf << value;
-    add_header(TAMER_MOVE(key), buf.str());
+    add_header(TAMER_MOVE(key), std::to_string(value));
     return *this;
 }
 
 inline http_message& http_message::date_header(std::string key, time_t value) {
-    char buf[128];
-    // XXX current locale
-    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", gmtime(&value));
-    add_header(TAMER_MOVE(key), std::string(buf));
+    add_header(TAMER_MOVE(key), date_string(value));
     return *this;
 }
 
+/** @brief Add a header with the current date, from tamer::recent(). */
+inline http_message& http_message::date_header(std::string key) {
+    return date_header(TAMER_MOVE(key), recent().tv_sec);
+}
+
 inline http_message& http_message::body(std::string body) {
     body_ = TAMER_MOVE(body);
     return *this;
@@ -410,10 +652,14 @@ inline http_message::info_type& http_message::info(unsigned f) const {
 }
 
 inline http_message::header_iterator http_message::header_begin() const {
+    if (!header_refs_.empty())
+        materialize_headers();
     return raw_headers_.begin();
 }
 
 inline http_message::header_iterator http_message::header_end() const {
+    if (!header_refs_.empty())
+        materialize_headers();
     return raw_headers_.end();
 }
 
@@ -437,16 +683,60 @@ inline bool http_parser::should_keep_alive() const {
     return http_should_keep_alive(&hp_);
 }
 
+/** @brief Return the number of received bytes not yet parsed.
+
+    These bytes belong to messages pipelined after the last one returned.
+    The next receive() parses them before reading from its fd. */
+inline size_t http_parser::buffered() const {
+    return len_ - pos_;
+}
+
+/** @brief Test whether this parser releases its buffers while idle. */
+inline bool http_parser::idle_mode() const {
+    return idle_;
+}
+
+/** @brief Set whether this parser releases its buffers while idle.
+
+    Normally a parser keeps its read buffers, at least 8KB each, between
+    messages. In idle mode, a receive() that must wait for the first byte
+    of a message returns those buffers to a small per-thread pool first,
+    and takes one back when data arrives. A server holding many mostly
+    idle keep-alive connections should turn this on. */
+inline void http_parser::set_idle_mode(bool idle) {
+    idle_ = idle;
+}
+
 inline void http_parser::clear_should_keep_alive() {
     hp_.flags = (hp_.flags & ~F_CONNECTION_KEEP_ALIVE) | F_CONNECTION_CLOSE;
 }
 
+inline http_prebuilt_response::http_prebuilt_response()
+    : close_(false) {
+}
+
+inline bool http_prebuilt_response::empty() const {
+    return !s_;
+}
+
+inline const char* http_prebuilt_response::data() const {
+    return s_ ? s_->data() : 0;
+}
+
+inline size_t http_prebuilt_response::length() const {
+    return s_ ? s_->length() : 0;
+}
+
+inline bool http_prebuilt_response::closes_connection() const {
+    return close_;
+}
+
 inline void http_parser::send_message(fd f, std::string headers,
                                       std::string body, event<> done) {
     if (body.empty())
-        f.write(headers, done);
+        f.write(TAMER_MOVE(headers), (size_t*) 0, rebind<int>(done));
     else
-        send_two(f, headers, body, done);
+        send_two(f, TAMER_MOVE(headers), TAMER_MOVE(body), done);
 }
 
 } // namespace tamer
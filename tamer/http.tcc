@@ -93,6 +93,47 @@ struct status_code_map_comparator {
         return a.code < b;
     }
 };
+
+inline void append(std::string& buf, const char* s) {
+    buf.append(s, strlen(s));
+}
+
+inline void append(std::string& buf, tamer::http_view v) {
+    buf.append(v.data(), v.length());
+}
+
+inline void append_header(std::string& buf, tamer::http_view name,
+                          tamer::http_view value) {
+    append(buf, name);
+    buf.append(": ", 2);
+    append(buf, value);
+    buf.append("\r\n", 2);
+}
+
+void append_decimal(std::string& buf, unsigned long long x) {
+    char tmp[24];
+    char* p = tmp + sizeof(tmp);
+    do {
+        *--p = '0' + x % 10;
+        x /= 10;
+    } while (x);
+    buf.append(p, tmp + sizeof(tmp) - p);
+}
+
+void append_hex(std::string& buf, unsigned long long x) {
+    char tmp[24];
+    char* p = tmp + sizeof(tmp);
+    do {
+        *--p = "0123456789ABCDEF"[x & 15];
+        x >>= 4;
+    } while (x);
+    buf.append(p, tmp + sizeof(tmp) - p);
+}
+
+bool is_close_token(tamer::http_view v) {
+    return v.length() == 5
+        && tamer::http_header::equals_canonical(v.data(), "close", 5);
+}
 }
 
 namespace tamer {
@@ -131,43 +172,228 @@ const char* http_message::default_status_message(unsigned code) {
         return "unknown";
 }
 
-http_message::header_iterator http_message::find_canonical_header(const char* name, size_t length) const {
-    header_iterator it = raw_headers_.begin();
-    while (it != raw_headers_.end() && !it->is_canonical(name, length))
-        ++it;
-    return it;
+/** @brief Return @a value formatted as an HTTP date.
+
+    For example, "Sun, 06 Nov 1994 08:49:37 GMT". The formatted string
+    is cached per thread, so formatting the same second again, as a
+    server does for every response, is cheap. */
+std::string http_message::date_string(time_t value) {
+    static TAMER_THREAD_LOCAL time_t cached_value = -1;
+    static TAMER_THREAD_LOCAL char cached[29];
+    if (value != cached_value) {
+        struct tm tm;
+        gmtime_r(&value, &tm);
+        const char* day = "SunMonTueWedThuFriSat" + 3 * tm.tm_wday;
+        const char* month = "JanFebMarAprMayJunJulAugSepOctNovDec" + 3 * tm.tm_mon;
+        unsigned year = tm.tm_year + 1900;
+        char* p = cached;
+        memcpy(p, day, 3);
+        p[3] = ',';
+        p[4] = ' ';
+        p[5] = '0' + tm.tm_mday / 10;
+        p[6] = '0' + tm.tm_mday % 10;
+        p[7] = ' ';
+        memcpy(p + 8, month, 3);
+        p[11] = ' ';
+        p[12] = '0' + (year / 1000) % 10;
+        p[13] = '0' + (year / 100) % 10;
+        p[14] = '0' + (year / 10) % 10;
+        p[15] = '0' + year % 10;
+        p[16] = ' ';
+        p[17] = '0' + tm.tm_hour / 10;
+        p[18] = '0' + tm.tm_hour % 10;
+        p[19] = ':';
+        p[20] = '0' + tm.tm_min / 10;
+        p[21] = '0' + tm.tm_min % 10;
+        p[22] = ':';
+        p[23] = '0' + tm.tm_sec / 10;
+        p[24] = '0' + tm.tm_sec % 10;
+        memcpy(p + 25, " GMT", 4);
+        cached_value = value;
+    }
+    return std::string(cached, sizeof(cached));
 }
 
-std::string http_message::canonical_header(const char* name, size_t length) const {
-    std::string result;
-    bool any = false;
-    for (header_iterator it = raw_headers_.begin(); it != raw_headers_.end(); ++it)
-        if (it->is_canonical(name, length)) {
-            if (any) {
-                result += ", ";
-                result += it->value;
-            } else {
-                result = it->value;
-                any = true;
-            }
+std::atomic<size_t> http_message::buffer_type::allocated;
+
+void http_message::buffer_type::grow(size_t keep, size_t cap) {
+    char* ns = new char[cap];
+    memcpy(ns, s, keep);
+    delete[] s;
+    s = ns;
+    allocated.fetch_add(cap - capacity, std::memory_order_relaxed);
+    capacity = cap;
+}
+
+void http_message::materialize_url() const {
+    url_.assign(buf_->s + url_pos_, url_len_);
+    url_ref_ = false;
+}
+
+void http_message::materialize_headers() const {
+    raw_headers_.reserve(raw_headers_.size() + header_refs_.size());
+    for (auto it = header_refs_.begin(); it != header_refs_.end(); ++it)
+        raw_headers_.push_back(http_header(std::string(buf_->s + it->name_pos, it->name_len),
+                                           std::string(buf_->s + it->value_pos, it->value_len)));
+    header_refs_.clear();
+}
+
+http_header_id http_message::header_id(const char* name, size_t length) {
+    static const char* const names[] = {
+        0, "accept", "accept-encoding", "accept-language", "authorization",
+        "cache-control", "connection", "content-encoding", "content-length",
+        "content-type", "cookie", "date", "expect", "host",
+        "if-modified-since", "if-none-match", "keep-alive", "location",
+        "origin", "referer", "sec-websocket-accept", "sec-websocket-key",
+        "sec-websocket-protocol", "sec-websocket-version", "set-cookie",
+        "transfer-encoding", "upgrade", "user-agent", "x-forwarded-for"
+    };
+    // Pick the only candidate by length and first letter, then compare.
+    int c = length ? (unsigned char) name[0] | 0x20 : 0;
+    http_header_id id = hh_unknown;
+    switch (length) {
+    case 4:
+        id = c == 'd' ? hh_date : c == 'h' ? hh_host : hh_unknown;
+        break;
+    case 6:
+        id = c == 'a' ? hh_accept : c == 'c' ? hh_cookie
+            : c == 'e' ? hh_expect : c == 'o' ? hh_origin : hh_unknown;
+        break;
+    case 7:
+        id = c == 'r' ? hh_referer : c == 'u' ? hh_upgrade : hh_unknown;
+        break;
+    case 8:
+        id = c == 'l' ? hh_location : hh_unknown;
+        break;
+    case 10:
+        id = c == 'c' ? hh_connection : c == 'k' ? hh_keep_alive
+            : c == 's' ? hh_set_cookie : c == 'u' ? hh_user_agent : hh_unknown;
+        break;
+    case 12:
+        id = c == 'c' ? hh_content_type : hh_unknown;
+        break;
+    case 13:
+        id = c == 'a' ? hh_authorization : c == 'c' ? hh_cache_control
+            : c == 'i' ? hh_if_none_match : hh_unknown;
+        break;
+    case 14:
+        id = c == 'c' ? hh_content_length : hh_unknown;
+        break;
+    case 15:
+        if (c == 'a')
+            id = ((unsigned char) name[7] | 0x20) == 'e'
+                ? hh_accept_encoding : hh_accept_language;
+        else if (c == 'x')
+            id = hh_x_forwarded_for;
+        break;
+    case 16:
+        id = c == 'c' ? hh_content_encoding : hh_unknown;
+        break;
+    case 17:
+        id = c == 'i' ? hh_if_modified_since : c == 's' ? hh_sec_websocket_key
+            : c == 't' ? hh_transfer_encoding : hh_unknown;
+        break;
+    case 20:
+        id = c == 's' ? hh_sec_websocket_accept : hh_unknown;
+        break;
+    case 21:
+        id = c == 's' ? hh_sec_websocket_version : hh_unknown;
+        break;
+    case 22:
+        id = c == 's' ? hh_sec_websocket_protocol : hh_unknown;
+        break;
+    }
+    if (id && http_header::equals_canonical(name, names[id], length))
+        return id;
+    else
+        return hh_unknown;
+}
+
+size_t http_message::find_header_index(const char* name, size_t length) const {
+    if (http_header_id id = header_id(name, length))
+        return (size_t) hslot_[id] - 1;
+    for (size_t i = 0, n = nheaders(); i != n; ++i) {
+        http_view hname = header_name_view(i);
+        if (hname.length() == length
+            && http_header::equals_canonical(hname.data(), name, length))
+            return i;
+    }
+    return (size_t) -1;
+}
+
+std::string http_message::join_headers(size_t i, const char* name, size_t length) const {
+    std::string result = header_value_view(i).str();
+    for (size_t n = nheaders(), j = i + 1; j != n; ++j) {
+        http_view hname = header_name_view(j);
+        if (hname.length() == length
+            && http_header::equals_canonical(hname.data(), name, length)) {
+            http_view value = header_value_view(j);
+            result += ", ";
+            result.append(value.data(), value.length());
         }
+    }
     return result;
 }
 
+http_view http_message::canonical_header_view(const char* name, size_t length) const {
+    size_t i = find_header_index(name, length);
+    if (i != (size_t) -1)
+        return header_value_view(i);
+    else
+        return http_view();
+}
+
+http_message::header_iterator http_message::find_canonical_header(const char* name, size_t length) const {
+    size_t i = find_header_index(name, length);
+    if (i != (size_t) -1)
+        return header_begin() + i;
+    else
+        return header_end();
+}
+
+std::string http_message::canonical_header(http_header_id id) const {
+    if (!hslot_[id])
+        return std::string();
+    else if (!(hmulti_ & (1U << id)))
+        return header_value_view(hslot_[id] - 1).str();
+    else {
+        http_view name = header_name_view(hslot_[id] - 1);
+        return join_headers(hslot_[id] - 1, canonicalize(name.str()).data(),
+                            name.length());
+    }
+}
+
+std::string http_message::canonical_header(const char* name, size_t length) const {
+    size_t i = find_header_index(name, length);
+    if (i == (size_t) -1)
+        return std::string();
+    else
+        return join_headers(i, name, length);
+}
+
 void http_message::do_clear() {
     major_ = minor_ = 1;
     status_code_ = 200;
     method_ = HTTP_GET;
     error_ = HPE_OK;
     upgrade_ = 0;
+    url_ref_ = false;
     url_ = status_message_ = body_ = std::string();
     raw_headers_.clear();
+    header_refs_.clear();
+    buf_.reset();
+    memset(hslot_, 0, sizeof(hslot_));
+    hmulti_ = 0;
     if (info_)
         info_->flags = 0;
 }
 
 void http_message::add_header(std::string key, std::string value) {
+    if (!header_refs_.empty())
+        materialize_headers();
     raw_headers_.push_back(http_header(TAMER_MOVE(key), TAMER_MOVE(value)));
+    const std::string& name = raw_headers_.back().name;
+    note_header(raw_headers_.size() - 1, name.data(), name.length());
 }
 
 inline int xvalue(unsigned char ch) {
@@ -185,7 +411,8 @@ void http_message::make_info(unsigned f) const {
     info_type& i = *info_;
 
     if (!(i.flags & info_url) && (f & (info_url | info_query))) {
-        int r = http_parser_parse_url(url_.data(), url_.length(), method_ == HTTP_CONNECT, &i.urlp);
+        http_view url = url_view();
+        int r = http_parser_parse_url(url.data(), url.length(), method_ == HTTP_CONNECT, &i.urlp);
         if (r)
             i.urlp.field_set = 0;
         i.flags |= info_url;
@@ -194,7 +421,7 @@ void http_message::make_info(unsigned f) const {
     if (!(i.flags & info_query) && (f & info_query)) {
         i.raw_query.clear();
         if (i.urlp.field_set & (1 << UF_QUERY)) {
-            const char* s = url_.data() + i.urlp.field_data[UF_QUERY].off;
+            const char* s = url_view().data() + i.urlp.field_data[UF_QUERY].off;
             const char* ends = s + i.urlp.field_data[UF_QUERY].len;
             int state = 0;
             const char* last = s;
@@ -250,24 +477,22 @@ void http_message::make_info(unsigned f) const {
 std::string http_message::host() const {
     info_type& i = info(info_url);
     if (i.urlp.field_set & (1 << UF_HOST))
-        return url_.substr(i.urlp.field_data[UF_HOST].off,
+        return std::string(url_view().data() + i.urlp.field_data[UF_HOST].off,
                            i.urlp.field_data[UF_HOST].len);
-    for (auto it = raw_headers_.begin(); it != raw_headers_.end(); ++it)
-        if (it->is_canonical("host", 4))
-            return it->value;
-    return std::string();
+    return canonical_header_view(hh_host).str();
 }
 
 std::string http_message::url_host_port() const {
     info_type& i = info(info_url);
+    http_view url = url_view();
     std::string host;
     if (i.urlp.field_set & (1 << UF_HOST))
-        host = url_.substr(i.urlp.field_data[UF_HOST].off,
-                           i.urlp.field_data[UF_HOST].len);
+        host.assign(url.data() + i.urlp.field_data[UF_HOST].off,
+                    i.urlp.field_data[UF_HOST].len);
     if ((i.urlp.field_set & (1 << UF_PORT)) && !host.empty()) {
         host += ":";
-        host += url_.substr(i.urlp.field_data[UF_PORT].off,
-                            i.urlp.field_data[UF_PORT].len);
+        host.append(url.data() + i.urlp.field_data[UF_PORT].off,
+                    i.urlp.field_data[UF_PORT].len);
     }
     return host;
 }
@@ -289,12 +514,24 @@ std::string http_message::query(const std::string& name) const {
 }
 
 
-http_parser::http_parser(enum http_parser_type hp_type) {
+http_parser::http_parser(enum http_parser_type hp_type)
+    : pos_(0), len_(0), idle_(false) {
     http_parser_init(&hp_, hp_type);
 }
 
+TAMER_THREAD_LOCAL std::vector<std::shared_ptr<http_message::buffer_type> > http_parser::buffer_pool;
+
+/** @brief Return the bytes of message buffer memory allocated.
+
+    Counts every parser's read buffers, including buffers still referenced
+    by received messages and buffers waiting in the idle-mode pool. */
+size_t http_parser::buffer_memory() {
+    return http_message::buffer_type::allocated.load(std::memory_order_relaxed);
+}
+
 void http_parser::clear() {
     http_parser_init(&hp_, (enum http_parser_type) hp_.type);
+    pos_ = len_ = 0;
 }
 
 inline void http_parser::copy_parser_status(message_data& md) {
@@ -306,25 +543,39 @@ inline void http_parser::copy_parser_status(message_data& md) {
     md.hm.upgrade_ = hp_.upgrade;
 }
 
-inline http_parser* http_parser::get_parser(::http_parser* hp) {
-    return reinterpret_cast<http_parser*>(hp);
-}
-
 inline http_parser::message_data* http_parser::get_message_data(::http_parser* hp) {
     return static_cast<message_data*>(hp->data);
 }
 
+inline http_parser* http_parser::get_parser(::http_parser* hp) {
+    return get_message_data(hp)->parser;
+}
+
 int http_parser::on_message_begin(::http_parser* hp) {
     message_data* md = get_message_data(hp);
     md->hm.clear();
-    md->key.clear();
-    md->sbuf.clear();
+    md->hm.buf_ = get_parser(hp)->buf_;
+    md->hold = (size_t) -1;
+    md->last = last_none;
+    md->copying = false;
     return 0;
 }
 
 int http_parser::on_url(::http_parser* hp, const char* s, size_t len) {
     message_data* md = get_message_data(hp);
-    md->hm.url_.append(s, len);
+    http_message& hm = md->hm;
+    unsigned pos = s - md->base;
+    if (hm.url_ref_ && hm.url_pos_ + hm.url_len_ == pos)
+        hm.url_len_ += len;
+    else if (!hm.url_ref_ && hm.url_.empty()) {
+        hm.url_pos_ = pos;
+        hm.url_len_ = len;
+        hm.url_ref_ = true;
+    } else {
+        if (hm.url_ref_)
+            hm.materialize_url();
+        hm.url_.append(s, len);
+    }
     return 0;
 }
 
@@ -336,77 +587,220 @@ int http_parser::on_status(::http_parser* hp, const char* s, size_t len) {
     return 0;
 }
 
+inline void http_parser::finish_header_name(message_data* md) {
+    http_message& hm = md->hm;
+    if (!hm.header_refs_.empty()) {
+        const http_message::header_ref& h = hm.header_refs_.back();
+        hm.note_header(hm.header_refs_.size() - 1, md->base + h.name_pos, h.name_len);
+    } else if (!hm.raw_headers_.empty()) {
+        const std::string& name = hm.raw_headers_.back().name;
+        hm.note_header(hm.raw_headers_.size() - 1, name.data(), name.length());
+    }
+}
+
 int http_parser::on_header_field(::http_parser* hp, const char* s, size_t len) {
     message_data* md = get_message_data(hp);
-    if (!md->key.empty()) {
-        md->hm.add_header(TAMER_MOVE(md->key), md->sbuf.str());
-        md->key = std::string();
-        md->sbuf.str(std::string());
+    http_message& hm = md->hm;
+    bool start = md->last != last_field;
+    md->last = last_field;
+    // Trailers may land in buffer space that gets reused, so copy them.
+    if (!md->copying && md->hold == (size_t) -1) {
+        unsigned pos = s - md->base;
+        if (start) {
+            hm.header_refs_.push_back(http_message::header_ref(pos, len));
+            return 0;
+        }
+        http_message::header_ref& h = hm.header_refs_.back();
+        if (h.name_pos + h.name_len == pos) {
+            h.name_len += len;
+            return 0;
+        }
+    }
+    if (!md->copying) {
+        hm.materialize_headers();
+        md->copying = true;
     }
-    md->sbuf.write(s, len);
+    if (start)
+        hm.raw_headers_.push_back(http_header(std::string(s, len), std::string()));
+    else
+        hm.raw_headers_.back().name.append(s, len);
     return 0;
 }
 
 int http_parser::on_header_value(::http_parser* hp, const char* s, size_t len) {
     message_data* md = get_message_data(hp);
-    if (md->key.empty()) {
-        md->key = md->sbuf.str();
-        md->sbuf.str(std::string());
+    http_message& hm = md->hm;
+    bool start = md->last != last_value;
+    md->last = last_value;
+    if (start)
+        finish_header_name(md);
+    if (!md->copying && md->hold == (size_t) -1) {
+        unsigned pos = s - md->base;
+        http_message::header_ref& h = hm.header_refs_.back();
+        if (start) {
+            h.value_pos = pos;
+            h.value_len = len;
+            return 0;
+        } else if (h.value_pos + h.value_len == pos) {
+            h.value_len += len;
+            return 0;
+        }
+    }
+    if (!md->copying) {
+        hm.materialize_headers();
+        md->copying = true;
     }
-    md->sbuf.write(s, len);
+    hm.raw_headers_.back().value.append(s, len);
     return 0;
 }
 
 int http_parser::on_headers_complete(::http_parser* hp) {
     message_data* md = get_message_data(hp);
-    if (!md->key.empty()) {
-        md->hm.add_header(TAMER_MOVE(md->key), md->sbuf.str());
-        md->key = md->sbuf.str();
-        md->sbuf.str(std::string());
+    http_message& hm = md->hm;
+    if (md->last == last_field)
+        finish_header_name(md);
+    // Body bytes are copied out, so receive() may reuse buffer space
+    // past the last byte a reference points to.
+    md->hold = 0;
+    if (hm.url_ref_)
+        md->hold = hm.url_pos_ + hm.url_len_;
+    if (!hm.header_refs_.empty()) {
+        const http_message::header_ref& h = hm.header_refs_.back();
+        md->hold = std::max(md->hold, (size_t) std::max(h.name_pos + h.name_len,
+                                                        h.value_pos + h.value_len));
     }
+    if (hp->content_length > 0 && hp->content_length <= (1U << 20))
+        hm.body_.reserve(hp->content_length);
     get_parser(hp)->copy_parser_status(*md);
     return 0;
 }
 
 int http_parser::on_body(::http_parser* hp, const char* s, size_t len) {
     message_data* md = get_message_data(hp);
-    md->sbuf.write(s, len);
+    md->hm.body_.append(s, len);
     return 0;
 }
 
 int http_parser::on_message_complete(::http_parser* hp) {
     message_data* md = get_message_data(hp);
-    md->hm.body_ = md->sbuf.str();
     md->done = true;
+    // Stop here; any following bytes belong to the next message.
+    http_parser_pause(hp, 1);
     return 0;
 }
 
+void http_parser::prepare_buffer() {
+    // A message from an earlier receive() may still refer to buf_.
+    // Alternate between two buffers so that the usual receive, handle,
+    // receive loop allocates nothing and leaves that message intact.
+    // Unparsed bytes move to the front of the buffer either way.
+    size_t n = len_ - pos_;
+    if (!buf_ || !buf_.unique()) {
+        buf_.swap(spare_buf_);
+        if ((!buf_ || !buf_.unique()) && !buffer_pool.empty()) {
+            buf_ = TAMER_MOVE(buffer_pool.back());
+            buffer_pool.pop_back();
+        }
+        if (!buf_ || !buf_.unique())
+            buf_ = std::make_shared<http_message::buffer_type>(initial_capacity);
+        if (n) {
+            if (buf_->capacity < n)
+                buf_->grow(0, spare_buf_->capacity);
+            memcpy(buf_->s, spare_buf_->s + pos_, n);
+        }
+    } else if (n && pos_)
+        memmove(buf_->s, buf_->s + pos_, n);
+    pos_ = 0;
+    len_ = n;
+}
+
+void http_parser::release_buffers() {
+    // Messages may still refer to either buffer; those keep it alive.
+    // Oversized buffers are freed rather than pooled.
+    for (int i = 0; i != 2; ++i) {
+        std::shared_ptr<http_message::buffer_type>& b = i ? spare_buf_ : buf_;
+        if (b && b.unique() && b->capacity == initial_capacity
+            && buffer_pool.size() < max_pooled_buffers)
+            buffer_pool.push_back(TAMER_MOVE(b));
+        b.reset();
+    }
+}
+
+inline bool http_parser::parse_buffered(message_data& md) {
+    hp_.data = &md;
+    md.base = buf_->s;
+    size_t n = len_ - pos_;
+    size_t nconsumed =
+        http_parser_execute(&hp_, &settings, buf_->s + pos_, n);
+    pos_ += nconsumed;
+    if (HTTP_PARSER_ERRNO(&hp_) == HPE_PAUSED)
+        http_parser_pause(&hp_, 0);
+    if (hp_.upgrade || nconsumed != n || md.done) {
+        copy_parser_status(md);
+        return true;
+    } else
+        return false;
+}
+
+bool http_parser::receive_buffered(http_message& m) {
+    if (pos_ == len_)
+        return false;
+    message_data md;
+    md.parser = this;
+    md.done = false;
+    md.hold = (size_t) -1;
+    // Parse only a complete message; otherwise roll back so that the
+    // next receive() starts the partial message over.
+    ::http_parser hp = hp_;
+    size_t pos = pos_;
+    if (parse_buffered(md) && md.done && md.hm.ok()) {
+        m = TAMER_MOVE(md.hm);
+        return true;
+    }
+    hp_ = hp;
+    pos_ = pos;
+    return false;
+}
+
 tamed void http_parser::receive(fd f, event<http_message> done) {
     tamed {
         message_data md;
         fdref fi(std::move(f));
     }
+    md.parser = this;
     md.done = false;
+    md.hold = (size_t) -1;
 
     twait { fi.acquire_read(tamer::make_event()); }
+    prepare_buffer();
+
+    while (done) {
+        // Bytes left over from a pipelined request come first.
+        if (pos_ != len_ && parse_buffered(md))
+            break;
+        if (!fi)
+            break;
 
-    while (fi && done) {
         {
-            char mbuf[32768];
-            ssize_t nread = fi.read(mbuf, sizeof(mbuf));
+            // Before the headers are complete, every byte may be
+            // referenced; afterwards, only the first md.hold bytes.
+            if (len_ == buf_->capacity) {
+                pos_ = len_ = std::min(len_, md.hold);
+                if (buf_->capacity - len_ < initial_capacity
+                    || buf_->capacity < max_body_capacity)
+                    buf_->grow(len_, 2 * buf_->capacity);
+            }
+
+            ssize_t nread = fi.read(buf_->s + len_, buf_->capacity - len_);
 
             if (nread != 0 && nread != (ssize_t) -1) {
-                hp_.data = &md;
-                size_t nconsumed =
-                    http_parser_execute(&hp_, &settings, mbuf, nread);
-                if (hp_.upgrade || nconsumed != (size_t) nread || md.done) {
-                    copy_parser_status(md);
-                    break;
-                }
+                len_ += nread;
+                continue;
             } else if (nread == 0)
                 break;
             else if (errno == EAGAIN || errno == EWOULDBLOCK)
-                /* fall through to blocking */;
+                // fall through to blocking
+                tamer::read_would_block(fi.fdnum());
             else if (errno != EINTR) {
                 fi.close(errno);
                 break;
@@ -414,7 +808,13 @@ tamed void http_parser::receive(fd f, event<http_message> done) {
                 continue;
         }
 
+        // An idle parser gives up its buffers until the next message
+        // starts; nothing of this message has been read yet.
+        if (idle_ && len_ == 0)
+            release_buffers();
         twait { tamer::at_fd_read(fi.fdnum(), make_event()); }
+        if (!buf_)
+            prepare_buffer();
     }
 
     if (done && !md.done && !md.hm.error_)
@@ -422,102 +822,162 @@ tamed void http_parser::receive(fd f, event<http_message> done) {
     done(TAMER_MOVE(md.hm));
 }
 
-void http_parser::unparse_request_headers(std::ostringstream& buf,
+/** @brief Receive a batch of pipelined messages.
+    @param f file descriptor
+    @param[out] ms messages
+    @param done event triggered on completion
+
+    Waits for one message, as receive() does, then also parses every
+    further complete message already read from @a f, without blocking.
+    Stops early after a message that ends the connection or upgrades it. */
+tamed void http_parser::receive_many(fd f, std::vector<http_message>& ms,
+                                     event<> done) {
+    tamed { http_message m; }
+    ms.clear();
+    twait { receive(f, make_event(m)); }
+    ms.push_back(TAMER_MOVE(m));
+    while (ok() && !hp_.upgrade && should_keep_alive()
+           && receive_buffered(m))
+        ms.push_back(TAMER_MOVE(m));
+    done();
+}
+
+size_t http_parser::unparse_size(const http_message& m) {
+    // status or request line, Content-Length, and slop
+    size_t n = 64 + m.url_view().length() + m.status_message_.length();
+    for (size_t i = 0, nh = m.nheaders(); i != nh; ++i)
+        n += m.header_name_view(i).length() + m.header_value_view(i).length() + 4;
+    return n;
+}
+
+void http_parser::unparse_request_headers(std::string& buf,
                                           const http_message& m) {
-    buf << http_method_str(m.method()) << " " << m.url()
-        << " HTTP/" << m.http_major() << "." << m.http_minor() << "\r\n";
-    bool need_content_length = !m.body_.empty();
-    for (http_message::header_iterator it = m.raw_headers_.begin();
-         it != m.raw_headers_.end(); ++it) {
-        buf << it->name << ": " << it->value << "\r\n";
-        need_content_length = need_content_length && !it->is_content_length();
+    append(buf, http_method_str(m.method()));
+    buf += ' ';
+    append(buf, m.url_view());
+    buf.append(" HTTP/", 6);
+    append_decimal(buf, m.http_major());
+    buf += '.';
+    append_decimal(buf, m.http_minor());
+    buf.append("\r\n", 2);
+    for (size_t i = 0, nh = m.nheaders(); i != nh; ++i)
+        append_header(buf, m.header_name_view(i), m.header_value_view(i));
+    if (!m.body_.empty() && !m.has_canonical_header(hh_content_length)) {
+        buf.append("Content-Length: ", 16);
+        append_decimal(buf, m.body_.length());
+        buf.append("\r\n", 2);
     }
-    if (need_content_length)
-        buf << "Content-Length: " << m.body_.length() << "\r\n";
-    buf << "\r\n";
+    buf.append("\r\n", 2);
 }
 
 inline std::string http_parser::prepare_headers(const http_message& m,
-                                                std::string& body,
-                                                bool is_response) {
-    std::ostringstream buf;
+                                                bool is_response,
+                                                bool& merged) {
+    // Size the buffer once; small bodies go out in the same write.
+    size_t hsize = unparse_size(m);
+    merged = hsize + m.body_.length() < 16384;
+    std::string buf;
+    buf.reserve(hsize + (merged ? m.body_.length() : 0));
     if (is_response)
         unparse_response_headers(buf, m, true);
     else
         unparse_request_headers(buf, m);
-    if (buf.tellp() + std::ostringstream::pos_type(body.length()) < 16384) {
-        buf << TAMER_MOVE(body);
-        body.clear();
-    }
-    return buf.str();
+    if (merged)
+        buf += m.body_;
+    return buf;
 }
 
 tamed static void http_parser::send_two(fd f, std::string a,
                                         std::string b, event<> done) {
-    twait { f.write(TAMER_MOVE(a), make_event()); }
-    f.write(TAMER_MOVE(b), done);
+    twait { f.write(TAMER_MOVE(a), (size_t*) 0, rebind<int>(make_event())); }
+    f.write(TAMER_MOVE(b), (size_t*) 0, rebind<int>(done));
 }
 
 void http_parser::send_request(fd f, const http_message& m, event<> done) {
-    std::string body = m.body();
-    std::string headers = prepare_headers(m, body, false);
-    send_message(f, headers, body, done);
+    bool merged;
+    std::string headers = prepare_headers(m, false, merged);
+    send_message(f, TAMER_MOVE(headers), merged ? std::string() : m.body_, done);
 }
 
 void http_parser::send_request(fd f, http_message&& m, event<> done) {
-    std::string headers = prepare_headers(m, m.body_, false);
-    send_message(f, headers, TAMER_MOVE(m.body_), done);
+    bool merged;
+    std::string headers = prepare_headers(m, false, merged);
+    if (merged)
+        m.body_.clear();
+    send_message(f, TAMER_MOVE(headers), TAMER_MOVE(m.body_), done);
 }
 
-void http_parser::unparse_response_headers(std::ostringstream& buf,
+void http_parser::unparse_response_headers(std::string& buf,
                                            const http_message& m,
                                            bool include_content_length) {
-    buf << "HTTP/" << m.http_major() << "." << m.http_minor()
-        << " " << m.status_code() << " ";
+    buf.append("HTTP/", 5);
+    append_decimal(buf, m.http_major());
+    buf += '.';
+    append_decimal(buf, m.http_minor());
+    buf += ' ';
+    append_decimal(buf, m.status_code());
+    buf += ' ';
     if (m.status_message().empty())
-        buf << m.default_status_message(m.status_code());
+        append(buf, m.default_status_message(m.status_code()));
     else
-        buf << m.status_message();
-    buf << "\r\n";
-    bool need_content_length = !m.body_.empty() && include_content_length;
-    for (http_message::header_iterator it = m.raw_headers_.begin();
-         it != m.raw_headers_.end(); ++it) {
-        buf << it->name << ": " << it->value << "\r\n";
-        need_content_length = need_content_length && !it->is_content_length();
+        buf += m.status_message();
+    buf.append("\r\n", 2);
+    for (size_t i = 0, nh = m.nheaders(); i != nh; ++i)
+        append_header(buf, m.header_name_view(i), m.header_value_view(i));
+    if (!m.body_.empty() && include_content_length
+        && !m.has_canonical_header(hh_content_length)) {
+        buf.append("Content-Length: ", 16);
+        append_decimal(buf, m.body_.length());
+        buf.append("\r\n", 2);
     }
-    if (need_content_length)
-        buf << "Content-Length: " << m.body_.length() << "\r\n";
-    buf << "\r\n";
+    buf.append("\r\n", 2);
 }
 
 void http_parser::send_response(fd f, const http_message& m, event<> done) {
-    std::string body = m.body();
-    std::string headers = prepare_headers(m, body, true);
-    send_message(f, headers, body, done);
+    bool merged;
+    std::string headers = prepare_headers(m, true, merged);
+    send_message(f, TAMER_MOVE(headers), merged ? std::string() : m.body_, done);
 }
 
 void http_parser::send_response(fd f, http_message&& m, event<> done) {
-    std::string headers = prepare_headers(m, m.body_, true);
-    send_message(f, headers, TAMER_MOVE(m.body_), done);
+    bool merged;
+    std::string headers = prepare_headers(m, true, merged);
+    if (merged)
+        m.body_.clear();
+    send_message(f, TAMER_MOVE(headers), TAMER_MOVE(m.body_), done);
+}
+
+/** @brief Send a prebuilt response.
+
+    The response's bytes are shared, not copied, and go out in one write. */
+tamed static void http_parser::send_response(fd f, http_prebuilt_response r,
+                                             event<> done) {
+    twait { f.write(r.data(), r.length(), make_event()); }
+    done();
 }
 
 void http_parser::send_response_headers(fd f, const http_message& m,
                                         event<> done) {
-    std::ostringstream buf;
+    std::string buf;
+    buf.reserve(unparse_size(m));
     unparse_response_headers(buf, m, false);
-    f.write(buf.str(), done);
+    f.write(TAMER_MOVE(buf), (size_t*) 0, rebind<int>(done));
 }
 
 tamed static void http_parser::send_response_chunk(fd f, std::string s,
                                                    event<> done) {
-    tamed { std::ostringstream buf; }
-    buf << s.length() << "\r\n";
+    tamed { std::string buf; }
+    // chunk sizes are hexadecimal
+    append_hex(buf, s.length());
+    buf.append("\r\n", 2);
     if (s.length() <= 16384) {
-        buf << s << "\r\n";
-        f.write(buf.str(), done);
+        buf.reserve(buf.length() + s.length() + 2);
+        buf += s;
+        buf.append("\r\n", 2);
+        f.write(TAMER_MOVE(buf), (size_t*) 0, rebind<int>(done));
     } else {
-        twait { f.write(buf.str(), make_event()); }
-        twait { f.write(TAMER_MOVE(s), make_event()); }
+        twait { f.write(TAMER_MOVE(buf), (size_t*) 0, rebind<int>(make_event())); }
+        twait { f.write(TAMER_MOVE(s), (size_t*) 0, rebind<int>(make_event())); }
         f.write("\r\n", 2, done);
     }
 }
@@ -532,26 +992,35 @@ void http_parser::send(fd f, const http_message& m, event<> done) {
     else if (hp_.type == (int) HTTP_REQUEST) {
         // If the response is marked `Connection: close`, then ensure
         // should_keep_alive() returns 0
-        http_message::header_iterator connhdr;
-        const char* data;
         if (should_keep_alive()
-            && (connhdr = m.find_canonical_header("connection")) != m.header_end()
-            && (connhdr->value.length() == 5
-                && (data = connhdr->value.data())
-                && (data[0] == 'C' || data[0] == 'c')
-                && (data[1] == 'L' || data[1] == 'l')
-                && (data[2] == 'O' || data[2] == 'o')
-                && (data[3] == 'S' || data[3] == 's')
-                && (data[4] == 'E' || data[4] == 'e'))) {
-            if (hp_.http_major > 0 && hp_.http_minor > 0)
-                hp_.flags |= F_CONNECTION_CLOSE;
-            else
-                hp_.flags &= ~F_CONNECTION_KEEP_ALIVE;
-        }
-
+            && is_close_token(m.canonical_header_view(hh_connection)))
+            clear_should_keep_alive();
         send_response(f, m, done);
     } else
         assert(0);
 }
 
+void http_parser::send(fd f, const http_prebuilt_response& r, event<> done) {
+    assert(hp_.type == (int) HTTP_REQUEST);
+    if (r.closes_connection() && should_keep_alive())
+        clear_should_keep_alive();
+    send_response(f, r, done);
+}
+
+
+/** @brief Serialize @a m, headers and body, into immutable bytes.
+
+    Use this for fixed responses, such as a 404 page or a health check,
+    that are sent many times. Sending a prebuilt response is a single
+    write of shared bytes. Since the bytes never change, a prebuilt
+    response usually shouldn't carry a Date header. */
+http_prebuilt_response::http_prebuilt_response(const http_message& m)
+    : close_(is_close_token(m.canonical_header_view(hh_connection))) {
+    std::string buf;
+    buf.reserve(http_parser::unparse_size(m) + m.body().length());
+    http_parser::unparse_response_headers(buf, m, true);
+    buf += m.body();
+    s_ = std::make_shared<const std::string>(TAMER_MOVE(buf));
+}
+
 } // namespace tamer
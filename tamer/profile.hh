@@ -0,0 +1,41 @@
+#ifndef TAMER_PROFILE_HH
+#define TAMER_PROFILE_HH 1
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <tamer/event.hh>
+#include <stdio.h>
+#include <vector>
+namespace tamer {
+
+/** @file <tamer/profile.hh>
+ *  @brief  Blocking-time profiles by event creation site.
+ */
+
+/** @brief  Profile totals for events created at one source location. */
+struct profile_site {
+    const char* file;           // null if events there are unannotated
+    int line;
+    uint64_t count;             // sampled events triggered
+    double total;               // seconds from creation to trigger
+    double max;
+};
+
+bool profile_start(unsigned sample_period = 1);
+void profile_stop();
+void profile_reset();
+void profile_sites(std::vector<profile_site>& sites);
+void profile_report(FILE* f, size_t top = 20);
+void profile_report_on_signal(int signo, FILE* f = stderr, size_t top = 20);
+
+} // namespace tamer
+#endif /* TAMER_PROFILE_HH */
@@ -15,8 +15,66 @@
  */
 #include <cassert>
 #include <cstring>
+#include <new>
+#include <type_traits>
 #include <tamer/xbase.hh>
 namespace tamer {
+namespace tamerpriv {
+
+/** @cond never */
+
+// How rendezvous<I> stores event IDs in simple_event::rid(). IDs that fit
+// in a uintptr_t and need no copy or destroy logic, such as
+// std::pair<int, int> on 64-bit machines, are stored inline. Others are
+// copied into slab-allocated storage.
+template <typename I,
+          bool is_inline = (sizeof(I) <= sizeof(uintptr_t)
+                            && alignof(I) <= alignof(uintptr_t)
+                            && std::is_trivially_copy_constructible<I>::value
+                            && std::is_trivially_destructible<I>::value)>
+struct rid_store {
+    enum { stored_inline = 1 };
+    static inline uintptr_t in(const I& eid) TAMER_NOEXCEPT {
+        uintptr_t x = 0;
+        memcpy(&x, static_cast<const void*>(&eid), sizeof(I));
+        return x;
+    }
+    static inline void out(uintptr_t x, I& eid) {
+        alignas(I) char buf[sizeof(I)];
+        memcpy(buf, &x, sizeof(I));
+        eid = *reinterpret_cast<I*>(buf);
+    }
+    static inline void destroy(uintptr_t) TAMER_NOEXCEPT {
+    }
+};
+
+template <typename I>
+struct rid_store<I, false> {
+    enum { stored_inline = 0 };
+    static inline uintptr_t in(const I& eid) {
+        void* p = slab_allocator<sizeof(I)>::allocate();
+        try {
+            return reinterpret_cast<uintptr_t>(new(p) I(eid));
+        } catch (...) {
+            slab_allocator<sizeof(I)>::deallocate(p);
+            throw;
+        }
+    }
+    static inline void out(uintptr_t x, I& eid) {
+        I* eidp = reinterpret_cast<I*>(x);
+        eid = TAMER_MOVE(*eidp);
+        destroy(x);
+    }
+    static inline void destroy(uintptr_t x) TAMER_NOEXCEPT {
+        I* eidp = reinterpret_cast<I*>(x);
+        eidp->~I();
+        slab_allocator<sizeof(I)>::deallocate(eidp);
+    }
+};
+
+/** @endcond never */
+
+} // namespace tamerpriv
 
 /** @file <tamer/rendezvous.hh>
  *  @brief  The rendezvous template classes.
@@ -31,6 +89,11 @@ namespace tamer {
  *  but with parameters to @c join appropriate to the template arguments.
  *  Specialized rendezvous implementations are often more efficient than the
  *  full @c rendezvous.
+ *
+ *  Every rendezvous has a scheduling class, set by set_priority(). When a
+ *  closure blocked on the rendezvous wakes up, the driver runs it in that
+ *  class: high before normal, and low-priority closures only within a
+ *  per-iteration budget, so bulk work can't delay latency-critical work.
  */
 template <typename I>
 class rendezvous : public tamerpriv::explicit_rendezvous,
@@ -112,9 +175,7 @@ inline bool rendezvous<I>::has_events() const {
 template <typename I>
 inline bool rendezvous<I>::join(I& eid) {
     if (ready_) {
-        I* eidp = reinterpret_cast<I*>(pop_ready());
-        eid = TAMER_MOVE(*eidp);
-        delete eidp;
+        tamerpriv::rid_store<I>::out(pop_ready(), eid);
         return true;
     } else
         return false;
@@ -126,21 +187,26 @@ inline bool rendezvous<I>::join(I& eid) {
  *  has_events() will return false. */
 template <typename I>
 void rendezvous<I>::clear() {
-    for (tamerpriv::simple_event *e = waiting_; e; e = e->next())
-        delete reinterpret_cast<I*>(e->rid());
+    if (!tamerpriv::rid_store<I>::stored_inline) {
+        for (tamerpriv::simple_event *e = waiting_; e; e = e->next())
+            tamerpriv::rid_store<I>::destroy(e->rid());
+        for (tamerpriv::simple_event *e = ready_; e; e = e->next())
+            tamerpriv::rid_store<I>::destroy(e->rid());
+    }
     abstract_rendezvous::remove_waiting();
-    for (tamerpriv::simple_event *e = ready_; e; e = e->next())
-        delete reinterpret_cast<I*>(e->rid());
     explicit_rendezvous::remove_ready();
 }
 
 /** @internal
  *  @brief  Add an occurrence to this rendezvous.
  *  @param  eid  The occurrence's event ID.
+ *
+ *  Small trivially-copyable IDs are stored in the event itself; others are
+ *  copied into slab-allocated storage.
  */
 template <typename I>
 inline uintptr_t rendezvous<I>::make_rid(const I& eid) {
-    return reinterpret_cast<uintptr_t>(new I(eid));
+    return tamerpriv::rid_store<I>::in(eid);
 }
 
 
@@ -354,13 +420,19 @@ class distribute_rendezvous : public functional_rendezvous,
     inline int nchildren() const {
         return nes_;
     }
+    static inline void* operator new(size_t) {
+        return slab_allocator<sizeof(distribute_rendezvous<T0, T1, T2, T3>)>::allocate();
+    }
+    static inline void operator delete(void* p) TAMER_NOEXCEPT {
+        slab_allocator<sizeof(distribute_rendezvous<T0, T1, T2, T3>)>::deallocate(p);
+    }
   private:
-    enum { nlocal = 2 };
+    enum { nlocal = 4 };        // must be a power of two
     int nes_;
     int outstanding_;
     event_type* es_;
     typename event_type::arguments_type vs_;
-    char local_es_[sizeof(event_type) * nlocal];
+    alignas(event_type) char local_es_[sizeof(event_type) * nlocal];
     static void hook(functional_rendezvous*, simple_event*, bool) TAMER_NOEXCEPT;
     static void clear_hook(void*);
     void add(event_type e);
@@ -0,0 +1,293 @@
+#ifndef TAMER_SHARDED_HH
+#define TAMER_SHARDED_HH 1
+#include <tamer/tamer.hh>
+#include <vector>
+#include <functional>
+namespace tamer {
+
+/** @file <tamer/sharded.hh>
+ *  @brief  Shared-nothing state split across drivers.
+ */
+
+namespace tamerpriv {
+// Runs on the shard's driver, then posts the result home. The home driver
+// expects that post, so its loop waits for the result.
+template <typename T, typename F, typename R>
+class shard_call_node : public post_node {
+  public:
+    inline shard_call_node(T& v, F&& f, driver* home, event<R>&& done)
+        : v_(v), f_(std::move(f)), home_(home), done_(std::move(done)) {
+    }
+    virtual void post_run() {
+        tamer::post_expected(home_, TAMER_MOVE(done_), f_(v_));
+    }
+  private:
+    T& v_;
+    F f_;
+    driver* home_;
+    event<R> done_;
+};
+
+template <typename T, typename F>
+class shard_call_node<T, F, void> : public post_node {
+  public:
+    inline shard_call_node(T& v, F&& f, driver* home, event<>&& done)
+        : v_(v), f_(std::move(f)), home_(home), done_(std::move(done)) {
+    }
+    virtual void post_run() {
+        f_(v_);
+        if (done_)
+            tamer::post_expected(home_, TAMER_MOVE(done_));
+    }
+  private:
+    T& v_;
+    F f_;
+    driver* home_;
+    event<> done_;
+};
+
+// Lives on the broadcasting driver; each shard posts one arrival.
+class shard_gather {
+  public:
+    inline shard_gather(unsigned n, event<> done)
+        : n_(n), done_(TAMER_MOVE(done)) {
+    }
+    inline void arrive() {
+        if (--n_ == 0) {
+            done_();
+            delete this;
+        }
+    }
+  private:
+    unsigned n_;
+    event<> done_;
+};
+
+class shard_arrive_node : public post_node {
+  public:
+    inline shard_arrive_node(shard_gather* g)
+        : g_(g) {
+    }
+    virtual void post_run() {
+        g_->arrive();
+    }
+  private:
+    shard_gather* g_;
+};
+
+template <typename T, typename F>
+class shard_broadcast_node : public post_node {
+  public:
+    inline shard_broadcast_node(T& v, const F& f, driver* home,
+                                shard_gather* g)
+        : v_(v), f_(f), home_(home), g_(g) {
+    }
+    virtual void post_run() {
+        f_(v_);
+        home_->post(new shard_arrive_node(g_), true);
+    }
+  private:
+    T& v_;
+    F f_;
+    driver* home_;
+    shard_gather* g_;
+};
+} // namespace tamerpriv
+
+template <typename T>
+class sharded {
+  public:
+    explicit sharded(const std::vector<driver*>& owners);
+    ~sharded();
+
+    inline size_t nshards() const;
+    inline driver* owner(size_t i) const;
+    inline T& shard(size_t i);
+    inline T& local();
+    template <typename K> inline size_t shard_for(const K& key) const;
+
+    template <typename F, typename R>
+    void invoke_on(size_t i, F f, event<R> done);
+    template <typename F>
+    void invoke_on(size_t i, F f, event<> done = event<>());
+    template <typename K, typename F, typename R>
+    inline void invoke(const K& key, F f, event<R> done);
+    template <typename K, typename F>
+    inline void invoke(const K& key, F f, event<> done = event<>());
+
+    template <typename F>
+    void broadcast(F f, event<> done = event<>());
+
+  private:
+    struct shard_type {
+        T value;
+        driver* owner;
+        // keep the next allocation off this shard's cache lines
+        char pad[64];
+        explicit shard_type(driver* d)
+            : value(), owner(d) {
+        }
+    };
+
+    std::vector<shard_type*> shards_;
+    std::vector<int> local_;    // driver index -> shard
+
+    sharded(const sharded<T>&);
+    sharded<T>& operator=(const sharded<T>&);
+};
+
+/** @class sharded tamer/sharded.hh <tamer/sharded.hh>
+ *  @brief  One T per driver, reached by message passing.
+ *
+ *  A sharded<T> holds one T, a shard, for each of a set of drivers, one
+ *  per thread. Only a shard's own driver touches it, so shards need no
+ *  locks. Code on another driver reaches a shard by forwarding a function
+ *  with invoke(), which runs the function on the owning driver and posts
+ *  the result back as an event, using the cross-thread post() queue:
+ *
+ *  @code
+ *     tamer::sharded<std::unordered_map<std::string, std::string> > cache(drivers);
+ *     tamed void lookup(std::string key, tamer::event<std::string> done) {
+ *         cache.invoke(key, [key](std::unordered_map<std::string, std::string>& m) {
+ *             auto it = m.find(key);
+ *             return it == m.end() ? std::string() : it->second;
+ *         }, done);
+ *     }
+ *  @endcode
+ *
+ *  Keys map to shards by std::hash. A function runs directly, and its
+ *  event triggers immediately, when the calling driver owns the shard.
+ *  Forwarded functions run in posting order on the shard's driver. They
+ *  are moved across threads, so they must not capture events or other
+ *  objects that belong to the calling driver, apart from values they copy.
+ *
+ *  The calling driver's loop keeps running while it waits for forwarded
+ *  results. The sharded object and its owners must outlive all forwarded
+ *  calls. */
+
+/** @brief  Construct a sharded object with one shard per driver in
+ *  @a owners.
+ *
+ *  Shards are default-constructed by the calling thread. */
+template <typename T>
+sharded<T>::sharded(const std::vector<driver*>& owners)
+    : local_(driver::capacity, -1) {
+    for (size_t i = 0; i != owners.size(); ++i) {
+        shards_.push_back(new shard_type(owners[i]));
+        local_[owners[i]->index()] = i;
+    }
+}
+
+template <typename T>
+sharded<T>::~sharded() {
+    for (size_t i = 0; i != shards_.size(); ++i)
+        delete shards_[i];
+}
+
+template <typename T>
+inline size_t sharded<T>::nshards() const {
+    return shards_.size();
+}
+
+/** @brief  Return the driver that owns shard @a i. */
+template <typename T>
+inline driver* sharded<T>::owner(size_t i) const {
+    return shards_[i]->owner;
+}
+
+/** @brief  Return shard @a i.
+ *
+ *  Only shard @a i's owner may use the result. */
+template <typename T>
+inline T& sharded<T>::shard(size_t i) {
+    return shards_[i]->value;
+}
+
+/** @brief  Return the calling driver's shard. */
+template <typename T>
+inline T& sharded<T>::local() {
+    int i = local_[driver::main->index()];
+    assert(i >= 0);
+    return shards_[i]->value;
+}
+
+/** @brief  Return the shard that owns @a key. */
+template <typename T> template <typename K>
+inline size_t sharded<T>::shard_for(const K& key) const {
+    return std::hash<K>()(key) % shards_.size();
+}
+
+/** @brief  Run @a f on shard @a i and trigger @a done with its result.
+ *  @param  i  Shard number.
+ *  @param  f  Function called as @a f(T&); must return a value
+ *             convertible to R.
+ *  @param  done  Event triggered, on the calling driver, with the result. */
+template <typename T> template <typename F, typename R>
+void sharded<T>::invoke_on(size_t i, F f, event<R> done) {
+    shard_type* s = shards_[i];
+    if (s->owner == driver::main)
+        done.trigger(f(s->value));
+    else {
+        driver::main->expect_post();
+        s->owner->post(new tamerpriv::shard_call_node<T, F, R>
+                       (s->value, TAMER_MOVE(f), driver::main,
+                        TAMER_MOVE(done)));
+    }
+}
+
+/** @brief  Run @a f on shard @a i, then trigger @a done.
+ *
+ *  @a done may be empty, for fire-and-forget updates. */
+template <typename T> template <typename F>
+void sharded<T>::invoke_on(size_t i, F f, event<> done) {
+    shard_type* s = shards_[i];
+    if (s->owner == driver::main) {
+        f(s->value);
+        done();
+    } else {
+        if (done)
+            driver::main->expect_post();
+        s->owner->post(new tamerpriv::shard_call_node<T, F, void>
+                       (s->value, TAMER_MOVE(f), driver::main,
+                        TAMER_MOVE(done)));
+    }
+}
+
+/** @brief  Run @a f on the shard owning @a key and trigger @a done with
+ *  its result. */
+template <typename T> template <typename K, typename F, typename R>
+inline void sharded<T>::invoke(const K& key, F f, event<R> done) {
+    invoke_on(shard_for(key), TAMER_MOVE(f), TAMER_MOVE(done));
+}
+
+/** @brief  Run @a f on the shard owning @a key, then trigger @a done. */
+template <typename T> template <typename K, typename F>
+inline void sharded<T>::invoke(const K& key, F f, event<> done) {
+    invoke_on(shard_for(key), TAMER_MOVE(f), TAMER_MOVE(done));
+}
+
+/** @brief  Run @a f on every shard, then trigger @a done.
+ *
+ *  Each shard's driver runs its own copy of @a f; the calling driver's
+ *  shard runs first, directly. Other shards each get one posted message,
+ *  and @a done triggers after the last reports back. */
+template <typename T> template <typename F>
+void sharded<T>::broadcast(F f, event<> done) {
+    tamerpriv::shard_gather* g =
+        new tamerpriv::shard_gather(shards_.size() + 1, TAMER_MOVE(done));
+    for (size_t i = 0; i != shards_.size(); ++i) {
+        shard_type* s = shards_[i];
+        if (s->owner == driver::main) {
+            f(s->value);
+            g->arrive();
+        } else {
+            driver::main->expect_post();
+            s->owner->post(new tamerpriv::shard_broadcast_node<T, F>
+                           (s->value, f, driver::main, g));
+        }
+    }
+    g->arrive();
+}
+
+} // namespace tamer
+#endif /* TAMER_SHARDED_HH */
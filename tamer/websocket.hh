@@ -51,6 +51,36 @@ class websocket_message {
     std::string body_;
 };
 
+/** @brief What websocket_parser::offer() does when a connection's
+    backlog is full. */
+enum websocket_backpressure {
+    WEBSOCKET_DROP = 0,         ///< drop the new frame
+    WEBSOCKET_COALESCE = 1,     ///< keep only the newest frame until the backlog drains
+    WEBSOCKET_DISCONNECT = 2    ///< drop the frame and close the connection
+};
+
+/** @brief A server-to-client frame encoded once and shared.
+
+    Server frames are not masked, so the same bytes can go to every
+    connection. Copying a websocket_frame copies a reference. */
+class websocket_frame {
+  public:
+    inline websocket_frame();
+    explicit websocket_frame(const websocket_message& m);
+
+    inline bool empty() const;
+    inline enum websocket_opcode opcode() const;
+    inline bool incomplete() const;
+    inline const char* data() const;
+    inline size_t length() const;
+
+  private:
+    std::shared_ptr<const std::string> s_;
+
+    inline size_t header_length() const;
+    friend class websocket_parser;
+};
+
 class websocket_parser : public tamed_class {
   public:
     inline websocket_parser(enum http_parser_type type);
@@ -64,14 +94,32 @@ class websocket_parser : public tamed_class {
     void send(fd f, websocket_message m, event<> done);
     inline void send_text(fd f, std::string text, event<> done);
     inline void send_binary(fd f, std::string text, event<> done);
+    void send(fd f, const websocket_frame& frame, event<> done);
+    bool offer(fd f, const websocket_frame& frame);
     void close(fd f, uint16_t code, std::string reason, event<> done);
     inline void close(fd f, uint16_t code, event<> done);
 
+    inline size_t backlog() const;
+    inline size_t backlog_limit() const;
+    inline void set_backlog_limit(size_t limit, enum websocket_backpressure policy = WEBSOCKET_DROP);
+    inline unsigned long ndropped() const;
+
   private:
     enum http_parser_type type_;
     uint8_t closed_;
+    uint8_t backpressure_;
+    bool offer_fragmented_;
     uint16_t close_code_;
     std::string close_reason_;
+    size_t backlog_;
+    size_t backlog_limit_;
+    unsigned long ndropped_;
+    websocket_frame held_;
+
+    enum { default_backlog_limit = 1 << 20 };
+
+    void send_offered(fd f, websocket_frame frame);
+    static void write_frame(fd f, websocket_frame frame, event<int> done);
 
     class closure__receive_any__2fdR17websocket_messageR17websocket_messageQi_;
     void receive_any(closure__receive_any__2fdR17websocket_messageR17websocket_messageQi_&);
@@ -79,6 +127,10 @@ class websocket_parser : public tamed_class {
     void receive(closure__receive__2fdQ17websocket_message_&);
     class closure__send__2fd17websocket_messageQ_;
     void send(closure__send__2fd17websocket_messageQ_&);
+    class closure__send_offered__2fd15websocket_frame;
+    void send_offered(closure__send_offered__2fd15websocket_frame&);
+    class closure__write_frame__2fd15websocket_frameQi_;
+    static void write_frame(closure__write_frame__2fd15websocket_frameQi_&);
 };
 
 inline websocket_message::websocket_message()
@@ -161,8 +213,37 @@ inline websocket_message& websocket_message::binary(std::string s) {
     return *this;
 }
 
+inline websocket_frame::websocket_frame() {
+}
+
+inline bool websocket_frame::empty() const {
+    return !s_;
+}
+
+inline enum websocket_opcode websocket_frame::opcode() const {
+    return websocket_opcode(s_ ? (*s_)[0] & 15 : 0);
+}
+
+inline bool websocket_frame::incomplete() const {
+    return s_ && !((*s_)[0] & 0x80);
+}
+
+inline const char* websocket_frame::data() const {
+    return s_ ? s_->data() : 0;
+}
+
+inline size_t websocket_frame::length() const {
+    return s_ ? s_->length() : 0;
+}
+
+inline size_t websocket_frame::header_length() const {
+    unsigned l = (*s_)[1] & 127;
+    return l < 126 ? 2 : (l == 126 ? 4 : 10);
+}
+
 inline websocket_parser::websocket_parser(enum http_parser_type type)
-    : type_(type), closed_(0), close_code_(0) {
+    : type_(type), closed_(0), backpressure_(WEBSOCKET_DROP),
+      offer_fragmented_(false), close_code_(0), backlog_(0), backlog_limit_(default_backlog_limit), ndropped_(0) {
 }
 
 inline bool websocket_parser::ok() const {
@@ -189,5 +270,26 @@ inline void websocket_parser::close(fd f, uint16_t close_code, event<> done) {
     close(f, close_code, std::string(), done);
 }
 
+/** @brief Return the number of offered bytes not yet written. */
+inline size_t websocket_parser::backlog() const {
+    return backlog_;
+}
+
+inline size_t websocket_parser::backlog_limit() const {
+    return backlog_limit_;
+}
+
+/** @brief Set the backlog offer() allows before applying @a policy. */
+inline void websocket_parser::set_backlog_limit(size_t limit,
+                                                enum websocket_backpressure policy) {
+    backlog_limit_ = limit;
+    backpressure_ = policy;
+}
+
+/** @brief Return the number of frames offer() has dropped or coalesced away. */
+inline unsigned long websocket_parser::ndropped() const {
+    return ndropped_;
+}
+
 }
 #endif
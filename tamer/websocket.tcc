@@ -1,4 +1,5 @@
 #include "websocket.hh"
+#include "wscodec.hh"
 #include <mbedtls/base64.h>
 #include <mbedtls/ctr_drbg.h>
 #include <mbedtls/entropy.h>
@@ -38,54 +39,33 @@ union websocket_mask_union {
     unsigned char c[4];
 };
 
-namespace {
-void do_mask(unsigned char* x, size_t n, websocket_mask_union mask) {
-    size_t i;
-    uint32_t z;
-    for (i = 0; i + 4 <= n; i += 4) {
-        memcpy(&z, &x[i], 4);
-        z ^= mask.u;
-        memcpy(&x[i], &z, 4);
+static int encode_header(unsigned char* header, const websocket_message& m,
+                         bool masked) {
+    size_t l = m.body().length();
+    header[0] = (m.incomplete() ? 0 : 0x80) | int(m.opcode());
+    header[1] = (masked ? 0x80 : 0)
+        | (l < 126 ? l : (l <= 65535 ? 126 : 127));
+    if (l < 126)
+        return 2;
+    else if (l <= 65535) {
+        header[2] = l >> 8;
+        header[3] = l % 256;
+        return 4;
+    } else {
+        header[2] = uint64_t(l) >> 56;
+        header[3] = (uint64_t(l) >> 48) % 256;
+        header[4] = (uint64_t(l) >> 40) % 256;
+        header[5] = (uint64_t(l) >> 32) % 256;
+        header[6] = (l >> 24) % 256;
+        header[7] = (l >> 16) % 256;
+        header[8] = (l >> 8) % 256;
+        header[9] = l % 256;
+        return 10;
     }
-    for (; i < n; ++i)
-        x[i] ^= mask.c[i & 3];
-}
-void do_mask(char* x, size_t n, websocket_mask_union mask) {
-    return do_mask(reinterpret_cast<unsigned char*>(x), n, mask);
 }
 
-bool validate_utf8(const char* first, const char* cur, const char* last,
-                   bool complete) {
-    while (cur > first) {
-        --cur;
-        if (((unsigned char) *cur & 0xC0) != 0x80)
-            break;
-    }
-    int state = 0;
-    for (; cur < last; ++cur) {
-        int ch = (unsigned char) *cur;
-        if (state == 0 && ch <= 127)
-            continue;
-        if ((state == 0) != ((ch & 0xC0) != 0x80)
-            || ch == 0xC0
-            || ch == 0xC1
-            || ch >= 0xF5
-            || (state == 2 && ch < 0xA0 && (unsigned char) cur[-1] == 0xE0)
-            || (state == 2 && ch >= 0xA0 && (unsigned char) cur[-1] == 0xED)
-            || (state == 3 && ch < 0x90 && (unsigned char) cur[-1] == 0xF0)
-            || (state == 3 && ch >= 0x90 && (unsigned char) cur[-1] == 0xF4))
-            return false;
-        if (ch >= 0xF0)
-            state = 3;
-        else if (ch >= 0xE0)
-            state = 2;
-        else if (ch >= 0xC0)
-            state = 1;
-        else
-            --state;
-    }
-    return state == 0 || !complete;
-}
+static inline void do_mask(char* x, size_t n, websocket_mask_union mask) {
+    tamerpriv::websocket_mask(reinterpret_cast<unsigned char*>(x), n, mask.u);
 }
 
 tamed void websocket_parser::receive_any(fd f, websocket_message& ctrl, websocket_message& data, event<int> done) {
@@ -178,7 +158,7 @@ tamed void websocket_parser::receive_any(fd f, websocket_message& ctrl, websocke
 
     // validate UTF-8
     if (m->opcode() == WEBSOCKET_TEXT
-        && !validate_utf8(m->body().data(), m->body().data() + offset, m->body().data() + m->body().length(), header[0] & 0x80)) {
+        && !tamerpriv::websocket_validate_utf8(m->body().data(), m->body().data() + offset, m->body().data() + m->body().length(), header[0] & 0x80)) {
         done(-HPE_STRICT);
         twait { close(f, 1007, make_event()); }
         return;
@@ -221,7 +201,7 @@ tamed void websocket_parser::receive(fd f, event<websocket_message> done) {
                     || (close_code_ >= 1014 && close_code_ <= 2999))
                     close_code_ = 1002;
                 if (ctrl.body().length() > 2) {
-                    if (validate_utf8(ctrl.body().data() + 2, ctrl.body().data() + 2, ctrl.body().data() + ctrl.body().length(), true))
+                    if (tamerpriv::websocket_validate_utf8(ctrl.body().data() + 2, ctrl.body().data() + 2, ctrl.body().data() + ctrl.body().length(), true))
                         close_reason_ = ctrl.body().substr(2);
                     else
                         close_code_ = 1002;
@@ -250,29 +230,7 @@ tamed void websocket_parser::send(fd f, websocket_message m, event<> done) {
     if (m.opcode() == WEBSOCKET_CLOSE)
         closed_ |= 2;
 
-    {
-        size_t l = m.body().length();
-        header[0] = (m.incomplete() ? 0 : 0x80) | int(m.opcode());
-        header[1] = (type_ == HTTP_RESPONSE ? 0x80 : 0)
-            | (l < 126 ? l : (l <= 65535 ? 126 : 127));
-        if (l < 126)
-            nheader = 2;
-        else if (l <= 65535) {
-            header[2] = l >> 8;
-            header[3] = l % 256;
-            nheader = 4;
-        } else {
-            header[2] = uint64_t(l) >> 56;
-            header[3] = (uint64_t(l) >> 48) % 256;
-            header[4] = (uint64_t(l) >> 40) % 256;
-            header[5] = (uint64_t(l) >> 32) % 256;
-            header[6] = (l >> 24) % 256;
-            header[7] = (l >> 16) % 256;
-            header[8] = (l >> 8) % 256;
-            header[9] = l % 256;
-            nheader = 10;
-        }
-    }
+    nheader = encode_header(header, m, type_ == HTTP_RESPONSE);
 
     // mask
     if (header[1] & 0x80) {
@@ -298,6 +256,100 @@ tamed void websocket_parser::send(fd f, websocket_message m, event<> done) {
     done();
 }
 
+websocket_frame::websocket_frame(const websocket_message& m) {
+    unsigned char header[10];
+    int nheader = encode_header(header, m, false);
+    std::string buf;
+    buf.reserve(nheader + m.body().length());
+    buf.append(reinterpret_cast<char*>(header), nheader);
+    buf += m.body();
+    s_ = std::make_shared<const std::string>(TAMER_MOVE(buf));
+}
+
+tamed static void websocket_parser::write_frame(fd f, websocket_frame frame,
+                                                event<int> done) {
+    tvars { int r = 0; }
+    // frame's bytes must outlive the write, so wait for it here
+    twait { f.write(frame.data(), frame.length(), make_event(r)); }
+    done(r);
+}
+
+/** @brief Send a prebuilt frame.
+
+    On a server connection the frame's shared bytes are written directly,
+    with no per-connection encoding or copying. A client connection must
+    mask its frames, so there the payload is copied and sent as a
+    websocket_message. */
+void websocket_parser::send(fd f, const websocket_frame& frame, event<> done) {
+    assert(!frame.empty() && !(closed_ & 2));
+    if (type_ == HTTP_RESPONSE) {
+        size_t h = frame.header_length();
+        websocket_message m;
+        m.opcode(frame.opcode()).incomplete(frame.incomplete())
+            .body(std::string(frame.data() + h, frame.length() - h));
+        send(f, TAMER_MOVE(m), done);
+        return;
+    }
+    if (frame.opcode() == WEBSOCKET_CLOSE)
+        closed_ |= 2;
+    write_frame(f, frame, rebind<int>(done));
+}
+
+/** @brief Queue a prebuilt frame without waiting for it to be written.
+    @return true if the frame was queued or held for coalescing.
+
+    This is meant for fan-out, where one frame goes to many connections
+    and a slow reader shouldn't hold up the others. While the bytes
+    offered but not yet written exceed backlog_limit(), new frames are
+    handled according to the policy given to set_backlog_limit(). The
+    first frame offered to an idle connection is always queued.
+
+    Only complete single-frame messages are dropped or coalesced. The
+    frames of a fragmented message are always queued, unless the policy
+    is WEBSOCKET_DISCONNECT, and a held frame is not sent until the
+    fragmented message is finished. */
+bool websocket_parser::offer(fd f, const websocket_frame& frame) {
+    assert(!frame.empty());
+    if (closed_ & 2)
+        return false;
+    bool whole = !frame.incomplete() && frame.opcode() != WEBSOCKET_CONTINUATION;
+    bool full = backlog_ != 0 && backlog_ + frame.length() > backlog_limit_;
+    if (full && backpressure_ == WEBSOCKET_DISCONNECT) {
+        ++ndropped_;
+        f.close(-ENOBUFS);
+        return false;
+    } else if (!whole) {
+        offer_fragmented_ = frame.incomplete();
+        send_offered(f, frame);
+        return true;
+    } else if (!held_.empty() || (full && backpressure_ == WEBSOCKET_COALESCE)) {
+        // a newer frame replaces the held one rather than passing it
+        if (!held_.empty())
+            ++ndropped_;
+        held_ = frame;
+        return true;
+    } else if (!full) {
+        send_offered(f, frame);
+        return true;
+    }
+    ++ndropped_;
+    return false;
+}
+
+tamed void websocket_parser::send_offered(fd f, websocket_frame frame) {
+    backlog_ += frame.length();
+    twait { send(f, frame, make_event()); }
+    backlog_ -= frame.length();
+    // the held frame waits for the whole backlog, and for the end of any
+    // fragmented message
+    if (backlog_ == 0 && !offer_fragmented_ && !held_.empty()
+        && !(closed_ & 2)) {
+        websocket_frame next;
+        std::swap(next, held_);
+        send_offered(f, next);
+    }
+}
+
 void websocket_parser::close(fd f, uint16_t code, std::string reason, event<> done) {
     if (!(closed_ & 2)) {
         websocket_message m;
@@ -374,7 +426,7 @@ bool websocket_handshake::response(http_message& resp, const http_message& req)
         return false;
     resp.status_code(101).header("Upgrade", "websocket")
         .header("Connection", "Upgrade")
-        .date_header("Date", time(0))
+        .date_header("Date")
         .header("Sec-WebSocket-Accept", std::string(reinterpret_cast<char*>(sha1enc), olen));
     return true;
 }
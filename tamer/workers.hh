@@ -0,0 +1,198 @@
+#ifndef TAMER_WORKERS_HH
+#define TAMER_WORKERS_HH 1
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <tamer/fd.hh>
+#include <vector>
+#include <sys/types.h>
+namespace tamer {
+
+/** @file <tamer/workers.hh>
+ *  @brief  A supervised pool of worker processes sharing listeners.
+ */
+
+class worker_pool : public tamed_class {
+  public:
+    typedef void (*worker_function)(worker_pool& pool, int index);
+
+    explicit worker_pool(int nworkers = 0);
+    ~worker_pool();
+
+    int listen(int port, int backlog = fd::default_backlog);
+    int add_listener(fd f);
+
+    int run(worker_function f);
+
+    inline int nworkers() const;
+    inline size_t nlisteners() const;
+    inline fd listener(size_t i = 0) const;
+
+    inline bool is_worker() const;
+    inline int index() const;
+    inline pid_t pid(int i) const;
+    inline unsigned restarts(int i) const;
+    inline bool draining() const;
+    inline void at_drain(event<> e);
+
+    void send_fd(int worker, const fd& f, event<int> done);
+    void receive_fd(event<fd> done);
+
+    inline bool pin_cpus() const;
+    inline void set_pin_cpus(bool pin);
+    inline double restart_delay() const;
+    inline void set_restart_delay(double t);
+    inline double drain_timeout() const;
+    inline void set_drain_timeout(double t);
+
+  private:
+    struct worker {
+        pid_t pid;
+        unsigned restarts;
+        double started;
+        double restart_at;
+        fd channel[2];
+        worker() : pid(0), restarts(0), started(0), restart_at(0) {}
+    };
+
+    std::vector<worker> w_;
+    // each listener is either one shared socket or one socket per worker
+    std::vector<std::vector<fd> > listeners_;
+    std::vector<int> cpus_;
+    int index_;
+    int nlive_;
+    bool draining_;
+    bool pin_cpus_;
+    double restart_delay_;
+    double drain_timeout_;
+    double kill_at_;
+    rendezvous<int> supr_;
+    event<> drain_;
+
+    int spawn(int i, worker_function f);
+    void reap();
+    void start_drain();
+    double next_wake() const;
+    void become_worker(int i);
+
+    void supervise();
+    void watch_drain();
+
+    class closure__supervise;
+    void supervise(closure__supervise&);
+    class closure__watch_drain;
+    void watch_drain(closure__watch_drain&);
+    class closure__receive_fd__Q2fd_;
+    void receive_fd(closure__receive_fd__Q2fd_&);
+
+    worker_pool(const worker_pool&);
+    worker_pool& operator=(const worker_pool&);
+};
+
+/** @brief  Return the number of worker processes. */
+inline int worker_pool::nworkers() const {
+    return w_.size();
+}
+
+inline size_t worker_pool::nlisteners() const {
+    return listeners_.size();
+}
+
+/** @brief  Return listening socket @a i.
+ *
+ *  In a worker, this is the socket that worker should accept on: its own
+ *  member of a @c SO_REUSEPORT group, or the socket shared by all. In the
+ *  master, it is the first socket. */
+inline fd worker_pool::listener(size_t i) const {
+    const std::vector<fd>& l = listeners_[i];
+    return l.size() == 1 || index_ < 0 ? l[0] : l[index_];
+}
+
+/** @brief  Test whether this process is a worker. */
+inline bool worker_pool::is_worker() const {
+    return index_ >= 0;
+}
+
+/** @brief  Return this worker's index, or -1 in the master. */
+inline int worker_pool::index() const {
+    return index_;
+}
+
+/** @brief  Return worker @a i's process ID, or 0 if it is not running.
+ *
+ *  Only meaningful in the master. */
+inline pid_t worker_pool::pid(int i) const {
+    return w_[i].pid;
+}
+
+/** @brief  Return how many times worker @a i has been restarted.
+ *
+ *  In a worker, this is the count when that worker was started, so a
+ *  worker can tell whether it replaces one that crashed. */
+inline unsigned worker_pool::restarts(int i) const {
+    return w_[i].restarts;
+}
+
+/** @brief  Test whether the pool is shutting down. */
+inline bool worker_pool::draining() const {
+    return draining_;
+}
+
+/** @brief  Register @a e to trigger when this worker starts draining.
+ *
+ *  By then the worker's listeners are closed. The worker exits once its
+ *  event loop has no more foreground work, so @a e's receiver should
+ *  finish or close its outstanding connections. */
+inline void worker_pool::at_drain(event<> e) {
+    if (draining_)
+        e.trigger();
+    else
+        drain_ += TAMER_MOVE(e);
+}
+
+/** @brief  Return whether workers are pinned to CPUs. */
+inline bool worker_pool::pin_cpus() const {
+    return pin_cpus_;
+}
+
+/** @brief  Set whether worker @a i is pinned to the @a i th usable CPU.
+ *
+ *  On by default. Has no effect where sched_setaffinity() is missing. */
+inline void worker_pool::set_pin_cpus(bool pin) {
+    pin_cpus_ = pin;
+}
+
+/** @brief  Return the minimum seconds between restarts of one worker. */
+inline double worker_pool::restart_delay() const {
+    return restart_delay_;
+}
+
+/** @brief  Set the minimum seconds between restarts of one worker.
+ *
+ *  A worker that crashes sooner than this after starting is restarted
+ *  only once this much time has passed since it started, so a worker that
+ *  fails at startup doesn't fork in a tight loop. */
+inline void worker_pool::set_restart_delay(double t) {
+    restart_delay_ = t;
+}
+
+/** @brief  Return the seconds workers get to drain before being killed. */
+inline double worker_pool::drain_timeout() const {
+    return drain_timeout_;
+}
+
+inline void worker_pool::set_drain_timeout(double t) {
+    drain_timeout_ = t;
+}
+
+} // namespace tamer
+#endif /* TAMER_WORKERS_HH */
@@ -0,0 +1,208 @@
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include "config.h"
+#include <tamer/wscodec.hh>
+#include <string.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define TAMER_WSCODEC_X86 1
+# include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__ARM_NEON)
+# define TAMER_WSCODEC_NEON 1
+# include <arm_neon.h>
+#endif
+namespace tamer {
+namespace tamerpriv {
+namespace {
+
+void mask_scalar(unsigned char* x, size_t n, uint32_t mask) {
+    unsigned char mb[8];
+    memcpy(&mb[0], &mask, 4);
+    memcpy(&mb[4], &mask, 4);
+    uint64_t m8, z;
+    memcpy(&m8, mb, 8);
+    size_t i;
+    for (i = 0; i + 8 <= n; i += 8) {
+        memcpy(&z, &x[i], 8);
+        z ^= m8;
+        memcpy(&x[i], &z, 8);
+    }
+    for (; i < n; ++i)
+        x[i] ^= mb[i & 3];
+}
+
+const char* skip_ascii_scalar(const char* s, const char* last) {
+    uint64_t z;
+    for (; s + 8 <= last; s += 8) {
+        memcpy(&z, s, 8);
+        if (z & 0x8080808080808080ULL)
+            break;
+    }
+    while (s != last && (unsigned char) *s < 0x80)
+        ++s;
+    return s;
+}
+
+#if TAMER_WSCODEC_X86
+__attribute__((target("sse2")))
+void mask_sse2(unsigned char* x, size_t n, uint32_t mask) {
+    __m128i m = _mm_set1_epi32(mask);
+    size_t i;
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(x + i), _mm_xor_si128(v, m));
+    }
+    // i is a multiple of 4, so the key is back at its first byte
+    mask_scalar(x + i, n - i, mask);
+}
+
+__attribute__((target("sse2")))
+const char* skip_ascii_sse2(const char* s, const char* last) {
+    for (; s + 16 <= last; s += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+        if (int bits = _mm_movemask_epi8(v))
+            return s + __builtin_ctz(bits);
+    }
+    return skip_ascii_scalar(s, last);
+}
+
+__attribute__((target("avx2")))
+void mask_avx2(unsigned char* x, size_t n, uint32_t mask) {
+    __m256i m = _mm256_set1_epi32(mask);
+    size_t i;
+    for (i = 0; i + 64 <= n; i += 64) {
+        __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i));
+        __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(x + i), _mm256_xor_si256(v0, m));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(x + i + 32), _mm256_xor_si256(v1, m));
+    }
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(x + i), _mm256_xor_si256(v, m));
+    }
+    // avoid the AVX-SSE transition penalty in the scalar tail
+    _mm256_zeroupper();
+    mask_scalar(x + i, n - i, mask);
+}
+
+__attribute__((target("avx2")))
+const char* skip_ascii_avx2(const char* s, const char* last) {
+    for (; s + 32 <= last; s += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s));
+        if (unsigned bits = _mm256_movemask_epi8(v))
+            return s + __builtin_ctz(bits);
+    }
+    _mm256_zeroupper();
+    return skip_ascii_sse2(s, last);
+}
+
+const websocket_codec sse2_codec = {
+    "sse2", mask_sse2, skip_ascii_sse2
+};
+const websocket_codec avx2_codec = {
+    "avx2", mask_avx2, skip_ascii_avx2
+};
+#endif
+
+#if TAMER_WSCODEC_NEON
+void mask_neon(unsigned char* x, size_t n, uint32_t mask) {
+    unsigned char mb[16];
+    for (int j = 0; j != 16; j += 4)
+        memcpy(&mb[j], &mask, 4);
+    uint8x16_t m = vld1q_u8(mb);
+    size_t i;
+    for (i = 0; i + 16 <= n; i += 16)
+        vst1q_u8(x + i, veorq_u8(vld1q_u8(x + i), m));
+    mask_scalar(x + i, n - i, mask);
+}
+
+const char* skip_ascii_neon(const char* s, const char* last) {
+    for (; s + 16 <= last; s += 16) {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(s));
+        if (vmaxvq_u8(v) >= 0x80)
+            break;
+    }
+    return skip_ascii_scalar(s, last);
+}
+
+const websocket_codec neon_codec = {
+    "neon", mask_neon, skip_ascii_neon
+};
+#endif
+
+const websocket_codec& choose_codec() {
+#if TAMER_WSCODEC_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return avx2_codec;
+# if defined(__x86_64__)
+    return sse2_codec;
+# else
+    if (__builtin_cpu_supports("sse2"))
+        return sse2_codec;
+# endif
+#elif TAMER_WSCODEC_NEON
+    return neon_codec;
+#endif
+    return websocket_scalar_codec;
+}
+
+} // namespace
+
+const websocket_codec websocket_scalar_codec = {
+    "scalar", mask_scalar, skip_ascii_scalar
+};
+
+const websocket_codec& websocket_best_codec() {
+    static const websocket_codec& codec = choose_codec();
+    return codec;
+}
+
+bool websocket_validate_utf8(const char* first, const char* cur,
+                             const char* last, bool complete,
+                             const websocket_codec& codec) {
+    while (cur > first) {
+        --cur;
+        if (((unsigned char) *cur & 0xC0) != 0x80)
+            break;
+    }
+    int state = 0;
+    while (cur < last) {
+        int ch = (unsigned char) *cur;
+        if (state == 0 && ch <= 127) {
+            cur = codec.skip_ascii(cur + 1, last);
+            continue;
+        }
+        if ((state == 0) != ((ch & 0xC0) != 0x80)
+            || ch == 0xC0
+            || ch == 0xC1
+            || ch >= 0xF5
+            || (state == 2 && ch < 0xA0 && (unsigned char) cur[-1] == 0xE0)
+            || (state == 2 && ch >= 0xA0 && (unsigned char) cur[-1] == 0xED)
+            || (state == 3 && ch < 0x90 && (unsigned char) cur[-1] == 0xF0)
+            || (state == 3 && ch >= 0x90 && (unsigned char) cur[-1] == 0xF4))
+            return false;
+        if (ch >= 0xF0)
+            state = 3;
+        else if (ch >= 0xE0)
+            state = 2;
+        else if (ch >= 0xC0)
+            state = 1;
+        else
+            --state;
+        ++cur;
+    }
+    return state == 0 || !complete;
+}
+
+} // namespace tamerpriv
+} // namespace tamer
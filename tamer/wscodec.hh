@@ -0,0 +1,39 @@
+#ifndef TAMER_WSCODEC_HH
+#define TAMER_WSCODEC_HH 1
+#include <stddef.h>
+#include <stdint.h>
+namespace tamer {
+namespace tamerpriv {
+
+// Payload loops for WebSocket frames. websocket_best_codec() picks the
+// fastest implementation this CPU supports; the scalar one is always
+// available.
+struct websocket_codec {
+    const char* name;
+    // XOR x[0, n) with the masking key whose bytes, in memory order,
+    // are those of mask.
+    void (*mask)(unsigned char* x, size_t n, uint32_t mask);
+    // Return the first byte in [s, last) that isn't ASCII, or last.
+    const char* (*skip_ascii)(const char* s, const char* last);
+};
+
+extern const websocket_codec websocket_scalar_codec;
+const websocket_codec& websocket_best_codec();
+
+inline void websocket_mask(unsigned char* x, size_t n, uint32_t mask) {
+    websocket_best_codec().mask(x, n, mask);
+}
+
+bool websocket_validate_utf8(const char* first, const char* cur,
+                             const char* last, bool complete,
+                             const websocket_codec& codec);
+
+inline bool websocket_validate_utf8(const char* first, const char* cur,
+                                    const char* last, bool complete) {
+    return websocket_validate_utf8(first, cur, last, complete,
+                                   websocket_best_codec());
+}
+
+} // namespace tamerpriv
+} // namespace tamer
+#endif /* TAMER_WSCODEC_HH */
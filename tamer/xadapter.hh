@@ -36,6 +36,38 @@ class with_helper_rendezvous : public functional_rendezvous,
     static void hook(functional_rendezvous *fr, simple_event *, bool) TAMER_NOEXCEPT;
 };
 
+inline timeval deadline_after(timeval delay) {
+    timeval tv = tamer::recent();
+    if (delay.tv_sec > 0 || (delay.tv_sec == 0 && delay.tv_usec > 0)) {
+        timeradd(&tv, &delay, &tv);
+        if (unsigned slack = driver::main->timer_slack_usec())
+            apply_timer_slack(tv, slack);
+    }
+    return tv;
+}
+
+inline timeval deadline_after(double delay) {
+    timeval tv = { 0, 0 };
+    if (delay > 0) {
+        tv.tv_sec = (long) delay;
+        tv.tv_usec = (long) ((delay - tv.tv_sec) * 1000000 + 0.5);
+        if (tv.tv_usec >= 1000000) {
+            ++tv.tv_sec;
+            tv.tv_usec -= 1000000;
+        }
+    }
+    return deadline_after(tv);
+}
+
+inline timeval deadline_after_msec(int delay) {
+    timeval tv = { 0, 0 };
+    if (delay > 0) {
+        tv.tv_sec = delay / 1000;
+        tv.tv_usec = (delay % 1000) * 1000;
+    }
+    return deadline_after(tv);
+}
+
 template <typename... TS>
 inline event<> with_helper(event<TS...> e, int *result, int value) {
     with_helper_rendezvous *r = new with_helper_rendezvous(e.__get_simple(), result, value);
@@ -15,13 +15,17 @@
 #include <tamer/tamer.hh>
 #include <tamer/adapter.hh>
 #include <stdio.h>
+#include <stdlib.h>
+#include <new>
 #include <sstream>
 
 namespace tamer {
 namespace tamerpriv {
 
 simple_driver::simple_driver()
-    : ccap_(0), cfree_(1), cunblocked_(0), cunblocked_tail_(0), cs_() {
+    : ccap_(0), cfree_(1), nunblocked_(0), low_budget_(64), cs_() {
+    for (int p = 0; p != npriority; ++p)
+        cunblocked_[p] = cunblocked_tail_[p] = 0;
     grow();
 }
 
@@ -62,6 +66,20 @@ void blocking_rendezvous::hard_free() TAMER_NOEXCEPT {
     blocked_closure_->unblock();
 }
 
+#if TAMER_CLOSURE_POOL
+TAMER_THREAD_LOCAL closure_pool closure_pool::local;
+closure_allocator_type closure_pool::allocate_hook;
+closure_deallocator_type closure_pool::deallocate_hook;
+
+/* Bytes of freed closures kept on the freelists. */
+size_t closure_pool::cached_bytes() const {
+    size_t n = 0;
+    for (unsigned c = 0; c != nclasses; ++c)
+        n += size_t(nfree_[c]) * ((c + 1) << quantum_shift);
+    return n;
+}
+#endif
+
 std::string closure::location() const {
 #if !TAMER_NOTRACE
     std::stringstream buf;
@@ -112,6 +130,11 @@ void simple_event::simple_trigger(simple_event *x, bool values) TAMER_NOEXCEPT {
     bool reduce_refcount = x->_refcount > 0;
 
     if (r) {
+#if TAMER_PROFILE
+        if (x->profile_start_)
+            profile_record(x->file_annotation_, x->line_annotation_,
+                           x->profile_start_);
+#endif
         // See also trigger_list_for_remove(), trigger_for_unuse().
         x->_r = 0;
         *x->_r_pprev = x->_r_next;
@@ -147,12 +170,14 @@ void simple_event::simple_trigger(simple_event *x, bool values) TAMER_NOEXCEPT {
     }
 
     if (r && x->at_trigger_f_) {
-        if (x->at_trigger_f_ == trigger_hook) {
+        void (*f)(void*) = x->at_trigger_f_;
+        x->at_trigger_f_ = 0;
+        if (f == trigger_hook) {
             x = static_cast<simple_event*>(x->at_trigger_arg_);
             values = false;
             goto retry;
         } else
-            x->at_trigger_f_(x->at_trigger_arg_);
+            f(x->at_trigger_arg_);
     }
 
     while ((x = to_delete)) {
@@ -168,8 +193,10 @@ void simple_event::trigger_list_for_remove() TAMER_NOEXCEPT {
         e->_r = 0;
     // then call any left-behind at_triggers
     for (simple_event *e = this; e; e = e->_r_next)
-        if (e->at_trigger_f_)
-            e->at_trigger_f_(e->at_trigger_arg_);
+        if (void (*f)(void*) = e->at_trigger_f_) {
+            e->at_trigger_f_ = 0;
+            f(e->at_trigger_arg_);
+        }
 }
 
 void simple_event::trigger_hook(void* arg) {
@@ -202,6 +229,27 @@ void simple_event::hard_at_trigger(simple_event* x, void (*f)(void*),
         f(arg);
 }
 
+TAMER_THREAD_LOCAL size_t slab_bytes;
+
+void* slab_refill(void*& freelist, size_t size) {
+    // Carve a cache-line-aligned block into objects. Blocks are never
+    // returned to the system; freed objects go back on the freelist and
+    // are reused most-recent-first, while still hot in cache.
+    enum { block_size = 16384 };
+    void* block;
+    assert(size <= block_size / 16);
+    if (posix_memalign(&block, 64, block_size) != 0)
+        throw std::bad_alloc();
+    slab_bytes += block_size;
+    char* first = static_cast<char*>(block);
+    for (char* p = first + (block_size / size - 1) * size;
+         p != first; p -= size) {
+        *reinterpret_cast<void**>(p) = freelist;
+        freelist = p;
+    }
+    return first;
+}
+
 
 namespace message {
 
@@ -220,6 +268,15 @@ void event_prematurely_dereferenced(simple_event* se, abstract_rendezvous* r) {
 } // namespace tamer::tamerpriv::message
 } // namespace tamer::tamerpriv
 
+#if TAMER_CLOSURE_POOL
+void set_closure_allocator(void* (*allocator)(size_t),
+                           void (*deallocator)(void*, size_t)) {
+    assert(!allocator == !deallocator);
+    tamerpriv::closure_pool::allocate_hook = allocator;
+    tamerpriv::closure_pool::deallocate_hook = deallocator;
+}
+#endif
+
 void rendezvous<>::clear() {
     abstract_rendezvous::remove_waiting();
     explicit_rendezvous::remove_ready();
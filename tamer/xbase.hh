@@ -13,8 +13,10 @@
  * notice is a summary of the Tamer LICENSE file; the license in that file is
  * legally binding.
  */
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <stdint.h>
 #include <assert.h>
 #include <tamer/autoconf.h>
@@ -48,6 +50,12 @@ enum rendezvous_flags {
     rvolatile
 };
 
+enum priority_class {
+    priority_high,
+    priority_normal,
+    priority_low
+};
+
 namespace tamerpriv {
 
 class simple_event;
@@ -56,6 +64,53 @@ class blocking_rendezvous;
 class explicit_rendezvous;
 class closure;
 
+void* slab_refill(void*& freelist, size_t size);
+extern TAMER_THREAD_LOCAL size_t slab_bytes;
+
+#if TAMER_PROFILE
+extern TAMER_THREAD_LOCAL unsigned profile_countdown;
+uint64_t profile_sample();
+void profile_record(const char* file, int line, uint64_t start);
+
+// Zero unless this event was picked to be timed; see tamer::profile_start.
+inline uint64_t profile_begin() {
+    return profile_countdown && --profile_countdown == 0 ? profile_sample() : 0;
+}
+#endif
+
+template <size_t N>
+class slab_allocator {
+  public:
+    // Objects up to a cache line are padded to a power of two so none
+    // straddles a line boundary.
+    static const size_t size = N <= 16 ? 16 : N <= 32 ? 32 : (N + 63) & ~size_t(63);
+    // Larger objects, such as big rendezvous IDs, come from operator new.
+    static const bool pooled = size <= 1024;
+
+    static inline void* allocate() {
+        if (!pooled)
+            return ::operator new(N);
+        else if (void* p = free_) {
+            free_ = *static_cast<void**>(p);
+            return p;
+        } else
+            return slab_refill(free_, size);
+    }
+    static inline void deallocate(void* p) TAMER_NOEXCEPT {
+        if (!pooled)
+            ::operator delete(p);
+        else {
+            *static_cast<void**>(p) = free_;
+            free_ = p;
+        }
+    }
+
+  private:
+    static TAMER_THREAD_LOCAL void* free_;
+};
+
+template <size_t N> TAMER_THREAD_LOCAL void* slab_allocator<N>::free_;
+
 class simple_event { public:
     // DO NOT derive from this class!
 
@@ -90,19 +145,31 @@ class simple_event { public:
 
     static inline void at_trigger(simple_event* x, simple_event* at_trigger);
     static inline void at_trigger(simple_event* x, void (*f)(void*), void* arg);
+    static inline bool remove_at_trigger(simple_event* x, void (*f)(void*),
+                                         void* arg);
+
+    static inline void* operator new(size_t size);
+    static inline void operator delete(void* p) TAMER_NOEXCEPT;
 
   protected:
     abstract_rendezvous *_r;
     uintptr_t _rid;
     simple_event* _r_next;
     simple_event** _r_pprev;
-    void (*at_trigger_f_)(void*);
-    void* at_trigger_arg_;
     unsigned _refcount;
 #if !TAMER_NOTRACE
     int line_annotation_;
+#endif
+    // A single at_trigger lives here; a second combines both into an
+    // event, called through trigger_hook.
+    void (*at_trigger_f_)(void*);
+    void* at_trigger_arg_;
+#if !TAMER_NOTRACE
     const char* file_annotation_;
 #endif
+#if TAMER_PROFILE
+    uint64_t profile_start_;
+#endif
 
     simple_event(const simple_event &);
     simple_event &operator=(const simple_event &);
@@ -126,7 +193,8 @@ enum rendezvous_type {
 class abstract_rendezvous {
   public:
     abstract_rendezvous(rendezvous_flags flags, rendezvous_type rtype) TAMER_NOEXCEPT
-        : waiting_(0), rtype_(rtype), is_volatile_(flags == rvolatile) {
+        : waiting_(0), rtype_(rtype), is_volatile_(flags == rvolatile),
+          priority_(priority_normal) {
     }
 #if TAMER_DEBUG
     inline ~abstract_rendezvous() TAMER_NOEXCEPT;
@@ -143,10 +211,18 @@ class abstract_rendezvous {
         is_volatile_ = v;
     }
 
+    inline priority_class priority() const {
+        return priority_class(priority_);
+    }
+    inline void set_priority(priority_class p) {
+        priority_ = p;
+    }
+
   protected:
     simple_event *waiting_;
     uint8_t rtype_;
     bool is_volatile_;
+    uint8_t priority_;
 
     inline void remove_waiting() TAMER_NOEXCEPT;
 
@@ -164,16 +240,20 @@ class simple_driver {
     ~simple_driver();
 
     inline void add_blocked(closure* c);
-    inline void make_unblocked(closure* c);
+    inline void make_unblocked(closure* c, priority_class p);
 
-    inline closure* pop_unblocked();
+    inline closure* pop_unblocked(priority_class maxp);
 
     inline unsigned nclosure_slots() const;
     inline closure* closure_slot(unsigned i) const;
 
   public:
     inline bool has_unblocked() const;
-    inline void run_unblocked();
+    inline unsigned nunblocked() const;
+    inline unsigned run_unblocked();
+
+    inline unsigned low_priority_budget() const;
+    inline void set_low_priority_budget(unsigned n);
 
     static simple_driver immediate_driver;
 
@@ -183,12 +263,17 @@ class simple_driver {
         unsigned next;
     };
 
+    enum { npriority = priority_low + 1 };
+
     unsigned ccap_;
     mutable unsigned cfree_;
-    mutable unsigned cunblocked_;
-    unsigned cunblocked_tail_;
+    mutable unsigned cunblocked_[npriority];
+    unsigned cunblocked_tail_[npriority];
+    mutable unsigned nunblocked_;
+    unsigned low_budget_;
     cptr* cs_;
 
+    inline unsigned first_unblocked(int p) const;
     void add(closure* c);
     void grow();
 
@@ -315,10 +400,118 @@ class closure {
 
     inline void exit_at_destroy(tamed_class* k);
 
-    inline void unblock();
+    inline void unblock(priority_class p = priority_normal);
 };
 
 
+#if TAMER_CLOSURE_POOL
+typedef void* (*closure_allocator_type)(size_t size);
+typedef void (*closure_deallocator_type)(void* p, size_t size);
+
+class closure_pool {
+  public:
+    inline void* allocate(size_t size);
+    inline void deallocate(void* p, size_t size);
+
+    inline size_t live_bytes() const;
+    size_t cached_bytes() const;
+
+    static TAMER_THREAD_LOCAL closure_pool local;
+    static closure_allocator_type allocate_hook;
+    static closure_deallocator_type deallocate_hook;
+
+  private:
+    enum { quantum_shift = 4, nclasses = 32, max_cached = 256 };
+    struct link {
+        link* next;
+    };
+    link* free_[nclasses];
+    unsigned nfree_[nclasses];
+    size_t live_;               // bytes handed out and not yet returned
+
+    static inline unsigned size_class(size_t size) {
+        return (size - 1) >> quantum_shift;
+    }
+    static inline size_t class_size(size_t size) {
+        unsigned c = size_class(size);
+        return c < nclasses ? size_t(c + 1) << quantum_shift : size;
+    }
+};
+
+inline size_t closure_pool::live_bytes() const {
+    return live_;
+}
+
+inline void* closure_pool::allocate(size_t size) {
+    live_ += class_size(size);
+    if (allocate_hook)
+        return allocate_hook(size);
+    unsigned c = size_class(size);
+    if (c < nclasses && free_[c]) {
+        link* l = free_[c];
+        free_[c] = l->next;
+        --nfree_[c];
+        return l;
+    } else if (c < nclasses)
+        return ::operator new((c + 1) << quantum_shift);
+    else
+        return ::operator new(size);
+}
+
+inline void closure_pool::deallocate(void* p, size_t size) {
+    live_ -= class_size(size);
+    if (deallocate_hook)
+        return deallocate_hook(p, size);
+    unsigned c = size_class(size);
+    if (c < nclasses && nfree_[c] < max_cached) {
+        link* l = static_cast<link*>(p);
+        l->next = free_[c];
+        free_[c] = l;
+        ++nfree_[c];
+    } else
+        ::operator delete(p);
+}
+#endif
+
+template <typename T>
+inline T* allocate_closure() {
+#if TAMER_CLOSURE_POOL
+    return static_cast<T*>(closure_pool::local.allocate(sizeof(T)));
+#else
+    return std::allocator<T>().allocate(1);
+#endif
+}
+
+template <typename T>
+inline void free_closure(T* c) {
+#if TAMER_CLOSURE_POOL
+    c->~T();
+    closure_pool::local.deallocate(c, sizeof(T));
+#else
+    delete c;
+#endif
+}
+
+// Holds the closure of a tamed function that cannot block. The closure
+// lives in the wrapper's frame and dies when the wrapper returns.
+template <typename T>
+class stack_closure {
+  public:
+    inline stack_closure() {
+    }
+    inline ~stack_closure() {
+        get()->~T();
+    }
+    inline T* get() {
+        return reinterpret_cast<T*>(&space_);
+    }
+  private:
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type space_;
+
+    stack_closure(const stack_closure<T>&);
+    stack_closure<T>& operator=(const stack_closure<T>&);
+};
+
 template <typename T>
 class closure_owner {
   public:
@@ -326,7 +519,8 @@ class closure_owner {
         : c_(&c) {
     }
     inline ~closure_owner() {
-        delete c_;
+        if (c_)
+            free_closure(c_);
     }
     inline void reset() {
         c_ = 0;
@@ -372,32 +566,79 @@ inline abstract_rendezvous::~abstract_rendezvous() TAMER_NOEXCEPT {
 #endif
 
 
+inline unsigned simple_driver::first_unblocked(int p) const {
+    unsigned& head = cunblocked_[p];
+    while (head && !cs_[head].c) {
+        unsigned next = cs_[head].next;
+        cs_[head].next = cfree_;
+        cfree_ = head;
+        head = next;
+        --nunblocked_;
+    }
+    return head;
+}
+
 inline bool simple_driver::has_unblocked() const {
-    while (cunblocked_ && !cs_[cunblocked_].c) {
-        unsigned next = cs_[cunblocked_].next;
-        cs_[cunblocked_].next = cfree_;
-        cfree_ = cunblocked_;
-        cunblocked_ = next;
-    }
-    return cunblocked_ != 0;
-}
-
-inline closure* simple_driver::pop_unblocked() {
-    if (has_unblocked()) {
-        unsigned i = cunblocked_;
-        closure* c = cs_[i].c;
-        cunblocked_ = cs_[i].next;
-        cs_[i].c = 0;
-        cs_[i].next = cfree_;
-        cfree_ = i;
-        return c;
-    } else
-        return 0;
+    for (int p = 0; p != npriority; ++p)
+        if (first_unblocked(p))
+            return true;
+    return false;
+}
+
+inline closure* simple_driver::pop_unblocked(priority_class maxp) {
+    for (int p = 0; p <= maxp; ++p)
+        if (unsigned i = first_unblocked(p)) {
+            closure* c = cs_[i].c;
+            cunblocked_[p] = cs_[i].next;
+            cs_[i].c = 0;
+            cs_[i].next = cfree_;
+            cfree_ = i;
+            --nunblocked_;
+            return c;
+        }
+    return 0;
+}
+
+/** @brief Return the number of closures waiting to run.
+
+    May include closures destroyed since they were unblocked. */
+inline unsigned simple_driver::nunblocked() const {
+    return nunblocked_;
 }
 
-inline void simple_driver::run_unblocked() {
-    while (closure* c = pop_unblocked())
+/** @brief Run unblocked closures, highest priority first.
+
+    Runs every high- and normal-priority closure, including those they
+    unblock, but at most low_priority_budget() low-priority closures.
+    Low-priority closures left over wait for the next pass, which comes
+    after the driver polls for I/O without blocking. */
+inline unsigned simple_driver::run_unblocked() {
+    unsigned n = 0, nlow = 0;
+    while (1) {
+        closure* c = pop_unblocked(priority_normal);
+        if (!c) {
+            if (nlow == low_budget_ || !(c = pop_unblocked(priority_low)))
+                break;
+            ++nlow;
+        }
         c->tamer_activator_(c);
+        ++n;
+    }
+    return n;
+}
+
+/** @brief Return the low-priority closures run per pass. */
+inline unsigned simple_driver::low_priority_budget() const {
+    return low_budget_;
+}
+
+/** @brief Set the low-priority closures run per pass to @a n.
+
+    The budget also limits low-priority asap events. @a n must be
+    positive. */
+inline void simple_driver::set_low_priority_budget(unsigned n) {
+    assert(n > 0);
+    low_budget_ = n;
 }
 
 inline void simple_driver::add_blocked(closure* c) {
@@ -408,14 +649,15 @@ inline void simple_driver::add_blocked(closure* c) {
 #endif
 }
 
-inline void simple_driver::make_unblocked(closure* c) {
+inline void simple_driver::make_unblocked(closure* c, priority_class p) {
     if (!c->tamer_driver_index_)
         add(c);
-    if (cunblocked_)
-        cs_[cunblocked_tail_].next = c->tamer_driver_index_;
+    if (cunblocked_[p])
+        cs_[cunblocked_tail_[p]].next = c->tamer_driver_index_;
     else
-        cunblocked_ = c->tamer_driver_index_;
-    cunblocked_tail_ = c->tamer_driver_index_;
+        cunblocked_[p] = c->tamer_driver_index_;
+    cunblocked_tail_[p] = c->tamer_driver_index_;
+    ++nunblocked_;
 }
 
 inline unsigned simple_driver::nclosure_slots() const {
@@ -451,11 +693,11 @@ inline void blocking_rendezvous::block(simple_driver* driver, closure& c,
     driver->add_blocked(&c);
 }
 
-inline void closure::unblock() {
+inline void closure::unblock(priority_class p) {
     if (simple_driver* d = tamer_blocked_driver_) {
         tamer_blocked_driver_ = 0;
         if (d != &simple_driver::immediate_driver)
-            d->make_unblocked(this);
+            d->make_unblocked(this, p);
         else
             tamer_activator_(this);
     }
@@ -464,7 +706,7 @@ inline void closure::unblock() {
 inline void blocking_rendezvous::unblock() {
     if (closure* cl = blocked_closure_) {
         blocked_closure_ = 0;
-        cl->unblock();
+        cl->unblock(priority_class(priority_));
     }
 }
 
@@ -519,18 +761,26 @@ inline std::string closure::description() const {
 
 
 inline simple_event::simple_event() TAMER_NOEXCEPT
-    : _r(0), _refcount(1) TAMER_IFTRACE(, file_annotation_(0)) {
+    : _r(0), _refcount(1), at_trigger_f_(0)
+      TAMER_IFTRACE(, file_annotation_(0)) {
+#if TAMER_PROFILE
+    profile_start_ = 0;
+#endif
 }
 
 inline simple_event::simple_event(abstract_rendezvous& r, uintptr_t rid,
                                   const char* file, int line) TAMER_NOEXCEPT
     : _r(&r), _rid(rid), _r_next(r.waiting_), _r_pprev(&r.waiting_),
-      at_trigger_f_(0), at_trigger_arg_(0), _refcount(1)
-      TAMER_IFTRACE(, line_annotation_(line), file_annotation_(file)) {
+      _refcount(1) TAMER_IFTRACE(, line_annotation_(line)),
+      at_trigger_f_(0), at_trigger_arg_(0)
+      TAMER_IFTRACE(, file_annotation_(file)) {
     if (r.waiting_)
         r.waiting_->_r_pprev = &_r_next;
     r.waiting_ = this;
     TAMER_IFNOTRACE((void) file, (void) line);
+#if TAMER_PROFILE
+    profile_start_ = profile_begin();
+#endif
 #if TAMER_DEBUG > 1
     if (file && line)
         fprintf(stderr, "annotate simple_event(%p) %s:%d\n", this, file, line);
@@ -551,6 +801,14 @@ inline simple_event::~simple_event() TAMER_NOEXCEPT {
 }
 #endif
 
+inline void* simple_event::operator new(size_t) {
+    return slab_allocator<sizeof(simple_event)>::allocate();
+}
+
+inline void simple_event::operator delete(void* p) TAMER_NOEXCEPT {
+    slab_allocator<sizeof(simple_event)>::deallocate(p);
+}
+
 inline void simple_event::use(simple_event *e) TAMER_NOEXCEPT {
     if (e)
         ++e->_refcount;
@@ -632,6 +890,16 @@ inline void simple_event::at_trigger(simple_event* x, void (*f)(void*),
         hard_at_trigger(x, f, arg);
 }
 
+inline bool simple_event::remove_at_trigger(simple_event* x,
+                                            void (*f)(void*), void* arg) {
+    if (x->at_trigger_f_ == f && x->at_trigger_arg_ == arg) {
+        x->at_trigger_f_ = 0;
+        x->at_trigger_arg_ = 0;
+        return true;
+    } else
+        return false;
+}
+
 template <typename T> struct rid_cast {
     static inline uintptr_t in(T x) TAMER_NOEXCEPT {
         return static_cast<uintptr_t>(x);
@@ -14,20 +14,79 @@
  * legally binding.
  */
 #include <tamer/event.hh>
+#include <sys/types.h>
 #include <sys/time.h>
 #include <signal.h>
 #include <vector>
 #include <string>
+#include <atomic>
+#include <stdint.h>
 namespace tamer {
 namespace tamerpriv {
-extern struct timeval recent;
-extern bool need_recent;
+extern TAMER_THREAD_LOCAL struct timeval recent;
+extern TAMER_THREAD_LOCAL bool need_recent;
+
+// Round @a expiry up so that timers whose slack windows overlap share an
+// expiry and fire in one wakeup. The grid is the largest power of two
+// no greater than @a slack, in whole milliseconds when @a slack is at
+// least 1ms, so @a expiry moves by less than @a slack.
+inline void apply_timer_slack(timeval& expiry, unsigned slack) {
+    uint64_t grid;
+    if (slack >= 1000)
+        grid = uint64_t(1000) << (31 - __builtin_clz(slack / 1000));
+    else
+        grid = uint64_t(1) << (31 - __builtin_clz(slack));
+    uint64_t t = uint64_t(expiry.tv_sec) * 1000000 + expiry.tv_usec;
+    t = (t + grid - 1) / grid * grid;
+    expiry.tv_sec = t / 1000000;
+    expiry.tv_usec = t % 1000000;
+}
+
+struct post_node {
+    post_node* post_next_;
+    bool post_expected_;        // releases one driver::expect_post()
+    post_node()
+        : post_expected_(false) {
+    }
+    virtual ~post_node() {
+    }
+    virtual void post_run() = 0;
+};
+
+template <typename T = void>
+class event_post_node : public post_node {
+  public:
+    template <typename V>
+    inline event_post_node(event<T>&& e, V&& v)
+        : e_(std::move(e)), v_(std::forward<V>(v)) {
+    }
+    virtual void post_run() {
+        e_.trigger(TAMER_MOVE(v_));
+    }
+  private:
+    event<T> e_;
+    T v_;
+};
+
+template <>
+class event_post_node<void> : public post_node {
+  public:
+    inline event_post_node(event<>&& e)
+        : e_(std::move(e)) {
+    }
+    virtual void post_run() {
+        e_.trigger();
+    }
+  private:
+    event<> e_;
+};
 } // namespace tamerpriv
 
 enum loop_flags {
     loop_default = 0,
     loop_forever = 0,
-    loop_once = 1
+    loop_once = 1,
+    loop_busy_poll = 2
 };
 
 enum signal_flags {
@@ -35,6 +94,47 @@ enum signal_flags {
     signal_background = 1
 };
 
+/** @brief  Event-loop counters for one driver.
+ *
+ *  Collected only after driver::enable_stats(), and only by the tamer and
+ *  io_uring drivers. Times are in seconds. */
+struct driver_stats {
+    enum phase {
+        phase_fd = 0,           // file descriptor and cross-thread events
+        phase_timer = 1,
+        phase_asap = 2,
+        phase_preblock = 3,
+        nphases = 4
+    };
+    enum { nlag = 20 };
+
+    uint64_t loops;             // trips through the loop
+    double block_time;          // waiting in epoll_wait, select, or io_uring
+    double run_time;            // everything else, mostly running closures
+    uint64_t fd_events;         // readiness notifications from the kernel
+    uint64_t resumed[nphases];  // closures resumed, by phase
+    size_t nasap;               // queued asap events and timers, including
+    size_t ntimers;             //   canceled ones not yet removed
+    size_t nunblocked;          // closures waiting to run
+    // Loop lag: how long each trip ran before the driver could wait for
+    // events again. lag[0] counts trips under 1 usec, lag[i] those in
+    // [2^(i-1), 2^i) usec, and lag[nlag - 1] everything longer.
+    uint64_t lag[nlag];
+    double max_lag;
+    double avg_lag;             // moving average, weighting recent trips
+};
+
+// Bytes held by one driver and by its thread's allocators. The driver
+// fields cover allocated capacity, including space that is free for reuse.
+struct driver_memory {
+    size_t fd_table;            // per-descriptor driver state
+    size_t timers;              // timer heap and timing wheel
+    size_t asap;                // asap and preblock queues
+    size_t small_objects;       // slabs for events and other small objects
+    size_t closures;            // live closures from the closure pool
+    size_t closure_cache;       // freed closures kept for reuse
+};
+
 class driver : public tamerpriv::simple_driver {
   public:
     driver();
@@ -48,9 +148,11 @@ class driver : public tamerpriv::simple_driver {
     enum { fdread = 0, fdwrite = 1 }; // the order is important
     virtual void at_fd(int fd, int action, event<int> e) = 0;
     virtual void at_time(const timeval& expiry, event<> e, bool bg) = 0;
-    virtual void at_asap(event<> e) = 0;
+    virtual void at_deadline(const timeval& expiry, event<> e, int& result);
+    virtual void at_asap(event<> e, priority_class p) = 0;
     virtual void at_preblock(event<> e) = 0;
     virtual void kill_fd(int fd) = 0;
+    virtual void note_would_block(int fd, int action);
 
     inline void at_fd(int fd, int action, event<> e);
     inline void at_fd_read(int fd, event<int> e);
@@ -58,6 +160,8 @@ class driver : public tamerpriv::simple_driver {
     inline void at_fd_write(int fd, event<int> e);
     inline void at_fd_write(int fd, event<> e);
 
+    inline void at_asap(event<> e);
+
     inline void at_time(const timeval& expiry, event<> e);
     inline void at_time(double expiry, event<> e, bool bg = false);
     inline void at_delay(timeval delay, event<> e, bool bg = false);
@@ -65,12 +169,18 @@ class driver : public tamerpriv::simple_driver {
     inline void at_delay_sec(int delay, event<> e, bool bg = false);
     inline void at_delay_msec(int delay, event<> e, bool bg = false);
     inline void at_delay_usec(int delay, event<> e, bool bg = false);
+    void at_delay_slack(double delay, event<> e, double slack, bool bg = false);
+
+    void set_timer_slack(double slack);
+    inline double timer_slack() const;
+    inline unsigned timer_slack_usec() const;
 
     static void at_signal(int signo, event<> e,
                           signal_flags flags = signal_default);
 
     typedef void (*error_handler_type)(int fd, int err, std::string msg);
     virtual void set_error_handler(error_handler_type errh);
+    virtual void set_busy_poll(int usec);
 
     virtual void loop(loop_flags flag) = 0;
     virtual void break_loop() = 0;
@@ -78,24 +188,65 @@ class driver : public tamerpriv::simple_driver {
 
     void blocked_locations(std::vector<std::string>& x);
 
+    void enable_stats(bool on = true);
+    inline bool stats_enabled() const;
+    virtual bool stats(driver_stats& st) const;
+    void reset_stats();
+    double loop_lag() const;
+    virtual void memory_usage(driver_memory& m) const;
+
+    void post(tamerpriv::post_node* n, bool expected = false);
+    inline void expect_post();
+    inline bool expects_post() const;
+    inline bool has_posted() const;
+    void run_posted();
+    inline int post_fd() const;
+    inline void refresh_post_fd(pid_t pid);
+
     static driver* make_tamer(int flags);
     static driver* make_libevent();
     static driver* make_libev();
+    static driver* make_uring(int flags = 0);
 
-    static driver* main;
+    static TAMER_THREAD_LOCAL driver* main;
 
     static volatile sig_atomic_t sig_any_active;
+    static driver* sig_driver;
+    inline bool owns_signals() const;
     static int sig_pipe[2];
+    static bool sig_use_fd;     // sig_pipe[0] is a signalfd
     static unsigned sig_nforeground;
     static unsigned sig_ntotal;
     void dispatch_signals();
+    static void sig_restore_mask();
+
+  protected:
+    inline void stats_wait_begin();
+    inline void stats_wait_end(unsigned nevents);
+    inline void stats_resumed(int phase, unsigned n);
 
   private:
     unsigned index_;
+    unsigned timer_slack_;      // usec
     std::tuple<int> int_placeholder_;
+    driver_stats* stats_;
+    double stats_mark_;
+    std::atomic<tamerpriv::post_node*> posted_;
+    std::atomic<bool> post_signaled_;
+    int post_fd_[2];
+    pid_t post_pid_;
+    unsigned npost_expected_;   // touched only by the owning thread
 
     static driver* indexed[capacity];
     static int next_index;
+
+    void make_post_fd();
+    void remake_post_fd();
+    void wake_post();
+    void record_wait_begin();
+    void record_wait_end(unsigned nevents);
+    inline void at_slack_time(timeval expiry, event<> e, bool bg,
+                              unsigned slack);
 };
 
 timeval now();
@@ -109,6 +260,74 @@ inline unsigned driver::index() const {
     return index_;
 }
 
+/** @brief  Keep this driver's loop running until an expected post arrives.
+ *
+ *  Call from the owning thread before handing an event to another thread.
+ *  The loop does not exit for lack of events until a matching
+ *  post_expected() has been delivered. */
+inline void driver::expect_post() {
+    ++npost_expected_;
+}
+
+inline bool driver::expects_post() const {
+    return npost_expected_ != 0;
+}
+
+inline bool driver::has_posted() const {
+    return posted_.load(std::memory_order_relaxed) != 0;
+}
+
+inline int driver::post_fd() const {
+    return post_fd_[0];
+}
+
+// A forked child shares its parent's wakeup fd, and either process could
+// swallow the other's wakeups; the child makes its own.
+inline void driver::refresh_post_fd(pid_t pid) {
+    if (pid != post_pid_)
+        remake_post_fd();
+}
+
+/** @brief  Return the default timer slack in seconds.
+ *  @sa set_timer_slack */
+inline double driver::timer_slack() const {
+    return timer_slack_ / 1000000.;
+}
+
+inline unsigned driver::timer_slack_usec() const {
+    return timer_slack_;
+}
+
+inline void driver::at_slack_time(timeval expiry, event<> e, bool bg,
+                                  unsigned slack) {
+    if (slack)
+        tamerpriv::apply_timer_slack(expiry, slack);
+    at_time(expiry, e, bg);
+}
+
+inline bool driver::owns_signals() const {
+    return !sig_driver || sig_driver == this;
+}
+
+inline bool driver::stats_enabled() const {
+    return stats_ != 0;
+}
+
+inline void driver::stats_wait_begin() {
+    if (stats_)
+        record_wait_begin();
+}
+
+inline void driver::stats_wait_end(unsigned nevents) {
+    if (stats_)
+        record_wait_end(nevents);
+}
+
+inline void driver::stats_resumed(int phase, unsigned n) {
+    if (stats_)
+        stats_->resumed[phase] += n;
+}
+
 inline void driver::at_fd(int fd, int action, event<> e) {
     at_fd(fd, action, event<int>(e, int_placeholder_));
 }
@@ -140,9 +359,13 @@ inline void driver::at_time(double expiry, event<> e, bool bg) {
     at_time(tv, e, bg);
 }
 
+inline void driver::at_asap(event<> e) {
+    at_asap(e, priority_normal);
+}
+
 inline void driver::at_delay(timeval delay, event<> e, bool bg) {
     timeradd(&delay, &recent(), &delay);
-    at_time(delay, e, bg);
+    at_slack_time(delay, e, bg, timer_slack_);
 }
 
 inline void driver::at_delay_sec(int delay, event<> e, bool bg) {
@@ -151,7 +374,7 @@ inline void driver::at_delay_sec(int delay, event<> e, bool bg) {
     else {
         timeval tv = recent();
         tv.tv_sec += delay;
-        at_time(tv, e, bg);
+        at_slack_time(tv, e, bg, timer_slack_);
     }
 }
 
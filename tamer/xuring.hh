@@ -0,0 +1,229 @@
+#ifndef TAMER_XURING_HH
+#define TAMER_XURING_HH 1
+/* Copyright (c) 2007-2015, Eddie Kohler
+ * Copyright (c) 2007, Regents of the University of California
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#if HAVE_LINUX_IO_URING_H && HAVE_SYS_SYSCALL_H && !TAMER_NOIOURING
+# include <linux/io_uring.h>
+# include <sys/syscall.h>
+# include <sys/mman.h>
+# include <sys/time.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <string.h>
+# include <errno.h>
+# include <stdint.h>
+# include <algorithm>
+# if defined(IORING_FEAT_EXT_ARG) && defined(__NR_io_uring_setup)
+#  define TAMER_HAVE_XURING 1
+# endif
+#endif
+
+#if TAMER_HAVE_XURING
+namespace tamer {
+namespace tamerpriv {
+
+// A minimal io_uring wrapper: just enough to submit requests and reap
+// completions, without depending on liburing. Used by the io_uring driver
+// and by the io_uring file I/O backend.
+class xuring {
+  public:
+    inline xuring();
+    inline ~xuring();
+
+    inline bool setup(unsigned entries);
+    inline bool ok() const {
+        return ringfd_ >= 0;
+    }
+    inline unsigned sq_entries() const {
+        return sqentries_;
+    }
+    inline int register_eventfd(int efd);
+
+    inline struct io_uring_sqe* get_sqe();
+    inline int enter(unsigned min_complete, const timeval* timeout);
+
+    inline struct io_uring_cqe* peek_cqe();
+    inline void advance_cqe();
+    inline unsigned ready_cqes() const;
+
+  private:
+    int ringfd_;
+    unsigned features_;
+    void* sqmap_;
+    size_t sqmapsz_;
+    void* cqmap_;
+    size_t cqmapsz_;
+    struct io_uring_sqe* sqes_;
+    size_t sqessz_;
+
+    unsigned* sqhead_;
+    unsigned* sqtail_;
+    unsigned sqmask_;
+    unsigned* sqarray_;
+    unsigned sqentries_;
+    unsigned sqlocal_;          // next tail to publish
+
+    unsigned* cqhead_;
+    unsigned* cqtail_;
+    unsigned cqmask_;
+    struct io_uring_cqe* cqes_;
+
+    inline void release();
+};
+
+inline xuring::xuring()
+    : ringfd_(-1), sqmap_(MAP_FAILED), cqmap_(MAP_FAILED),
+      sqes_((struct io_uring_sqe*) MAP_FAILED) {
+}
+
+inline xuring::~xuring() {
+    release();
+}
+
+inline void xuring::release() {
+    if (sqes_ != MAP_FAILED)
+        munmap(sqes_, sqessz_);
+    if (cqmap_ != MAP_FAILED && cqmap_ != sqmap_)
+        munmap(cqmap_, cqmapsz_);
+    if (sqmap_ != MAP_FAILED)
+        munmap(sqmap_, sqmapsz_);
+    if (ringfd_ >= 0)
+        close(ringfd_);
+    ringfd_ = -1;
+    sqmap_ = cqmap_ = MAP_FAILED;
+    sqes_ = (struct io_uring_sqe*) MAP_FAILED;
+}
+
+inline bool xuring::setup(unsigned entries) {
+    // setting up again replaces the ring, e.g. one inherited across fork
+    release();
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ringfd_ = syscall(__NR_io_uring_setup, entries, &p);
+    if (ringfd_ < 0)
+        return false;
+    fcntl(ringfd_, F_SETFD, FD_CLOEXEC);
+    features_ = p.features;
+    // We rely on timeouts passed to io_uring_enter (Linux 5.11).
+    if (!(features_ & IORING_FEAT_EXT_ARG)) {
+        release();
+        return false;
+    }
+
+    sqmapsz_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqmapsz_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (features_ & IORING_FEAT_SINGLE_MMAP)
+        sqmapsz_ = cqmapsz_ = std::max(sqmapsz_, cqmapsz_);
+    sqmap_ = mmap(0, sqmapsz_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ringfd_, IORING_OFF_SQ_RING);
+    if (sqmap_ == MAP_FAILED) {
+        release();
+        return false;
+    }
+    if (features_ & IORING_FEAT_SINGLE_MMAP)
+        cqmap_ = sqmap_;
+    else
+        cqmap_ = mmap(0, cqmapsz_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ringfd_, IORING_OFF_CQ_RING);
+    sqessz_ = p.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = (struct io_uring_sqe*) mmap(0, sqessz_, PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_POPULATE, ringfd_,
+                                        IORING_OFF_SQES);
+    if (cqmap_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+        release();
+        return false;
+    }
+
+    char* sq = static_cast<char*>(sqmap_);
+    sqhead_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    sqtail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    sqmask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    sqarray_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    sqentries_ = p.sq_entries;
+    sqlocal_ = *sqtail_;
+
+    char* cq = static_cast<char*>(cqmap_);
+    cqhead_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    cqtail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    cqmask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + p.cq_off.cqes);
+    return true;
+}
+
+inline int xuring::register_eventfd(int efd) {
+    // completions then bump @a efd, so a ring can be watched like any fd
+    int r = syscall(__NR_io_uring_register, ringfd_, IORING_REGISTER_EVENTFD,
+                    &efd, 1);
+    return r < 0 ? -errno : 0;
+}
+
+inline struct io_uring_sqe* xuring::get_sqe() {
+    if (sqlocal_ - __atomic_load_n(sqhead_, __ATOMIC_ACQUIRE) == sqentries_)
+        // submission queue full: hand what we have to the kernel
+        enter(0, 0);
+    if (sqlocal_ - __atomic_load_n(sqhead_, __ATOMIC_ACQUIRE) == sqentries_)
+        return 0;
+    unsigned idx = sqlocal_ & sqmask_;
+    struct io_uring_sqe* sqe = &sqes_[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqarray_[idx] = idx;
+    ++sqlocal_;
+    return sqe;
+}
+
+inline int xuring::enter(unsigned min_complete, const timeval* timeout) {
+    unsigned tail = *sqtail_;
+    unsigned to_submit = sqlocal_ - tail;
+    __atomic_store_n(sqtail_, sqlocal_, __ATOMIC_RELEASE);
+
+    unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    void* argp = 0;
+    size_t argsz = 0;
+    if (min_complete && timeout) {
+        ts.tv_sec = timeout->tv_sec;
+        ts.tv_nsec = timeout->tv_usec * 1000;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = reinterpret_cast<uintptr_t>(&ts);
+        flags |= IORING_ENTER_EXT_ARG;
+        argp = &arg;
+        argsz = sizeof(arg);
+    }
+    int r = syscall(__NR_io_uring_enter, ringfd_, to_submit, min_complete,
+                    flags, argp, argsz);
+    if (r < 0 && (errno == ETIME || errno == EINTR))
+        r = 0;
+    return r;
+}
+
+inline struct io_uring_cqe* xuring::peek_cqe() {
+    unsigned head = *cqhead_;
+    if (head == __atomic_load_n(cqtail_, __ATOMIC_ACQUIRE))
+        return 0;
+    return &cqes_[head & cqmask_];
+}
+
+inline void xuring::advance_cqe() {
+    __atomic_store_n(cqhead_, *cqhead_ + 1, __ATOMIC_RELEASE);
+}
+
+inline unsigned xuring::ready_cqes() const {
+    return __atomic_load_n(cqtail_, __ATOMIC_ACQUIRE) - *cqhead_;
+}
+
+} // namespace tamerpriv
+} // namespace tamer
+#endif
+#endif /* TAMER_XURING_HH */
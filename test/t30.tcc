@@ -0,0 +1,104 @@
+// -*- mode: c++ -*-
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <stdio.h>
+#include <signal.h>
+#include <string.h>
+#include <tamer/tamer.hh>
+#include <tamer/fd.hh>
+#include <tamer/bufferedio.hh>
+#include <tamer/connpool.hh>
+using namespace tamer;
+
+int naccepted = 0;
+
+tamed void serve(tamer::fd cfd) {
+    tvars { tamer::buffer buf; std::string str; int ret; }
+    while (cfd) {
+        twait { buf.take_until(cfd, '\n', 1024, str, make_event(ret)); }
+        if (ret != 0 || str.empty() || str == "close\n")
+            break;
+        twait { cfd.write(str, make_event(ret)); }
+    }
+    cfd.close();
+}
+
+tamed void server(tamer::fd listenfd) {
+    tvars { tamer::fd cfd; }
+    while (listenfd) {
+        twait { listenfd.accept(make_event(cfd)); }
+        if (!cfd)
+            break;
+        ++naccepted;
+        serve(cfd);
+    }
+}
+
+tamed void request(connection_pool& pool, struct in_addr addr, int port,
+                   std::string msg, event<> done) {
+    tvars { tamer::fd f; tamer::buffer buf; std::string str; int ret; }
+    twait { pool.acquire(addr, port, make_event(f)); }
+    assert(f);
+    twait { f.write(msg, make_event(ret)); }
+    if (msg != "close\n") {
+        twait { buf.take_until(f, '\n', 1024, str, make_event(ret)); }
+        printf("R: %s", str.c_str());
+    }
+    pool.release(addr, port, f);
+    done();
+}
+
+tamed void test(tamer::fd listenfd, int port) {
+    tvars { connection_pool pool(1, 0.5); struct in_addr addr; }
+    addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    twait { request(pool, addr, port, "a\n", make_event()); }
+    twait { request(pool, addr, port, "b\n", make_event()); }
+    printf("accepted %d, idle %u\n", naccepted, (unsigned) pool.nidle());
+
+    // one connection allowed, so the second request waits for the first
+    twait {
+        request(pool, addr, port, "c\n", make_event());
+        request(pool, addr, port, "d\n", make_event());
+    }
+    printf("accepted %d, idle %u\n", naccepted, (unsigned) pool.nidle());
+
+    // the server closes this one while it's idle
+    twait { request(pool, addr, port, "close\n", make_event()); }
+    twait { tamer::at_delay_msec(20, make_event()); }
+    printf("idle %u\n", (unsigned) pool.nidle());
+
+    twait { request(pool, addr, port, "e\n", make_event()); }
+    printf("accepted %d, idle %u\n", naccepted, (unsigned) pool.nidle());
+
+    pool.clear();
+    listenfd.close();
+}
+
+int main(int, char *[]) {
+    tamer::initialize();
+    signal(SIGPIPE, SIG_IGN);
+
+    tamer::fd listenfd = tamer::tcp_listen(0);
+    assert(listenfd);
+    struct sockaddr_in saddr;
+    socklen_t saddr_len = sizeof(saddr);
+    int r = getsockname(listenfd.fdnum(), (struct sockaddr*) &saddr, &saddr_len);
+    assert(r == 0);
+
+    server(listenfd);
+    test(listenfd, ntohs(saddr.sin_port));
+
+    tamer::loop();
+    tamer::cleanup();
+}
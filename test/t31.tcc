@@ -0,0 +1,71 @@
+// -*- mode: c++ -*-
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <tamer/tamer.hh>
+#include <tamer/fd.hh>
+using namespace tamer;
+
+tamed void test(const char* fname) {
+    tvars {
+        tamer::fd f;
+        struct stat st;
+        char a[6], b[6], c[20];
+        size_t na, nb, nc;
+        int ret;
+    }
+
+    twait { tamer::fd::open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0600,
+                            make_event(f)); }
+    assert(f);
+    // writes to a file complete in order, like writes to a socket
+    twait {
+        f.write("Hello, ", make_event());
+        f.write("world", make_event());
+        f.write("!\n", make_event());
+    }
+    twait { f.fstat(st, make_event(ret)); }
+    printf("fstat %d, size %d\n", ret, (int) st.st_size);
+    f.close();
+
+    twait { tamer::fd::open(fname, O_RDONLY, make_event(f)); }
+    assert(f);
+    twait {
+        f.read(a, 5, na, make_event(ret));
+        f.read(b, 5, nb, make_event());
+        f.read(c, sizeof(c), nc, make_event());
+    }
+    a[na] = b[nb] = 0;
+    printf("%s|%s|%.*s", a, b, (int) nc, c);
+    f.close();
+
+    twait { tamer::fd::open("/nonexistent/t31", O_RDONLY, make_event(f)); }
+    printf("missing %s\n", f.error() == -ENOENT ? "ENOENT" : "?");
+}
+
+int main(int, char *[]) {
+    char fname[] = "/tmp/tamer-t31.XXXXXX";
+    int tmp = mkstemp(fname);
+    assert(tmp >= 0);
+    close(tmp);
+
+    tamer::initialize();
+    test(fname);
+    tamer::loop();
+    tamer::cleanup();
+    unlink(fname);
+}
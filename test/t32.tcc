@@ -0,0 +1,78 @@
+// -*- mode: c++ -*-
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <tamer/tamer.hh>
+#include <tamer/fd.hh>
+#include <tamer/bufferedio.hh>
+using namespace tamer;
+
+static const char* const chunks[] = {
+    "ab\ncd", "efgh\n", "\005hel", "lo", "toolong\n", "xyz"
+};
+
+tamed void writer(tamer::fd wfd) {
+    tvars { unsigned i; }
+    for (i = 0; i != sizeof(chunks) / sizeof(chunks[0]); ++i) {
+        twait { wfd.write(chunks[i], make_event()); }
+        twait { tamer::at_delay_msec(5, make_event()); }
+    }
+    wfd.close();
+}
+
+tamed void reader(tamer::fd rfd) {
+    tvars {
+        tamer::buffer buf(8);
+        const char* data;
+        size_t len;
+        int ret;
+    }
+
+    // lines wrap around the end of an 8-byte ring
+    twait { buf.peek_until(rfd, '\n', 64, data, len, make_event(ret)); }
+    printf("%d [%.*s]\n", ret, (int) len - 1, data);
+    buf.consume(len);
+    twait { buf.peek_until(rfd, '\n', 64, data, len, make_event(ret)); }
+    printf("%d [%.*s]\n", ret, (int) len - 1, data);
+    buf.consume(len);
+
+    // length-prefixed frame
+    twait { buf.fill_at_least(rfd, 1, make_event(ret)); }
+    len = (unsigned char) *buf.peek(1);
+    twait { buf.fill_at_least(rfd, 1 + len, make_event(ret)); }
+    printf("%d frame [%.*s]\n", ret, (int) len, buf.peek(1 + len) + 1);
+    buf.consume(1 + len);
+
+    twait { buf.peek_until(rfd, '\n', 4, data, len, make_event(ret)); }
+    printf("%s\n", ret == -E2BIG ? "E2BIG" : "?");
+    buf.consume(8);
+
+    twait { buf.peek_until(rfd, '\n', 64, data, len, make_event(ret)); }
+    printf("%s, %zu buffered [%.*s]\n",
+           ret == tamer::outcome::closed ? "closed" : "?",
+           buf.size(), (int) buf.size(), buf.peek(buf.size()));
+    rfd.close();
+}
+
+int main(int, char *[]) {
+    tamer::initialize();
+    tamer::fd rfd, wfd;
+    int r = tamer::fd::pipe(rfd, wfd);
+    assert(r == 0);
+    writer(wfd);
+    reader(rfd);
+    tamer::loop();
+    tamer::cleanup();
+}
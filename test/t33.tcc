@@ -0,0 +1,58 @@
+// -*- mode: c++ -*-
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <stdio.h>
+#include <vector>
+#include <tamer/tamer.hh>
+#include <tamer/channel.hh>
+using tamer::bounded_channel;
+
+tamed void produce(bounded_channel<int>& c) {
+    tvars { int i; }
+    for (i = 0; i != 10; ++i) {
+        if (c.full())
+            printf("block %d\n", i);
+        twait { c.push(i, make_event()); }
+    }
+}
+
+tamed void consume(bounded_channel<int>& c) {
+    tvars { std::vector<int> v; size_t i; }
+    do {
+        twait { c.pop_many(8, make_event(v)); }
+        printf("batch");
+        for (i = 0; i != v.size(); ++i)
+            printf(" %d", v[i]);
+        printf("\n");
+        twait { tamer::at_delay_msec(10, make_event()); }
+    } while (v.back() != 9);
+
+    // a canceled push leaves nothing behind
+    for (i = 0; i != 4; ++i)
+        c.try_push(i);
+    twait { c.push(100, tamer::add_timeout(0.01, make_event())); }
+    printf("push wait %zu\n", c.push_wait_size());
+    twait { c.pop_many(8, make_event(v)); }
+    printf("last %d, size %zu, push wait %zu\n", v.back(), c.size(),
+           c.push_wait_size());
+}
+
+int main(int, char**) {
+    tamer::initialize();
+    bounded_channel<int> c(4);
+    produce(c);
+    consume(c);
+    tamer::loop();
+    tamer::cleanup();
+    printf("OK!\n");
+}
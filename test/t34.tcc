@@ -0,0 +1,53 @@
+// -*- mode: c++ -*-
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <tamer/tamer.hh>
+using namespace tamer;
+
+tamed void work() {
+    twait { tamer::at_delay_msec(10, make_event()); }
+    twait { tamer::at_asap(make_event()); }
+    twait { tamer::at_delay_msec(10, make_event()); }
+    twait { tamer::at_asap(make_event()); }
+    twait { tamer::at_preblock(make_event()); }
+}
+
+int main(int, char *[]) {
+    tamer::initialize();
+    driver_stats st;
+    printf("before %d\n", driver::main->stats(st));
+    driver::main->enable_stats();
+    work();
+    tamer::loop();
+
+    bool ok = driver::main->stats(st);
+    uint64_t nlag = 0;
+    for (int i = 0; i != driver_stats::nlag; ++i)
+        nlag += st.lag[i];
+    printf("after %d\n", ok);
+    printf("timer %llu, asap %llu, preblock %llu\n",
+           (unsigned long long) st.resumed[driver_stats::phase_timer],
+           (unsigned long long) st.resumed[driver_stats::phase_asap],
+           (unsigned long long) st.resumed[driver_stats::phase_preblock]);
+    printf("loops %s, lag %s, blocked %s\n",
+           st.loops >= 2 ? "ok" : "short",
+           nlag == st.loops ? "ok" : "mismatch",
+           st.block_time >= 0.015 ? "ok" : "short");
+
+    driver::main->reset_stats();
+    driver::main->stats(st);
+    printf("reset %llu\n", (unsigned long long) st.loops);
+    tamer::cleanup();
+}
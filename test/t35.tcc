@@ -0,0 +1,119 @@
+// -*- mode: c++ -*-
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+// Compiled with `tamer --coroutines`.
+#include <stdio.h>
+#include <string>
+#include <tamer/tamer.hh>
+using namespace tamer;
+
+tamed void sleeper(int n, event<int> done) {
+    tvars { int i; rendezvous<int> r; int x; }
+    for (i = 0; i < n; ++i)
+        twait { tamer::at_delay_msec(1, make_event()); }
+    tamer::at_delay_msec(2, make_event(r, 7));
+    twait(r, x);
+    done(i + x);
+}
+
+tamed void greet(const std::string& who, std::string& out, event<> done) {
+    twait { tamer::at_asap(make_event()); }
+    out = "hello " + who;
+    done();
+}
+
+tamed void no_block(int& x) {
+    ++x;
+}
+
+struct noisy {
+    ~noisy() {
+        printf("~noisy\n");
+    }
+};
+
+class C : public tamed_class {
+  public:
+    ~C() {
+        printf("~C\n");
+    }
+    tamed void m(event<> e);
+};
+
+tamed void C::m(event<> e) {
+    tvars { noisy nz; }
+    twait { tamer::at_delay(100, make_event()); }
+    printf("m not reached\n");
+    e();
+}
+
+C guard_obj;
+
+tamed void thrower(int x) {
+    tvars { tamer::destroy_guard g(&guard_obj); }
+    if (x)
+        throw x;
+}
+
+tamed void early(int x, event<int> done) {
+    twait { tamer::at_asap(make_event()); }
+    if (x) {
+        done(x);
+        return;
+    }
+    twait { tamer::at_asap(make_event()); }
+    done(-1);
+}
+
+int main(int, char**) {
+    tamer::initialize();
+    rendezvous<> rr;
+
+    int v = 0;
+    sleeper(3, make_event(rr, v));
+    std::string who = "world", s;
+    greet(who, s, make_event(rr));
+    while (rr.has_waiting())
+        tamer::once();
+    printf("sleeper %d, %s\n", v, s.c_str());
+
+    v = 0;
+    no_block(v);
+    printf("no_block %d\n", v);
+
+    C* c = new C;
+    event<> e = make_event(rr);
+    c->m(e);
+    delete c;
+    tamer::at_asap(make_event(rr));
+    tamer::once();
+    printf("event %s\n", e ? "live" : "dead");
+    e.unblock();
+
+    try {
+        thrower(1);
+    } catch (int x) {
+        printf("caught %d\n", x);
+    }
+    thrower(0);
+
+    int a = 0, b = 0;
+    early(5, make_event(rr, a));
+    early(0, make_event(rr, b));
+    while (rr.has_waiting())
+        tamer::once();
+    printf("early %d %d\n", a, b);
+
+    tamer::cleanup();
+    printf("OK\n");
+}
@@ -0,0 +1,104 @@
+// -*- mode: c++ -*-
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <stdio.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <tamer/tamer.hh>
+#include <tamer/fd.hh>
+using namespace tamer;
+
+static int port_of(const tamer::fd& f) {
+    struct sockaddr_in saddr;
+    socklen_t saddr_len = sizeof(saddr);
+    int r = getsockname(f.fdnum(), (struct sockaddr*) &saddr, &saddr_len);
+    assert(r == 0);
+    return ntohs(saddr.sin_port);
+}
+
+static bool check_flags(const std::vector<tamer::fd>& fds) {
+    for (size_t i = 0; i != fds.size(); ++i)
+        if (!(fcntl(fds[i].fdnum(), F_GETFL) & O_NONBLOCK)
+            || !(fcntl(fds[i].fdnum(), F_GETFD) & FD_CLOEXEC))
+            return false;
+    return true;
+}
+
+tamed void connect_n(int port, int n, std::vector<tamer::fd>& clients,
+                     event<> done) {
+    tvars { struct in_addr addr; int i; tamer::fd f; }
+    addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (i = 0; i != n; ++i) {
+        twait { tamer::tcp_connect(addr, port, make_event(f)); }
+        assert(f);
+        clients.push_back(f);
+    }
+    done();
+}
+
+tamed void drain(std::vector<tamer::fd>& group, size_t which, int& total,
+                 event<> done) {
+    tvars { std::vector<tamer::fd> fds; int r; size_t i; }
+    while (total < 6) {
+        twait { group[which].accept_many(16, fds, make_event(r)); }
+        if (r <= 0)
+            break;
+        total += r;
+    }
+    // the other listener is still waiting
+    for (i = 0; i != group.size(); ++i)
+        group[i].close();
+    done();
+}
+
+tamed void test() {
+    tvars {
+        tamer::fd listenfd;
+        std::vector<tamer::fd> clients, fds, group;
+        int port, r, total = 0;
+    }
+
+    listenfd = tamer::tcp_listen(0);
+    assert(listenfd);
+    port = port_of(listenfd);
+
+    twait { connect_n(port, 5, clients, make_event()); }
+    twait { listenfd.accept_many(3, fds, make_event(r)); }
+    printf("batch %d, size %u\n", r, (unsigned) fds.size());
+    twait { listenfd.accept_many(10, fds, make_event(r)); }
+    printf("batch %d, size %u, flags %s\n", r, (unsigned) fds.size(),
+           check_flags(fds) ? "ok" : "bad");
+    listenfd.close();
+    twait { listenfd.accept_many(10, fds, make_event(r)); }
+    printf("closed %s\n", r < 0 ? "error" : "ok?");
+
+    r = tamer::tcp_listen_group(0, 2, group);
+    printf("group %d, size %u, same port %s\n", r, (unsigned) group.size(),
+           group.size() == 2 && port_of(group[0]) == port_of(group[1])
+           ? "yes" : "no");
+    port = port_of(group[0]);
+    twait {
+        drain(group, 0, total, make_event());
+        drain(group, 1, total, make_event());
+        connect_n(port, 6, clients, make_event());
+    }
+    printf("group total %d\n", total);
+}
+
+int main(int, char *[]) {
+    tamer::initialize();
+    signal(SIGPIPE, SIG_IGN);
+    test();
+    tamer::loop();
+    tamer::cleanup();
+}
@@ -0,0 +1,93 @@
+// -*- mode: c++ -*-
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <tamer/tamer.hh>
+#include <tamer/fd.hh>
+using namespace tamer;
+
+enum { ndgrams = 100 };
+static char sbuf[ndgrams][16], rbuf[ndgrams][16];
+static datagram sdg[ndgrams], rdg[ndgrams];
+
+tamed void send_later(tamer::fd f, int n, struct sockaddr_in dst,
+                      event<int> done) {
+    tvars { int i; }
+    twait { tamer::at_delay_msec(10, make_event()); }
+    for (i = 0; i != n; ++i) {
+        sprintf(sbuf[i], "d%d", i);
+        sdg[i] = datagram(sbuf[i], strlen(sbuf[i]));
+        memcpy(&sdg[i].addr, &dst, sizeof(dst));
+        sdg[i].addrlen = sizeof(dst);
+    }
+    f.send_batch(sdg, n, done);
+}
+
+tamed void test() {
+    tvars {
+        tamer::fd a, b;
+        struct sockaddr_in sin;
+        socklen_t sinlen = sizeof(sin);
+        int r, s, i, total = 0;
+        bool ok = true;
+    }
+
+    a = tamer::fd::socket(AF_INET, SOCK_DGRAM, 0);
+    b = tamer::fd::socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    r = b.bind((struct sockaddr*) &sin, sizeof(sin));
+    assert(r == 0 && getsockname(b.fdnum(), (struct sockaddr*) &sin, &sinlen) == 0);
+    for (i = 0; i != ndgrams; ++i)
+        rdg[i] = datagram(rbuf[i], sizeof(rbuf[i]));
+
+    // recv_batch waits for the first datagram
+    twait {
+        send_later(a, 5, sin, make_event(s));
+        b.recv_batch(rdg, ndgrams, make_event(r));
+    }
+    printf("sent %d, received %d, first %.*s, last %.*s\n", s, r,
+           (int) rdg[0].length, (char*) rdg[0].data,
+           (int) rdg[r - 1].length, (char*) rdg[r - 1].data);
+
+    // batches larger than one system call
+    twait { send_later(a, ndgrams, sin, make_event(s)); }
+    while (total < s) {
+        twait { b.recv_batch(rdg + total, ndgrams - total, make_event(r)); }
+        if (r <= 0)
+            break;
+        total += r;
+    }
+    for (i = 0; i != total; ++i)
+        ok = ok && rdg[i].addrlen == sizeof(sin)
+            && rdg[i].addr.ss_family == AF_INET
+            && rdg[i].length == strlen(sbuf[i])
+            && memcmp(rdg[i].data, sbuf[i], rdg[i].length) == 0;
+    printf("sent %d, received %d, %s\n", s, total, ok ? "ok" : "bad");
+
+    b.close();
+    twait { b.recv_batch(rdg, ndgrams, make_event(r)); }
+    printf("closed %s\n", r < 0 ? "error" : "ok?");
+}
+
+int main(int, char *[]) {
+    tamer::initialize();
+    signal(SIGPIPE, SIG_IGN);
+    test();
+    tamer::loop();
+    tamer::cleanup();
+}
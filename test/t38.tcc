@@ -0,0 +1,110 @@
+// -*- mode: c++ -*-
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+#include <tamer/tamer.hh>
+#include <tamer/fd.hh>
+#include <tamer/workers.hh>
+using namespace tamer;
+
+enum { nconnections = 8 };
+
+static void reply(worker_pool& pool, tamer::fd c) {
+    char buf[16];
+    int n = sprintf(buf, "w%d\n", pool.index());
+    ssize_t r = ::write(c.fdnum(), buf, n);
+    (void) r;
+    c.close();
+}
+
+// worker 1 hands every connection to worker 0
+tamed void serve(worker_pool& pool) {
+    tvars { tamer::fd l = pool.listener(), c; int r; }
+    while (l) {
+        twait { l.accept(make_event(c)); }
+        if (c && pool.index() == 1) {
+            twait { pool.send_fd(0, c, make_event(r)); }
+            c.close();
+        } else if (c)
+            reply(pool, c);
+    }
+}
+
+tamed void receive(worker_pool& pool) {
+    tvars { tamer::fd c; }
+    while (1) {
+        twait { pool.receive_fd(make_event(c)); }
+        if (!c)
+            break;
+        reply(pool, c);
+    }
+}
+
+static void start_worker(worker_pool& pool, int index) {
+    // the first worker 0 crashes; its replacement serves
+    if (index == 0 && pool.restarts(0) == 0)
+        _exit(1);
+    serve(pool);
+    if (index == 0)
+        receive(pool);
+}
+
+// a plain blocking client, in its own process
+static void client(struct sockaddr_in sin, pid_t master) {
+    printf("client:");
+    for (int i = 0; i != nconnections; ++i) {
+        int s = socket(AF_INET, SOCK_STREAM, 0);
+        char buf[16];
+        ssize_t n = -1;
+        if (connect(s, (struct sockaddr*) &sin, sizeof(sin)) == 0)
+            n = read(s, buf, sizeof(buf) - 1);
+        buf[n > 0 ? n - 1 : 0] = 0;
+        printf(" %s", n > 0 ? buf : "?");
+        close(s);
+    }
+    printf("\n");
+    fflush(stdout);
+    kill(master, SIGTERM);
+    _exit(0);
+}
+
+int main(int, char *[]) {
+    tamer::initialize();
+    signal(SIGPIPE, SIG_IGN);
+
+    worker_pool pool(2);
+    pool.set_restart_delay(0.1);
+    pool.set_drain_timeout(5);
+    int li = pool.listen(0);
+    assert(li == 0);
+
+    struct sockaddr_in sin;
+    socklen_t sinlen = sizeof(sin);
+    getsockname(pool.listener(li).fdnum(), (struct sockaddr*) &sin, &sinlen);
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    pid_t master = getpid(), cpid = fork();
+    if (cpid == 0)
+        client(sin, master);
+
+    int r = pool.run(start_worker);
+    printf("run %d, restarts %u %u, running %d %d\n", r,
+           pool.restarts(0), pool.restarts(1), pool.pid(0), pool.pid(1));
+    int status;
+    waitpid(cpid, &status, 0);
+    tamer::cleanup();
+}
@@ -0,0 +1,67 @@
+// -*- mode: c++ -*-
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <tamer/tamer.hh>
+#include <tamer/adapter.hh>
+using namespace tamer;
+
+static std::vector<event<> > wakeups;
+
+tamed void mark() {
+    twait { tamer::at_preblock(make_event()); }
+    printf("| ");
+}
+
+tamed void waiter(const char* name, priority_class p) {
+    tvars { rendezvous<> r; }
+    r.set_priority(p);
+    wakeups.push_back(make_event(r));
+    twait(r);
+    printf("%s ", name);
+    // L0 marks where the next loop iteration starts
+    if (strcmp(name, "L0") == 0)
+        mark();
+}
+
+static void wake_all() {
+    std::vector<event<> > es;
+    es.swap(wakeups);
+    for (size_t i = 0; i != es.size(); ++i)
+        es[i]();
+}
+
+int main(int, char *[]) {
+    tamer::initialize();
+    driver::main->set_low_priority_budget(2);
+
+    waiter("L0", priority_low);
+    waiter("L1", priority_low);
+    waiter("L2", priority_low);
+    waiter("L3", priority_low);
+    waiter("N0", priority_normal);
+    waiter("H0", priority_high);
+    waiter("N1", priority_normal);
+    tamer::at_asap(fun_event(wake_all));
+
+    tamer::at_asap(fun_event(printf, "a0 "), priority_low);
+    tamer::at_asap(fun_event(printf, "a1 "), priority_low);
+    tamer::at_asap(fun_event(printf, "a2 "), priority_low);
+    tamer::at_asap(fun_event(printf, "ah "), priority_high);
+
+    tamer::loop();
+    printf("\n");
+    tamer::cleanup();
+}
@@ -0,0 +1,80 @@
+// -*- mode: c++ -*-
+/* Copyright (c) 2015, Eddie Kohler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Tamer LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Tamer LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+#include <tamer/tamer.hh>
+#include <tamer/fd.hh>
+#include <tamer/admission.hh>
+using namespace tamer;
+
+static admission_control ac(0.02);
+
+static void spin(double t) {
+    struct timeval start, now;
+    gettimeofday(&start, 0);
+    do {
+        gettimeofday(&now, 0);
+    } while ((now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1e6 < t);
+}
+
+tamed void serve(tamer::fd l, int n) {
+    tvars { tamer::fd c; }
+    while (n-- > 0) {
+        twait { ac.accept(l, make_event(c)); }
+        if (c) {
+            ssize_t w = ::write(c.fdnum(), "ok\n", 3);
+            (void) w;
+            c.close();
+        }
+    }
+}
+
+tamed void client(int port, int i, event<> done) {
+    tvars { tamer::fd c; char buf[16]; size_t len = 0; }
+    twait { tamer::tcp_connect(port, make_event(c)); }
+    twait { c.read(buf, sizeof(buf) - 1, len, make_event()); }
+    buf[len ? len - 1 : 0] = 0;
+    printf("client %d: %s\n", i, len ? buf : "?");
+    done();
+}
+
+tamed void test() {
+    tvars { tamer::fd l; struct sockaddr_in sin; socklen_t sinlen; int port; }
+    l = tamer::tcp_listen(0);
+    sinlen = sizeof(sin);
+    getsockname(l.fdnum(), (struct sockaddr*) &sin, &sinlen);
+    port = ntohs(sin.sin_port);
+    ac.set_rejection("busy\n");
+
+    // the first check enables statistics; lag counts after a loop trip
+    printf("overloaded %d\n", ac.overloaded());
+    twait { tamer::at_asap(make_event()); }
+    spin(0.05);
+    printf("overloaded %d\n", ac.overloaded());
+
+    // the first connection arrives during overload, the second after
+    serve(l, 1);
+    twait { client(port, 1, make_event()); }
+    twait { client(port, 2, make_event()); }
+    printf("rejected %d, paused %d\n", (int) ac.nrejected(), (int) ac.npaused());
+}
+
+int main(int, char *[]) {
+    tamer::initialize();
+    test();
+    tamer::loop();
+    tamer::cleanup();
+}
@@ -0,0 +1,73 @@
+// -*- mode: c++ -*-
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <tamer/tamer.hh>
+#include <tamer/fd.hh>
+using namespace tamer;
+
+enum { nwrites = 5 };
+
+tamed void drain(tamer::fd r, size_t filled, size_t expected, event<> done) {
+    tvars { std::string buf, got; size_t nread; int ret; }
+    buf.resize(65536);
+    while (got.size() < filled + expected) {
+        twait { r.read_once(&buf[0], buf.size(), nread, make_event(ret)); }
+        if (ret < 0)
+            break;
+        got.append(buf, 0, nread);
+        if (nread == 0)
+            break;
+    }
+    got.erase(0, filled);
+    printf("read %u bytes, prefix \"%s\", %s\n", (unsigned) got.size(),
+           got.substr(0, 9).c_str(),
+           got.find_first_not_of('x', 9) == std::string::npos ? "ok" : "bad");
+    done();
+}
+
+tamed void test() {
+    tvars {
+        tamer::fd r, w;
+        std::string big;
+        size_t filled = 0, nw[nwrites];
+        int ret[nwrites];
+        rendezvous<int> rv;
+        int which, n;
+    }
+    if (tamer::fd::pipe(r, w) < 0) {
+        printf("pipe failed\n");
+        return;
+    }
+
+    // fill the pipe so that every write below queues behind the first
+    {
+        char junk[4096];
+        memset(junk, 'j', sizeof(junk));
+        ssize_t x;
+        while ((x = ::write(w.fdnum(), junk, sizeof(junk))) > 0)
+            filled += x;
+    }
+
+    big = std::string(200000, 'x');
+    w.write("hel", 3, nw[0], make_event(rv, 0, ret[0]));
+    w.write("", 0, nw[1], make_event(rv, 1, ret[1]));
+    w.write("lo ", 3, nw[2], make_event(rv, 2, ret[2]));
+    w.write("", 0, nw[3], make_event(rv, 3, ret[3]));
+    w.write(big, nw[4], make_event(rv, 4, ret[4]));
+    drain(r, filled, 6 + big.size(), make_event(rv, -1));
+
+    for (n = 0; n != nwrites + 1; ++n) {
+        twait(rv, which);
+        if (which >= 0)
+            printf("write %d: ret %d, nwritten %u\n", which, ret[which],
+                   (unsigned) nw[which]);
+    }
+}
+
+int main(int, char *[]) {
+    tamer::initialize();
+    test();
+    tamer::loop();
+    tamer::cleanup();
+}
@@ -0,0 +1,118 @@
+// -*- mode: c++ -*-
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <tamer/tamer.hh>
+#include <tamer/fd.hh>
+using namespace tamer;
+
+static const char content[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+static int socket_pair(tamer::fd& a, tamer::fd& b) {
+    int s[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, s) < 0)
+        return -1;
+    a = tamer::fd(s[0]);
+    b = tamer::fd(s[1]);
+    a.make_nonblocking();
+    b.make_nonblocking();
+    return 0;
+}
+
+tamed void send_range(tamer::fd f, off_t offset, size_t size, event<> done) {
+    tvars { tamer::fd r, w; size_t nsent, nread; int ret; char buf[64]; }
+    if (tamer::fd::pipe(r, w) < 0) {
+        printf("pipe failed\n");
+        done();
+        return;
+    }
+    twait { w.sendfile(f, offset, size, nsent, make_event(ret)); }
+    w.close();
+    twait { r.read(buf, sizeof(buf) - 1, nread, make_event()); }
+    buf[nread] = 0;
+    printf("sendfile %d+%d: ret %d, nsent %d, \"%s\", file offset %d\n",
+           (int) offset, (int) size, ret, (int) nsent, buf,
+           (int) lseek(f.fdnum(), 0, SEEK_CUR));
+    done();
+}
+
+tamed void produce(tamer::fd w, size_t size, event<> done) {
+    tvars { std::string buf; size_t n; }
+    buf.resize(size);
+    for (n = 0; n != size; ++n)
+        buf[n] = 'a' + n % 23;
+    twait { w.write(buf, make_event()); }
+    w.close();
+    done();
+}
+
+tamed void consume(tamer::fd r, event<std::string> done) {
+    tvars { std::string got, buf; size_t nread; int ret; }
+    buf.resize(65536);
+    while (1) {
+        twait { r.read_once(&buf[0], buf.size(), nread, make_event(ret)); }
+        if (ret < 0 || nread == 0)
+            break;
+        got.append(buf, 0, nread);
+    }
+    done(got);
+}
+
+tamed void relay(tamer::fd src, tamer::fd dst, size_t size, size_t& nspliced,
+                 event<int> done) {
+    tvars { int ret; }
+    twait { tamer::fd::splice(src, dst, size, nspliced, make_event(ret)); }
+    // the consumer sees EOF once the splice is done
+    dst.close();
+    done(ret);
+}
+
+tamed void splice_sockets(size_t size) {
+    tvars {
+        tamer::fd a0, a1, b0, b1;
+        size_t nspliced = 0, i;
+        int ret;
+        std::string got;
+        bool ok = true;
+    }
+    if (socket_pair(a0, a1) < 0 || socket_pair(b0, b1) < 0) {
+        printf("socketpair failed\n");
+        return;
+    }
+    twait {
+        produce(a1, size, make_event());
+        relay(a0, b0, size, nspliced, make_event(ret));
+        consume(b1, make_event(got));
+    }
+    for (i = 0; i != got.size() && ok; ++i)
+        ok = got[i] == char('a' + i % 23);
+    printf("splice socket to socket: ret %d, nspliced %d, received %d, %s\n",
+           ret, (int) nspliced, (int) got.size(), ok ? "ok" : "bad");
+}
+
+tamed void test() {
+    tvars { tamer::fd f; FILE* tf; }
+    tf = tmpfile();
+    if (!tf || fwrite(content, 1, sizeof(content) - 1, tf) != sizeof(content) - 1) {
+        printf("tmpfile failed\n");
+        return;
+    }
+    fflush(tf);
+    f = tamer::fd(dup(fileno(tf)));
+    fclose(tf);
+    lseek(f.fdnum(), 0, SEEK_SET);
+
+    twait { send_range(f, 4, 6, make_event()); }
+    twait { send_range(f, 0, 3, make_event()); }
+    twait { send_range(f, 30, 10, make_event()); }
+    twait { send_range(f, 36, 5, make_event()); }
+    twait { splice_sockets(300000); }
+}
+
+int main(int, char *[]) {
+    tamer::initialize();
+    test();
+    tamer::loop();
+    tamer::cleanup();
+}
@@ -0,0 +1,63 @@
+// -*- mode: c++ -*-
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <tamer/tamer.hh>
+#include <tamer/fd.hh>
+#include <tamer/http.hh>
+using namespace tamer;
+
+static const char requests[] =
+    "GET /a?x=1 HTTP/1.1\r\nHost: one\r\n\r\n"
+    "POST /b HTTP/1.1\r\nHost: two\r\nContent-Length: 5\r\n\r\nhello"
+    "GET /c HTTP/1.1\r\nHost: three\r\nConnection: close\r\n\r\n";
+
+static void print_message(const char* what, const http_message& m) {
+    printf("%s: ok %d, %s %s, path %s, query \"%s\", host %s, body \"%s\"\n",
+           what, m.ok(), http_method_str(m.method()), m.url().c_str(),
+           m.url_path().c_str(), m.query().c_str(),
+           m.canonical_header(hh_host).c_str(), m.body().c_str());
+}
+
+tamed void test() {
+    tvars {
+        tamer::fd r, w;
+        tamer::http_parser hp(HTTP_REQUEST);
+        http_message m;
+        std::vector<http_message> ms;
+        size_t i;
+        int s[2];
+    }
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, s) < 0) {
+        printf("socketpair failed\n");
+        return;
+    }
+    r = tamer::fd(s[0]);
+    w = tamer::fd(s[1]);
+    r.make_nonblocking();
+    w.make_nonblocking();
+
+    // every request arrives with the first read
+    twait { w.write(requests, sizeof(requests) - 1, make_event()); }
+    w.close();
+
+    twait { hp.receive(r, make_event(m)); }
+    print_message("receive", m);
+    printf("buffered %s, keep-alive %d\n", hp.buffered() ? "yes" : "no",
+           hp.should_keep_alive());
+
+    twait { hp.receive_many(r, ms, make_event()); }
+    printf("receive_many: %u messages\n", (unsigned) ms.size());
+    for (i = 0; i != ms.size(); ++i)
+        print_message("  message", ms[i]);
+    printf("buffered %s, keep-alive %d\n", hp.buffered() ? "yes" : "no",
+           hp.should_keep_alive());
+}
+
+int main(int, char *[]) {
+    tamer::initialize();
+    test();
+    tamer::loop();
+    tamer::cleanup();
+}
@@ -0,0 +1,119 @@
+// -*- mode: c++ -*-
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <thread>
+#include <future>
+#include <tamer/tamer.hh>
+#include <tamer/sharded.hh>
+using namespace tamer;
+
+enum { nworkers = 2, nkeys = 40 };
+
+typedef std::map<std::string, int> table;
+
+struct shard_report {
+    unsigned driver_index;
+    int nkeys;
+    int marked;
+};
+
+static void worker(std::promise<driver*>* ready) {
+    tamer::initialize_thread();
+    ready->set_value(driver::main);
+    // serve shard calls until the main thread posts the stop
+    tamer::expect_post();
+    tamer::loop();
+    tamer::cleanup();
+}
+
+static void increment(sharded<table>& t, const std::string& key, event<int> done) {
+    t.invoke(key, [key](table& m) {
+        return ++m[key];
+    }, done);
+}
+
+static void mark(sharded<table>& t, event<> done) {
+    t.broadcast([](table& m) {
+        m["marked"] = -1;
+    }, done);
+}
+
+static void flip(sharded<table>& t, event<> done) {
+    t.broadcast([](table& m) {
+        m["marked"] = -m["marked"];
+    }, done);
+}
+
+static void report(sharded<table>& t, size_t i, event<shard_report> done) {
+    t.invoke_on(i, [](table& m) {
+        shard_report r;
+        r.driver_index = driver::main->index();
+        r.nkeys = m.size() - m.count("marked");
+        r.marked = m.count("marked") ? m["marked"] : 0;
+        return r;
+    }, done);
+}
+
+tamed void test(sharded<table>& t) {
+    tvars {
+        int counts[nkeys];
+        shard_report reports[nworkers + 1];
+        size_t i;
+        int total, bad;
+        char key[20];
+    }
+
+    twait {
+        for (i = 0; i != nkeys; ++i) {
+            snprintf(key, sizeof(key), "key%d", (int) i % (nkeys / 2));
+            increment(t, key, make_event(counts[i]));
+        }
+    }
+    for (i = total = 0; i != nkeys; ++i)
+        total += counts[i];
+    // each key is incremented twice, in order, on its own shard
+    printf("invoke: %d calls, total %d\n", (int) nkeys, total);
+
+    // each broadcast has run on every shard by the time it completes
+    twait { mark(t, make_event()); }
+    twait { flip(t, make_event()); }
+
+    twait {
+        for (i = 0; i != t.nshards(); ++i)
+            report(t, i, make_event(reports[i]));
+    }
+    for (i = total = bad = 0; i != t.nshards(); ++i) {
+        total += reports[i].nkeys;
+        if (reports[i].driver_index != t.owner(i)->index()
+            || reports[i].marked != 1)
+            ++bad;
+    }
+    printf("broadcast: %d shards, %d keys, %s\n", (int) t.nshards(), total,
+           bad ? "bad" : "ok");
+    for (i = 1; i != t.nshards(); ++i)
+        tamer::post_expected(t.owner(i), event<>());
+}
+
+int main(int, char *[]) {
+    std::thread threads[nworkers];
+    std::vector<driver*> owners;
+    tamer::initialize();
+    owners.push_back(driver::main);
+    for (int i = 0; i != nworkers; ++i) {
+        std::promise<driver*> ready;
+        threads[i] = std::thread(worker, &ready);
+        owners.push_back(ready.get_future().get());
+    }
+
+    {
+        // the main loop runs only while results are expected
+        sharded<table> t(owners);
+        test(t);
+        tamer::loop();
+    }
+
+    for (int i = 0; i != nworkers; ++i)
+        threads[i].join();
+    tamer::cleanup();
+}
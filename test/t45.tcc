@@ -0,0 +1,56 @@
+// -*- mode: c++ -*-
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <tamer/tamer.hh>
+using namespace tamer;
+
+template <size_t N>
+struct big_id {
+    int n;
+    char pad[N];
+    std::string name;
+    big_id() : n(0) {
+        memset(pad, 0, sizeof(pad));
+    }
+    big_id(int n_, const char* s) : n(n_), name(s) {
+        memset(pad, n_, sizeof(pad));
+    }
+    bool intact() const {
+        for (size_t i = 0; i != N; ++i)
+            if (pad[i] != char(n))
+                return false;
+        return true;
+    }
+};
+
+template <size_t N>
+void test_ids() {
+    rendezvous<big_id<N> > r;
+    event<> e[8];
+    big_id<N> id;
+    int i, sum = 0;
+    bool ok = true;
+    for (i = 0; i != 8; ++i)
+        e[i] = make_event(r, big_id<N>(i + 1, "id"));
+    // trigger out of order, and leave one ID for the rendezvous to destroy
+    for (i = 7; i >= 1; i -= 2)
+        e[i].trigger();
+    for (i = 0; i != 8; i += 2)
+        e[i].trigger();
+    for (i = 0; i != 7 && r.join(id); ++i) {
+        sum += id.n;
+        ok = ok && id.intact() && id.name == "id";
+    }
+    printf("%u-byte pad: %d joined, sum %d, %s\n", (unsigned) N, i, sum,
+           ok ? "ok" : "bad");
+}
+
+int main(int, char *[]) {
+    tamer::initialize();
+    test_ids<8>();
+    test_ids<900>();
+    test_ids<3000>();
+    test_ids<40000>();
+    tamer::cleanup();
+}
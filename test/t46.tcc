@@ -0,0 +1,86 @@
+// -*- mode: c++ -*-
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <tamer/tamer.hh>
+#include <tamer/fd.hh>
+using namespace tamer;
+
+static std::string contents(const char* fname) {
+    std::string s;
+    char buf[4096];
+    ssize_t n;
+    int f = ::open(fname, O_RDONLY);
+    while (f >= 0 && (n = ::read(f, buf, sizeof(buf))) > 0)
+        s.append(buf, n);
+    if (f >= 0)
+        ::close(f);
+    return s;
+}
+
+tamed void test(std::string dir) {
+    tvars {
+        std::string fa = dir + "/a", fb = dir + "/b", fc = dir + "/c";
+        std::string big, got;
+        tamer::fd a, b;
+        int ra, rb, c, ret;
+        size_t nread;
+        char buf[20];
+    }
+    big = std::string(1 << 20, 'a');
+
+    twait { tamer::fd::open(fa.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600,
+                            make_event(a)); }
+    twait { tamer::fd::open(fb.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600,
+                            make_event(b)); }
+    assert(a && b);
+
+    // With a queue depth of 1, b's write waits behind a's. Closing b
+    // frees its descriptor number, and c reuses it, before b's write
+    // reaches the ring; the write must still go to b.
+    twait {
+        a.write(big, make_event(ra));
+        b.write("to b\n", make_event(rb));
+        b.close();
+        c = ::open(fc.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    }
+    ::close(c);
+    a.close();
+    printf("write a %d, write b %d\n", ra, rb);
+    got = contents(fa.c_str());
+    printf("a: %u bytes, %s\n", (unsigned) got.size(),
+           got == big ? "ok" : "bad");
+    printf("b: \"%s\"\n", contents(fb.c_str()).c_str());
+    printf("c: %u bytes\n", (unsigned) contents(fc.c_str()).size());
+
+    // a read larger than the file finishes short at end of file
+    twait { tamer::fd::open(fb.c_str(), O_RDONLY, make_event(b)); }
+    twait { b.read(buf, sizeof(buf), nread, make_event(ret)); }
+    printf("read b %d, %u bytes\n", ret, (unsigned) nread);
+    b.close();
+
+    ::unlink(fa.c_str());
+    ::unlink(fb.c_str());
+    ::unlink(fc.c_str());
+    ::rmdir(dir.c_str());
+}
+
+int main(int argc, char *argv[]) {
+    tamer::initialize();
+    int r = tamer::fd::set_file_io(tamer::fd::file_io_uring, 0, 1);
+    if (argc > 1 && strcmp(argv[1], "--check") == 0)
+        return r == 0 ? 0 : 1;
+    else if (r != 0) {
+        fprintf(stderr, "io_uring file I/O unavailable\n");
+        return 1;
+    }
+    char dir[] = "/tmp/t46.XXXXXX";
+    if (!mkdtemp(dir))
+        return 1;
+    test(dir);
+    tamer::loop();
+    tamer::cleanup();
+}
@@ -0,0 +1,78 @@
+// -*- mode: c++ -*-
+#include <stdio.h>
+#include <sys/time.h>
+#include <tamer/tamer.hh>
+#include <tamer/adapter.hh>
+using namespace tamer;
+
+static double elapsed(const timeval& start) {
+    timeval now;
+    gettimeofday(&now, 0);
+    return (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1e6;
+}
+
+static void note(const char* what) {
+    printf("%s\n", what);
+}
+
+static const int delays[] = {150, 50, 10, 100, 60};
+
+tamed void fire(event<> done) {
+    tvars {
+        rendezvous<int> r;
+        timeval start;
+        int which, n;
+        bool early = false;
+    }
+    start = tamer::now();     // the timers count from here
+    // all but the 10ms timer start in the wheel and cascade into the heap
+    for (n = 0; n != 5; ++n)
+        at_delay_msec(delays[n], make_event(r, n));
+    for (n = 0; n != 5; ++n) {
+        twait(r, which);
+        early = early || elapsed(start) < delays[which] / 1000.0;
+        printf("timer %d ms\n", delays[which]);
+    }
+    printf("fired %s\n", early ? "early" : "on time");
+    done();
+}
+
+tamed void cancel(event<> done) {
+    tvars {
+        rendezvous<> r;
+        event<> e;
+        int n;
+    }
+    // cancelled far-off timers leave the wheel at once, so the loop
+    // doesn't wait for them
+    for (n = 0; n != 300; ++n)
+        at_delay_sec(30 + n, make_event(r));
+    e = make_event(r);
+    at_delay_sec(20, e);
+    e.at_trigger(fun_event(note, "cancelled timer notified"));
+    r.clear();
+    done();
+}
+
+int main(int, char *[]) {
+    timeval start;
+    tamer::initialize(tamer::init_timer_wheel);
+    gettimeofday(&start, 0);
+    {
+        rendezvous<> r;
+        fire(make_event(r));
+        cancel(make_event(r));
+        tamer::loop();
+    }
+    printf("loop done %s\n", elapsed(start) < 5 ? "promptly" : "late");
+
+    // Destroy the driver while wheel timers are pending, one of them on
+    // an event with another at_trigger.
+    event<> e = fun_event(note, "held timer triggered after cleanup");
+    e.at_trigger(fun_event(note, "held timer's at_trigger"));
+    at_delay_sec(60, e);
+    tamer::cleanup();
+    printf("cleanup done\n");
+    e.trigger();
+    printf("done\n");
+}
@@ -0,0 +1,68 @@
+// -*- mode: c++ -*-
+#include <stdio.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <thread>
+#include <chrono>
+#include <tamer/tamer.hh>
+using namespace tamer;
+
+static void post_later(driver* d, event<int> e, int v, int ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    tamer::post_expected(d, std::move(e), v);
+}
+
+static void hand_off(event<int> e, int v, int ms) {
+    tamer::expect_post();
+    std::thread(post_later, driver::main, std::move(e), v, ms).detach();
+}
+
+tamed void test_posts() {
+    tvars {
+        rendezvous<> r;
+        int a = 0, b = 0;
+    }
+    // nothing but the posts keeps the loop running
+    twait {
+        hand_off(make_event(a), 1, 40);
+        hand_off(make_event(b), 2, 10);
+    }
+    printf("posted %d %d\n", a, b);
+}
+
+tamed void test_rounds(const char* who) {
+    tvars {
+        int i, v, sum = 0;
+    }
+    for (i = 0; i != 20; ++i) {
+        twait { hand_off(make_event(v), i, 2); }
+        sum += v;
+    }
+    printf("%s: 20 posts, sum %d\n", who, sum);
+}
+
+int main(int, char *[]) {
+    tamer::initialize();
+    alarm(20);
+    test_posts();
+    tamer::loop();
+
+    // After fork the child needs its own wakeup fd: otherwise either
+    // process can consume the other's wakeups and block forever.
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+        alarm(20);
+        test_rounds("child");
+        tamer::loop();
+        fflush(stdout);
+        _exit(0);
+    }
+    test_rounds("parent");
+    tamer::loop();
+    int status;
+    waitpid(child, &status, 0);
+    printf("child %s\n", WIFEXITED(status) ? "exited" : "killed");
+    tamer::cleanup();
+}
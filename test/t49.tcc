@@ -0,0 +1,52 @@
+// -*- mode: c++ -*-
+#include <stdio.h>
+#include <unistd.h>
+#include <signal.h>
+#include <tamer/tamer.hh>
+using namespace tamer;
+
+tamed void test() {
+    tvars {
+        rendezvous<int> r;
+        sigset_t usr1;
+        int what, i;
+    }
+    // SIGUSR1 goes pending while this thread blocks it, before Tamer
+    // watches it
+    sigemptyset(&usr1);
+    sigaddset(&usr1, SIGUSR1);
+    sigprocmask(SIG_BLOCK, &usr1, 0);
+    kill(getpid(), SIGUSR1);
+    at_signal(SIGUSR1, make_event(r, 1));
+
+    // SIGUSR2 is sent to this thread, where Tamer keeps it blocked
+    at_signal(SIGUSR2, make_event(r, 2));
+    raise(SIGUSR2);
+
+    at_delay_sec(5, make_event(r, 0), true);
+    for (i = 0; i != 2; ++i) {
+        twait(r, what);
+        if (what == 0)
+            break;
+        printf("SIGUSR%d delivered\n", what);
+    }
+
+    // signals keep arriving while their events are reinstalled
+    for (i = 0; i != 3; ++i) {
+        at_signal(SIGUSR2, make_event(r, 2));
+        raise(SIGUSR2);
+        twait(r, what);
+        if (what == 0)
+            break;
+    }
+    printf("SIGUSR2 delivered %d more times\n", i);
+    r.clear();
+}
+
+int main(int, char *[]) {
+    tamer::initialize();
+    test();
+    tamer::loop();
+    printf("done\n");
+    tamer::cleanup();
+}
@@ -0,0 +1,53 @@
+// -*- mode: c++ -*-
+#include <stdio.h>
+#include <tamer/tamer.hh>
+#include <tamer/adapter.hh>
+using namespace tamer;
+
+static double fired[4];
+
+static void record(int i) {
+    fired[i] = drecent();
+}
+
+static void test(const char* what, const double* delays, double slack) {
+    double start = drecent();
+    for (int i = 0; i != 4; ++i) {
+        fired[i] = 0;
+        at_delay_slack(delays[i], fun_event(record, i), slack);
+    }
+    tamer::loop();
+    bool bad = false;
+    int nwakeups = 0;
+    for (int i = 0; i != 4; ++i) {
+        double late = fired[i] - start - delays[i];
+        // virtual time advances a microsecond per now()
+        if (late < 0 || late >= slack + 1e-5)
+            bad = true;
+        if (i == 0 || fired[i] != fired[i - 1])
+            ++nwakeups;
+    }
+    printf("%s: %d wakeups, %s\n", what, nwakeups, bad ? "bad" : "in window");
+}
+
+int main(int, char *[]) {
+    tamer::initialize();
+    tamer::set_time_type(tamer::time_virtual);
+    // no slack, no coalescing
+    static const double exact[] = { 0.1, 0.101, 0.102, 0.2 };
+    test("no slack", exact, 0);
+
+    // timers whose slack windows overlap share a wakeup
+    static const double near[] = { 1.0, 1.01, 1.02, 1.03 };
+    test("slack 250ms", near, 0.25);
+
+    // slack beyond 4000 seconds is clamped, not wrapped around
+    static const double far[] = { 10, 11, 12, 13 };
+    test("slack 8589.934592s", far, 8589.934592);
+    test("slack 1e12s", far, 1e12);
+
+    // the default slack is clamped the same way
+    driver::main->set_timer_slack(8589.934592);
+    printf("default slack %u usec\n", driver::main->timer_slack_usec());
+    tamer::cleanup();
+}
@@ -0,0 +1,119 @@
+// -*- mode: c++ -*-
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <tamer/tamer.hh>
+#include <tamer/fd.hh>
+using namespace tamer;
+
+// Each round re-arms a one-shot ring poll on both pipes.
+tamed void pinger(tamer::fd r, tamer::fd w, int rounds, event<int> done) {
+    tvars { char c = 'x'; size_t n; int ret, i; }
+    for (i = 0; i != rounds; ++i) {
+        twait { w.write(&c, 1, n, make_event(ret)); }
+        twait { r.read(&c, 1, n, make_event(ret)); }
+        if (ret < 0 || n != 1)
+            break;
+    }
+    done(i);
+}
+
+tamed void ponger(tamer::fd r, tamer::fd w, event<> done) {
+    tvars { char c; size_t n; int ret; }
+    while (1) {
+        twait { r.read(&c, 1, n, make_event(ret)); }
+        if (ret < 0 || n != 1)
+            break;
+        twait { w.write(&c, 1, n, make_event(ret)); }
+    }
+    done();
+}
+
+tamed void ping_pong(const char* who, event<> done) {
+    tvars { tamer::fd a[2], b[2]; rendezvous<> r; int rounds; }
+    tamer::fd::pipe(a);
+    tamer::fd::pipe(b);
+    ponger(a[0], b[1], make_event(r));
+    twait { pinger(b[0], a[1], 100, make_event(rounds)); }
+    a[1].close();           // ponger reads end of file
+    twait(r);
+    printf("%s: ping-pong %d rounds\n", who, rounds);
+    b[0].close();
+    done();
+}
+
+tamed void kill_and_reuse(event<> done) {
+    tvars {
+        tamer::fd f, g;
+        int p[2], q[2], old, r1, r2;
+        rendezvous<> rv;
+        char buf[10];
+        size_t n;
+        ssize_t x;
+    }
+    if (::pipe(p) < 0 || ::pipe(q) < 0)
+        return;
+    f = tamer::fd(p[0]);
+    old = p[0];
+    tamer::at_fd_read(p[0], make_event(rv, r1));
+    // let the loop put the poll on the ring, then close the fd under it
+    twait { tamer::at_delay_msec(10, make_event()); }
+    f.close();
+    twait(rv);
+    printf("closed wait: %s\n", r1 == -ECANCELED ? "ECANCELED" : "?");
+
+    // The ring's poll pins the old pipe, which becomes readable now. The
+    // new pipe reuses its number but must not see that readiness.
+    ::dup2(q[0], old);
+    ::close(q[0]);
+    g = tamer::fd(old);
+    g.make_nonblocking();
+    x = ::write(p[1], "stale", 5);
+    tamer::at_fd_read(old, make_event(rv, r2));
+    twait { tamer::at_delay_msec(20, make_event()); }
+    printf("new fd after stale readiness: %s\n",
+           rv.has_ready() ? "woken" : "waiting");
+    x = ::write(q[1], "hello", 5);
+    twait(rv);
+    twait { g.read(buf, 5, n, make_event(r2)); }
+    printf("new fd read %d, \"%.*s\"\n", r2, (int) n, buf);
+    g.close();
+    ::close(p[1]);
+    ::close(q[1]);
+    done();
+}
+
+tamed void test() {
+    twait { ping_pong("parent", make_event()); }
+    twait { kill_and_reuse(make_event()); }
+}
+
+int main(int argc, char *argv[]) {
+    bool ok = tamer::initialize(tamer::init_uring | tamer::init_strict);
+    if (argc > 1 && strcmp(argv[1], "--check") == 0)
+        return ok ? 0 : 1;
+    else if (!ok) {
+        fprintf(stderr, "io_uring driver unavailable\n");
+        return 1;
+    }
+    alarm(20);
+    test();
+    tamer::loop();
+
+    // the child must set up a ring of its own
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+        alarm(20);
+        ping_pong("child", event<>());
+        tamer::loop();
+        fflush(stdout);
+        _exit(0);
+    }
+    int status;
+    waitpid(child, &status, 0);
+    printf("child %s\n", WIFEXITED(status) ? "exited" : "killed");
+    tamer::cleanup();
+}
@@ -0,0 +1,87 @@
+// -*- mode: c++ -*-
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+#include <tamer/tamer.hh>
+#include <tamer/fd.hh>
+#include <tamer/adapter.hh>
+using namespace tamer;
+
+enum { nthreads = 4, nrounds = 50 };
+
+struct thread_result {
+    driver* d;
+    unsigned index;
+    int rounds;
+    bool kept_main;
+    bool cleaned_up;
+};
+
+// Every thread runs the same pipe and timer traffic on its own driver.
+tamed void traffic(thread_result& r, event<> done) {
+    tvars { tamer::fd p[2]; char c = 'x'; size_t n; int ret, i; }
+    tamer::fd::pipe(p);
+    for (i = 0; i != nrounds; ++i) {
+        twait {
+            p[0].read(&c, 1, n, make_event(ret));
+            tamer::at_delay_usec(100, make_event());
+            p[1].write(&c, 1, n, make_event());
+        }
+        if (ret < 0 || n != 1)
+            break;
+    }
+    r.rounds = i;
+    p[0].close();
+    p[1].close();
+    done();
+}
+
+static driver* main_driver;
+
+static void signalled() {
+    printf("SIGUSR1 on the %s driver\n",
+           driver::main == main_driver ? "main" : "wrong");
+}
+
+static void thread_main(int id, thread_result* r) {
+    tamer::initialize_thread();
+    r->d = driver::main;
+    r->index = driver::main->index();
+    traffic(*r, event<>());
+    // signals are process-wide; the main thread's driver handles them
+    if (id == 0)
+        kill(getpid(), SIGUSR1);
+    tamer::loop();
+    r->kept_main = driver::main == r->d;
+    tamer::cleanup();
+    r->cleaned_up = driver::main == 0;
+}
+
+int main(int, char *[]) {
+    tamer::initialize();
+    alarm(20);
+    main_driver = driver::main;
+    thread_result rs[nthreads];
+    std::vector<std::thread> threads;
+
+    tamer::at_signal(SIGUSR1, fun_event(signalled));
+    for (int i = 0; i != nthreads; ++i)
+        threads.push_back(std::thread(thread_main, i, &rs[i]));
+    tamer::loop();
+    for (int i = 0; i != nthreads; ++i)
+        threads[i].join();
+
+    for (int i = 0; i != nthreads; ++i) {
+        bool unique = rs[i].d != main_driver
+            && driver::by_index(rs[i].index) == 0;
+        for (int j = 0; j != i; ++j)
+            unique = unique && rs[j].index != rs[i].index;
+        printf("thread %d: %s, %d rounds, %s\n", i,
+               unique ? "own driver" : "shared driver", rs[i].rounds,
+               rs[i].kept_main && rs[i].cleaned_up ? "cleaned up" : "?");
+    }
+    printf("main driver %s\n", driver::main == main_driver ? "kept" : "lost");
+    tamer::cleanup();
+}
@@ -0,0 +1,105 @@
+// -*- mode: c++ -*-
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <tamer/tamer.hh>
+using namespace tamer;
+
+enum { nwaiters = 100 };
+
+struct pool_state {
+    size_t live;
+    size_t cached;
+};
+
+static pool_state pool() {
+    driver_memory m;
+    driver::main->memory_usage(m);
+    pool_state s = {m.closures, m.closure_cache};
+    return s;
+}
+
+tamed void waiter(event<> done) {
+    twait { tamer::at_asap(make_event()); }
+    done();
+}
+
+// Record the pool while nwaiters closures are blocked.
+tamed void round(pool_state& during, event<> done) {
+    tvars { int i; }
+    twait {
+        for (i = 0; i != nwaiters; ++i)
+            waiter(make_event());
+        during = pool();
+    }
+    done();
+}
+
+tamed void test() {
+    tvars { pool_state base, during1, after1, during2, after2; }
+    base = pool();
+    twait { round(during1, make_event()); }
+    after1 = pool();
+    printf("round 1: %s; after: %s, %s\n",
+           during1.live > base.live ? "closures live" : "?",
+           after1.live == base.live ? "all returned" : "leaked",
+           after1.cached >= during1.live - base.live ? "cached" : "not cached");
+
+    // the second round's closures come from the freelists
+    twait { round(during2, make_event()); }
+    after2 = pool();
+    printf("round 2: %s, %s; after: %s, %s\n",
+           during2.live == during1.live ? "same live bytes" : "?",
+           during2.cached < after1.cached ? "taken from cache" : "fresh",
+           after2.live == base.live ? "all returned" : "leaked",
+           after2.cached == after1.cached ? "cache kept its size" : "cache grew");
+}
+
+#if TAMER_CLOSURE_POOL
+static unsigned nallocated, nfreed;
+
+static void* counting_allocate(size_t size) {
+    ++nallocated;
+    return malloc(size);
+}
+
+static void counting_free(void* p, size_t) {
+    ++nfreed;
+    free(p);
+}
+
+tamed void test_hook() {
+    tvars { pool_state during; }
+    twait { round(during, make_event()); }
+    printf("hook: %s, %s\n",
+           nallocated >= nwaiters ? "allocated" : "not used",
+           nallocated == nfreed + 1 ? "all freed" : "leaked");
+}
+#endif
+
+int main(int argc, char *argv[]) {
+#if TAMER_CLOSURE_POOL
+    bool ok = true;
+#else
+    bool ok = false;
+#endif
+    if (argc > 1 && strcmp(argv[1], "--check") == 0)
+        return ok ? 0 : 1;
+    else if (!ok) {
+        fprintf(stderr, "closure pool unavailable\n");
+        return 1;
+    }
+    tamer::initialize();
+    test();
+    tamer::loop();
+#if TAMER_CLOSURE_POOL
+    // a replacement allocator sees every closure; test_hook's own is
+    // still live when it reports
+    set_closure_allocator(counting_allocate, counting_free);
+    test_hook();
+    tamer::loop();
+    set_closure_allocator(0, 0);
+    printf("hook done: %s\n", nallocated == nfreed ? "all freed" : "leaked");
+#endif
+    tamer::cleanup();
+}
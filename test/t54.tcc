@@ -0,0 +1,101 @@
+// -*- mode: c++ -*-
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <tamer/tamer.hh>
+#include <tamer/fd.hh>
+using namespace tamer;
+
+static void write_later(int fd, const char* s) {
+    ssize_t x = ::write(fd, s, strlen(s));
+    (void) x;
+}
+
+// One edge announces all ten bytes. A reader that stops short of EAGAIN
+// must find the fd still ready each time it waits.
+tamed void partial_reads(event<> done) {
+    tvars {
+        int p[2], which;
+        rendezvous<int> r;
+        std::string sizes;
+        char buf[4];
+        ssize_t n;
+        int ret;
+    }
+    if (::pipe(p) < 0)
+        return;
+    tamer::fd::make_nonblocking(p[0]);
+    write_later(p[1], "0123456789");
+    do {
+        twait { tamer::at_fd_read(p[0], make_event(ret)); }
+        n = ::read(p[0], buf, 3);
+        sizes += (sizes.empty() ? "" : " ") + std::to_string(n);
+    } while (n == 3);
+    n = ::read(p[0], buf, 3);
+    printf("read %s, then %s\n", sizes.c_str(),
+           n < 0 && errno == EAGAIN ? "EAGAIN" : "more");
+
+    // after EAGAIN is reported, waiting blocks until the next edge
+    tamer::read_would_block(p[0]);
+    tamer::at_fd_read(p[0], make_event(r, 1, ret));
+    tamer::at_delay_msec(20, make_event(r, 2));
+    twait(r, which);
+    printf("after EAGAIN: %s\n", which == 2 ? "blocked" : "woke early");
+    tamer::at_delay_msec(10, tamer::fun_event(write_later, p[1], "more"));
+    twait(r, which);
+    n = ::read(p[0], buf, sizeof(buf));
+    printf("next edge: %d, \"%.*s\"\n", which, (int) n, buf);
+    ::close(p[0]);
+    ::close(p[1]);
+    done();
+}
+
+tamed void close_with_dup(event<> done) {
+    tvars {
+        tamer::fd f;
+        int p[2], q[2], dupfd, which, ret;
+        rendezvous<int> r;
+    }
+    // A dup keeps the old pipe registered in epoll after close(); the
+    // driver must drop that registration itself, or a new file with the
+    // same number hears the old pipe's edges.
+    if (::pipe(p) < 0 || ::pipe(q) < 0)
+        return;
+    f = tamer::fd(p[0]);
+    f.make_nonblocking();
+    dupfd = ::dup(p[0]);
+    tamer::at_fd_read(p[0], make_event(r, 0, ret));
+    twait { tamer::at_delay_msec(10, make_event()); }
+    f.close();
+    twait(r, which);
+    ::dup2(q[0], p[0]);
+    ::close(q[0]);
+    tamer::fd::make_nonblocking(p[0]);
+    tamer::at_fd_read(p[0], make_event(r, 1, ret));
+    write_later(p[1], "stale");
+    tamer::at_delay_msec(20, make_event(r, 2));
+    twait(r, which);
+    printf("old pipe's edge: %s\n", which == 2 ? "ignored" : "delivered");
+    write_later(q[1], "x");
+    twait(r, which);
+    printf("new pipe's edge: %d\n", which);
+    ::close(p[0]);
+    ::close(p[1]);
+    ::close(q[1]);
+    ::close(dupfd);
+    done();
+}
+
+tamed void test() {
+    twait { partial_reads(make_event()); }
+    twait { close_with_dup(make_event()); }
+}
+
+int main(int, char *[]) {
+    tamer::initialize(tamer::init_tamer | tamer::init_epoll_et);
+    alarm(20);
+    test();
+    tamer::loop();
+    tamer::cleanup();
+}
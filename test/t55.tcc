@@ -0,0 +1,169 @@
+// -*- mode: c++ -*-
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <map>
+#include <tamer/tamer.hh>
+#include <tamer/dns.hh>
+using namespace tamer;
+
+// A name server on 127.0.0.77:53 that answers "a.test" with 10.0.0.1,
+// TTL 1, and everything else with NXDOMAIN, counting queries by name.
+static const char server_addr[] = "127.0.0.77";
+static std::map<std::string, int> nqueries;
+
+static int open_server() {
+    int s = socket(AF_INET, SOCK_DGRAM, 0), one = 1;
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(53);
+    inet_aton(server_addr, &sin.sin_addr);
+    // an io_uring poll can hold an earlier run's socket for a moment
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (s >= 0 && bind(s, (struct sockaddr*) &sin, sizeof(sin)) < 0) {
+        close(s);
+        s = -1;
+    }
+    return s;
+}
+
+static void answer(int s) {
+    unsigned char buf[512];
+    struct sockaddr_in from;
+    socklen_t fromlen = sizeof(from);
+    ssize_t n = recvfrom(s, buf, sizeof(buf) - 16, MSG_DONTWAIT,
+                         (struct sockaddr*) &from, &fromlen);
+    if (n < 17)
+        return;
+    std::string name;
+    size_t pos = 12;
+    while (pos < (size_t) n && buf[pos]) {
+        if (!name.empty())
+            name += '.';
+        name.append((char*) &buf[pos + 1], buf[pos]);
+        pos += buf[pos] + 1;
+    }
+    pos += 5;                   // end of name, qtype, qclass
+    ++nqueries[name];
+
+    buf[2] = 0x81;              // response, recursion desired
+    buf[3] = 0x80;              // recursion available
+    buf[8] = buf[9] = buf[10] = buf[11] = 0;
+    if (name == "a.test") {
+        static const unsigned char rr[] = {
+            0xC0, 12, 0, 1, 0, 1, 0, 0, 0, 1, 0, 4, 10, 0, 0, 1
+        };
+        buf[6] = 0;
+        buf[7] = 1;
+        memcpy(&buf[pos], rr, sizeof(rr));
+        pos += sizeof(rr);
+    } else {
+        buf[3] |= 3;            // NXDOMAIN
+        buf[6] = buf[7] = 0;
+    }
+    sendto(s, buf, pos, 0, (struct sockaddr*) &from, fromlen);
+}
+
+tamed void serve(int s) {
+    tvars { int ret; }
+    while (1) {
+        twait { tamer::at_fd_read(s, make_event(ret)); }
+        if (ret < 0)
+            break;
+        answer(s);
+    }
+}
+
+static const char* describe(const dns::reply& p) {
+    static char buf[40];
+    if (!p)
+        return "no reply";
+    else if (p->err)
+        return "error";
+    else if (p->addrs.empty())
+        return "no address";
+    struct in_addr a;
+    a.s_addr = p->addrs[0];
+    snprintf(buf, sizeof(buf), "%s", inet_ntoa(a));
+    return buf;
+}
+
+tamed void test(const char* rcname, int s) {
+    tvars {
+        ref_ptr<dns::resolver> r;
+        dns::reply p1, p2, p3, p4;
+        bool hit;
+    }
+    r = ref_ptr<dns::resolver>(new dns::resolver(DNS_OPTION_NAMESERVERS,
+                                                 rcname));
+    r->set_cache(DNS_CACHE_SIZE, 1);
+    twait { r->ready(make_event()); }
+    serve(s);
+
+    // concurrent lookups share one query
+    twait {
+        r->resolve_a("a.test", false, make_event(p1));
+        r->resolve_a("a.test", false, make_event(p2));
+        r->resolve_a("a.test", false, make_event(p3));
+    }
+    printf("a.test: %s %s %s, %d query\n",
+           describe(p1), describe(p2), describe(p3), nqueries["a.test"]);
+
+    // a cached reply triggers at once
+    hit = false;
+    twait {
+        r->resolve_a("a.test", false, make_event(p4));
+        hit = bool(p4);
+    }
+    printf("a.test again: %s, %s, %d query\n", describe(p4),
+           hit ? "at once" : "waited", nqueries["a.test"]);
+
+    // failures are cached for the negative TTL
+    twait { r->resolve_a("missing.test", false, make_event(p1)); }
+    twait { r->resolve_a("missing.test", false, make_event(p2)); }
+    printf("missing.test: %s %s, %d query\n",
+           describe(p1), describe(p2), nqueries["missing.test"]);
+
+    // both TTLs run out
+    twait { tamer::at_delay_msec(1200, make_event()); }
+    twait {
+        r->resolve_a("a.test", false, make_event(p1));
+        r->resolve_a("missing.test", false, make_event(p2));
+    }
+    printf("after expiry: %s %s, %d and %d queries\n",
+           describe(p1), describe(p2),
+           nqueries["a.test"], nqueries["missing.test"]);
+
+    r->flush_cache();
+    twait { r->resolve_a("a.test", false, make_event(p1)); }
+    printf("after flush: %s, %d queries\n", describe(p1), nqueries["a.test"]);
+    tamer::break_loop();
+}
+
+int main(int argc, char *argv[]) {
+    int s = open_server();
+    if (argc > 1 && strcmp(argv[1], "--check") == 0)
+        return s >= 0 ? 0 : 1;
+    else if (s < 0) {
+        fprintf(stderr, "cannot bind %s:53\n", server_addr);
+        return 1;
+    }
+    char rcname[] = "/tmp/t55.XXXXXX";
+    int rcfd = mkstemp(rcname);
+    if (rcfd < 0)
+        return 1;
+    FILE* rc = fdopen(rcfd, "w");
+    fprintf(rc, "nameserver %s\n", server_addr);
+    fclose(rc);
+
+    tamer::initialize();
+    alarm(20);
+    test(rcname, s);
+    tamer::loop();
+    unlink(rcname);
+}
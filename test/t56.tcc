@@ -0,0 +1,128 @@
+// -*- mode: c++ -*-
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <tamer/tamer.hh>
+#include <tamer/fd.hh>
+#include <tamer/dns.hh>
+using namespace tamer;
+
+// Every address listens, or doesn't, on the same port:
+// 127.0.0.2 has a full accept queue, so it drops SYNs and never answers;
+// 127.0.0.3 and 127.0.0.5 accept; 127.0.0.4 and 127.0.0.6 refuse.
+static int port;
+
+static int open_listener(const char* addr, int backlog) {
+    int s = socket(AF_INET, SOCK_STREAM, 0), one = 1;
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(port);
+    inet_aton(addr, &sin.sin_addr);
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (s >= 0 && bind(s, (struct sockaddr*) &sin, sizeof(sin)) < 0) {
+        close(s);
+        s = -1;
+    }
+    if (s >= 0 && listen(s, backlog) < 0) {
+        close(s);
+        s = -1;
+    }
+    if (s >= 0 && !port) {
+        socklen_t len = sizeof(sin);
+        getsockname(s, (struct sockaddr*) &sin, &len);
+        port = ntohs(sin.sin_port);
+    }
+    return s;
+}
+
+static uint32_t a(const char* addr) {
+    struct in_addr in;
+    inet_aton(addr, &in);
+    return in.s_addr;
+}
+
+static std::vector<uint32_t> list(const char* a0, const char* a1) {
+    std::vector<uint32_t> v;
+    v.push_back(a(a0));
+    v.push_back(a(a1));
+    return v;
+}
+
+static const char* peer(const tamer::fd& f) {
+    static char buf[40];
+    struct sockaddr_in sin;
+    socklen_t len = sizeof(sin);
+    if (!f)
+        return strerror(-f.error());
+    else if (getpeername(f.fdnum(), (struct sockaddr*) &sin, &len) < 0)
+        return "not connected";
+    snprintf(buf, sizeof(buf), "%s", inet_ntoa(sin.sin_addr));
+    return buf;
+}
+
+static const char* timing(double t) {
+    if (t < 0.8 * DNS_CONNECT_STAGGER)
+        return "at once";
+    else if (t < 4 * DNS_CONNECT_STAGGER)
+        return "after the stagger";
+    else
+        return "late";
+}
+
+tamed void attempt(const char* what, std::vector<uint32_t> addrs,
+                   event<> done) {
+    tvars { tamer::fd f; double start = dnow(); }
+    twait { tamer::tcp_connect(addrs, port, make_event(f)); }
+    printf("%s: %s, %s\n", what, peer(f), timing(dnow() - start));
+    f.close();
+    done();
+}
+
+tamed void test() {
+    // the first address never answers, so the second starts at the stagger
+    twait { attempt("silent first", list("127.0.0.2", "127.0.0.3"),
+                    make_event()); }
+    // the silent address was charged for its loss and now goes last
+    twait { attempt("silent again", list("127.0.0.2", "127.0.0.3"),
+                    make_event()); }
+    // a refused attempt starts the next one without waiting
+    twait { attempt("refused first", list("127.0.0.4", "127.0.0.5"),
+                    make_event()); }
+    twait { attempt("both refused", list("127.0.0.4", "127.0.0.6"),
+                    make_event()); }
+}
+
+int main(int argc, char *argv[]) {
+    int good1 = open_listener("127.0.0.3", 16);
+    int good2 = good1 >= 0 ? open_listener("127.0.0.5", 16) : -1;
+    int silent = good2 >= 0 ? open_listener("127.0.0.2", 0) : -1;
+    // fill the silent listener's accept queue
+    int filler = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(port);
+    inet_aton("127.0.0.2", &sin.sin_addr);
+    bool ok = silent >= 0 && filler >= 0
+        && connect(filler, (struct sockaddr*) &sin, sizeof(sin)) == 0;
+    if (argc > 1 && strcmp(argv[1], "--check") == 0)
+        return ok ? 0 : 1;
+    else if (!ok) {
+        fprintf(stderr, "cannot listen on 127.0.0.2-5\n");
+        return 1;
+    }
+    tamer::initialize();
+    alarm(20);
+    test();
+    tamer::loop();
+    tamer::cleanup();
+    close(filler);
+    close(silent);
+    close(good1);
+    close(good2);
+}
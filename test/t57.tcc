@@ -0,0 +1,71 @@
+// -*- mode: c++ -*-
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <vector>
+#include <tamer/tamer.hh>
+#include <tamer/fd.hh>
+#include <tamer/adapter.hh>
+using namespace tamer;
+
+static const char* result_name(int x) {
+    return x == 0 ? "0" : x == -ETIMEDOUT ? "-ETIMEDOUT" : "?";
+}
+
+enum { ncancelled = 1000 };
+
+tamed void test() {
+    tvars {
+        tamer::fd p[2];
+        char c;
+        size_t n;
+        int ret = 99, v = 7, x = 99, i;
+        std::vector<int> xs;
+        event<int> e;
+        double start;
+    }
+    tamer::fd::pipe(p);
+
+    // a read that never completes is unblocked at the deadline
+    start = dnow();
+    twait { p[0].read(&c, 1, n, with_timeout_msec(20, make_event(ret), x)); }
+    printf("idle read: %s, %s\n", result_name(x),
+           dnow() - start >= 0.019 ? "at the deadline" : "early");
+
+    // result is cleared immediately; the event's value wins the race
+    twait {
+        e = with_timeout(1.0, make_event(v), x);
+        printf("result while waiting: %s\n", result_name(x));
+        tamer::at_delay_msec(5, tamer::bind(e, 11));
+    }
+    printf("event first: %d, %s\n", v, result_name(x));
+
+    // the timeout leaves the event's value alone
+    v = 7;
+    twait { e = with_timeout_sec(0, make_event(v), x); }
+    printf("zero delay: %d, %s\n", v, result_name(x));
+
+    // Deadlines far enough out for the timing wheel. Once their events
+    // trigger they leave nothing behind to hold the loop open.
+    xs.resize(ncancelled);
+    twait {
+        for (i = 0; i != ncancelled; ++i)
+            tamer::at_asap(with_timeout_sec(3600, make_event(), xs[i]));
+    }
+    for (i = 0; i != ncancelled && xs[i] == 0; ++i)
+        /* nada */;
+    printf("%d cancelled deadlines: %s\n", i,
+           i == ncancelled ? "all 0" : "some timed out");
+    p[0].close();
+    p[1].close();
+}
+
+int main(int, char *[]) {
+    tamer::initialize();
+    alarm(20);
+    double start = dnow();
+    test();
+    tamer::loop();
+    printf("loop ended %s\n", dnow() - start < 5 ? "promptly" : "late");
+    tamer::cleanup();
+}
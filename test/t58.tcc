@@ -0,0 +1,61 @@
+// -*- mode: c++ -*-
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include <algorithm>
+#include <tamer/tamer.hh>
+using namespace tamer;
+
+enum { nwaits = 200 };
+
+static double cpu_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double wall_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Time nwaits timers of usec microseconds one after another. A driver that
+// rounds to milliseconds either sleeps a whole millisecond or spins.
+tamed void waits(int usec, event<> done) {
+    tvars {
+        std::vector<double> ts;
+        double wall, cpu, t;
+        int i;
+    }
+    wall = wall_now();
+    cpu = cpu_now();
+    for (i = 0; i != nwaits; ++i) {
+        t = wall_now();
+        twait { tamer::at_delay_usec(usec, make_event()); }
+        ts.push_back(wall_now() - t);
+    }
+    wall = wall_now() - wall;
+    cpu = cpu_now() - cpu;
+    std::sort(ts.begin(), ts.end());
+    // the delay counts from recent(), a little before t
+    printf("%dus: %s, median %s, %s\n", usec,
+           ts[0] >= usec / 1e6 - 0.00005 ? "never early" : "early",
+           ts[nwaits / 2] < usec / 1e6 + 0.0008 ? "on time" : "rounded up",
+           cpu < wall / 2 ? "blocked" : "spun");
+    done();
+}
+
+tamed void test() {
+    twait { waits(200, make_event()); }
+    twait { waits(1500, make_event()); }
+}
+
+int main(int, char *[]) {
+    tamer::initialize(tamer::init_tamer);
+    alarm(20);
+    test();
+    tamer::loop();
+    tamer::cleanup();
+}